@@ -14,6 +14,7 @@ import sepparser as parser
 import sepencoder as encoder
 
 import collections
+import contextlib
 
 ##############################################
 # Exceptions
@@ -78,6 +79,15 @@ def emit_constant(function, node):
 
 
 def emit_call(function, node):
+    index = index_load_argument(node)
+    if index is not None:
+        # 'a[i]' - the index is evaluated right away, and the VM reads array
+        # elements without calling "[]"
+        function.compile_node(node.first.first)
+        function.compile_node(index)
+        function.add(INDEX, "", [], ["[]"], [])
+        return
+
     # fetch the function itself
     function.compile_node(node.first)
     arguments = create_function_arguments(function, node)
@@ -147,6 +157,289 @@ def emit_block(function, node):
     # at the point it was encountered, we have to push it on the stack
     function.add(PUSH, "", [], [func], [])
 
+##############################################
+# Lowering flow control
+##############################################
+
+# Statements using the built-in 'if', 'while', 'for' and 'try' are compiled into jumps
+# inside the function using them, instead of a call passing the conditions and
+# bodies as closures. The compiled version first checks that the name still
+# refers to the built-in, and falls back to the call if 'syntax' was customized.
+# Unlike other statements, lowered ones pop their own results.
+
+# The deepest loops can be nested inside one function (VM_INLINE_LOOP_DEPTH).
+MAX_INLINE_LOOP_DEPTH = 8
+# The same for try..catch statements (VM_HANDLER_DEPTH).
+MAX_INLINE_TRY_DEPTH = 8
+# Jump offsets are 16-bit, so a lowered statement can only span this many
+# code units - longer ones are compiled as plain calls after all.
+MAX_LOWERED_CODE_UNITS = 32767
+
+
+def inline_body(node):
+    """Returns the statements of a block with no parameters, or None if the
+    node is something else."""
+    if node.kind != parser.Block or node.child("parameters").children:
+        return None
+    return node.child("body").children
+
+
+def positional_args(call, count):
+    """Returns the arguments of a call, if there are exactly 'count' of them
+    and none of them are named."""
+    args = call.child("args").children
+    if len(args) != count or any(a.kind == parser.NamedArg for a in args):
+        return None
+    return args
+
+
+def index_load_argument(call):
+    """Returns the index of a plain 'a[i]' call, or None if the call is
+    something else. Indices that mention 'end' are left to "[]", since it
+    resolves them with 'end' in scope."""
+    method = call.child("target")
+    if method.kind != parser.BinaryOp or method.value != ".":
+        return None
+    if method.second.kind != parser.Id or method.second.value != "[]":
+        return None
+    args = positional_args(call, 1)
+    if not args or args[0].kind == parser.Block or mentions_id(args[0], "end"):
+        return None
+    return args[0]
+
+
+def mentions_id(node, name):
+    """Checks if the identifier 'name' appears anywhere inside the node."""
+    if node.kind == parser.Id and node.value == name:
+        return True
+    return any(mentions_id(child, name) for child in node.children)
+
+
+def is_call_to(node, name):
+    """Checks if the node is a call to the identifier 'name'."""
+    if node.kind != parser.FunctionCall:
+        return False
+    target = node.child("target")
+    return target.kind == parser.Id and target.value == name
+
+
+def emit_syntax_guard(function, name, fallback):
+    # fetch the name and check it against the built-in
+    function.add(NOP, F_PUSH_LOCALS + F_FETCH_PROPERTY, [name], [], [])
+    function.add(GUARD_SYNTAX, "", [], [name, fallback], [])
+
+
+def emit_fallback_call(function, node):
+    # the function to call is already on the stack, left there by the guard
+    with function.compiler.lowering_disabled():
+        first_call = node if node.kind == parser.FunctionCall else node.first
+        arguments = create_function_arguments(function, first_call)
+        function.add(LAZY, "", [], arguments, [])
+        if node.kind == parser.ComplexCall:
+            for subcall in node.children[1:]:
+                function.compile_node(subcall)
+            function.compile_node(parser.Subcall("..!"))
+    function.add(NOP, F_POP_RESULT, [], [], [])
+
+
+def emit_inline_body(function, statements):
+    # the value of the last statement is the value of the whole thing
+    if not statements:
+        function.add(PUSH_NOTHING, F_POP_RESULT, [], [], [])
+    for statement in statements:
+        function.compiler.compile_statement(function, statement)
+
+
+def lower_if(function, node):
+    if is_call_to(node, "if"):
+        name, calls = "if", [node]
+    elif node.kind == parser.ComplexCall and is_call_to(node.first, "if.."):
+        name, calls = "if..", node.children
+    else:
+        return False
+
+    # collect the branches - (condition, body) pairs, and the 'else'
+    branches, else_body = [], []
+    for index, call in enumerate(calls):
+        if index > 0 and call.value == "else.." and call is calls[-1]:
+            args = positional_args(call, 1)
+            else_body = args and inline_body(args[0])
+        elif index == 0 or call.value == "elseif..":
+            args = positional_args(call, 2)
+            body = args and inline_body(args[1])
+            branches.append((args and args[0], body))
+            else_body = []
+        else:
+            return False
+        if else_body is None or any(b is None for c, b in branches):
+            return False
+
+    fallback, done = Label(), Label()
+    emit_syntax_guard(function, name, fallback)
+    for condition, body in branches:
+        next_branch = Label()
+        function.compile_node(condition)
+        function.add(JUMP_UNLESS, "", [], [next_branch], [])
+        emit_inline_body(function, body)
+        function.add(JUMP, "", [], [done], [])
+        function.add_label(next_branch)
+    emit_inline_body(function, else_body)
+    function.add(JUMP, "", [], [done], [])
+
+    function.add_label(fallback)
+    emit_fallback_call(function, node)
+    function.add_label(done)
+    return True
+
+
+def lower_while(function, node):
+    if not is_call_to(node, "while"):
+        return False
+    args = positional_args(node, 2)
+    body = args and inline_body(args[1])
+    if body is None or function.loop_depth >= MAX_INLINE_LOOP_DEPTH:
+        return False
+
+    fallback, next_iteration, exit, done = Label(), Label(), Label(), Label()
+    emit_syntax_guard(function, "while", fallback)
+    function.add(LOOP_START, "", [], [exit], [])
+
+    # the condition is checked at the start of every iteration
+    function.add_label(next_iteration)
+    function.add(LOOP_NEXT, "", [], [], [])
+    function.compile_node(args[0])
+    function.add(JUMP_UNLESS, "", [], [exit], [])
+    emit_loop_body(function, body, next_iteration)
+
+    emit_loop_end(function, exit, fallback, done, node)
+    return True
+
+
+def lower_for(function, node):
+    if (node.kind != parser.ComplexCall or len(node.children) != 2 or
+            not is_call_to(node.first, "for..") or
+            node.second.value != "in.."):
+        return False
+    variable_args = positional_args(node.first, 1)
+    in_args = positional_args(node.second, 2)
+    if not variable_args or variable_args[0].kind != parser.Id:
+        return False
+    body = in_args and inline_body(in_args[1])
+    if body is None or function.loop_depth >= MAX_INLINE_LOOP_DEPTH:
+        return False
+
+    fallback, next_iteration, exit, done = Label(), Label(), Label(), Label()
+    emit_syntax_guard(function, "for..", fallback)
+    function.compile_node(in_args[0])
+    function.add(FOR_START, "", [], [variable_args[0].value, exit], [])
+
+    # the next element is fetched at the start of every iteration
+    function.add_label(next_iteration)
+    function.add(LOOP_NEXT, "", [], [], [])
+    emit_loop_body(function, body, next_iteration)
+
+    emit_loop_end(function, exit, fallback, done, node)
+    return True
+
+
+def emit_loop_body(function, body, next_iteration):
+    function.loop_depth += 1
+    for statement in body:
+        function.compiler.compile_statement(function, statement)
+    function.loop_depth -= 1
+    function.add(JUMP, "", [], [next_iteration], [])
+
+
+def emit_loop_end(function, exit, fallback, done, node):
+    # loops have no value
+    function.add_label(exit)
+    function.add(LOOP_END, F_POP_RESULT, [], [], [])
+    function.add(JUMP, "", [], [done], [])
+
+    function.add_label(fallback)
+    emit_fallback_call(function, node)
+    function.add_label(done)
+
+
+def lower_try(function, node):
+    # only try..catch - 'finally' is left to the built-in
+    if (node.kind != parser.ComplexCall or len(node.children) < 2 or
+            not is_call_to(node.first, "try..") or
+            any(c.value != "catch.." for c in node.children[1:])):
+        return False
+    try_args = positional_args(node.first, 1)
+    body = try_args and inline_body(try_args[0])
+    if body is None or function.try_depth >= MAX_INLINE_TRY_DEPTH:
+        return False
+    clauses = []
+    for subcall in node.children[1:]:
+        args = positional_args(subcall, 2)
+        catch_body = args and inline_body(args[1])
+        if catch_body is None:
+            return False
+        clauses.append((args[0], catch_body))
+
+    fallback, catch_clauses, done = Label(), Label(), Label()
+    emit_syntax_guard(function, "try..", fallback)
+
+    # the body runs with a handler registered, which costs nothing until
+    # something is actually thrown
+    function.add(TRY_START, "", [], [catch_clauses], [])
+    function.try_depth += 1
+    emit_inline_body(function, body)
+    function.try_depth -= 1
+    function.add(TRY_END, "", [], [], [])
+    function.add(JUMP, "", [], [done], [])
+
+    # the VM jumps here with the exception on the stack
+    function.add_label(catch_clauses)
+    for exception_type, catch_body in clauses:
+        next_clause = Label()
+        function.compile_node(exception_type)
+        function.add(CATCH_MATCH, "", [], [next_clause], [])
+        for statement in catch_body:
+            function.compiler.compile_statement(function, statement)
+        # a try that caught something has no value
+        function.add(PUSH_NOTHING, F_POP_RESULT, [], [], [])
+        function.add(JUMP, "", [], [done], [])
+        function.add_label(next_clause)
+    function.add(RETHROW, "", [], [], [])
+
+    function.add_label(fallback)
+    emit_fallback_call(function, node)
+    function.add_label(done)
+    return True
+
+
+LOWERINGS = [lower_if, lower_while, lower_for, lower_try]
+
+
+def code_units(operation):
+    """Returns the number of code units an operation takes up once the VM
+    loads it. This has to match the way the decoder expands operations."""
+    opcode, flags, pre, args, post = operation
+    if opcode in PSEUDO_OPS:
+        return 0
+    # every flag and every argument is a unit, and so is the operation
+    # itself (lazy calls also store how many arguments they have)
+    units = len(flags) + len(pre) + len(args) + len(post)
+    if opcode != NOP:
+        units += 1
+    if opcode == LAZY:
+        units += 1
+    return units
+
+
+def undo_lowering(function, start):
+    """Turns a lowered statement starting at 'start' back into a plain call.
+    The call is already there as the fallback - only the name fetch before
+    the guard is kept in front of it."""
+    code = function.code
+    guard = code[start + 1]
+    fallback = guard[3][-1]
+    fallback_at = code.index((LABEL, "", [], [fallback], []), start)
+    function.code = code[:start + 1] + code[fallback_at + 1:]
+
 ##############################################
 # Matching emit_* functions to node types
 ##############################################
@@ -169,6 +462,8 @@ EMITTERS = {
 
 PRE_FLAGS = {F_PUSH_LOCALS, F_FETCH_PROPERTY, F_CREATE_PROPERTY}
 POST_FLAGS = {F_POP_RESULT, F_STORE_VALUE}
+# operations that only mark positions in the code
+PSEUDO_OPS = {LABEL, LINE}
 
 
 def merge_nops_forward(func):
@@ -184,7 +479,9 @@ def merge_nops_forward(func):
         only_pre_flags = flag_set.issubset(PRE_FLAGS)
         if opcode == NOP and only_pre_flags and index < len(code) - 1:
             n_opcode, n_flags, n_pre, n_args, n_post = code[index + 1]
-            if flag_set.isdisjoint(set(n_flags)):
+            # jumps to a label have to land before the NOP, not after it,
+            # and it has to stay on the line it came from
+            if flag_set.isdisjoint(set(n_flags)) and n_opcode not in PSEUDO_OPS:
                 # merge the nop.xxx as preamble to the next instruction
                 code[index + 1] = (
                     n_opcode, flags + n_flags, pre + n_pre, args + n_args,
@@ -211,7 +508,7 @@ def merge_nops_backward(func):
         only_post_flags = flag_set.issubset(POST_FLAGS)
         if opcode == NOP and only_post_flags and index > 0:
             p_opcode, p_flags, p_pre, p_args, p_post = code[index - 1]
-            if flag_set.isdisjoint(set(p_flags)):
+            if flag_set.isdisjoint(set(p_flags)) and p_opcode not in PSEUDO_OPS:
                 # merge the nop.xxx into previous instruction
                 code[index - 1] = (
                     p_opcode, p_flags + flags, p_pre + pre, p_args + args,
@@ -227,6 +524,32 @@ def merge_nops_backward(func):
 
 OPTIMIZERS = [merge_nops_forward, merge_nops_backward]
 
+
+def resolve_positions(func):
+    """Replaces labels used as jump targets with the index of the operation
+    they point to, collects line markers into the function's line table,
+    and removes both from the code."""
+    positions, index = {}, 0
+    for opcode, flags, pre, args, post in func.code:
+        if opcode == LABEL:
+            positions[args[0]] = index
+        elif opcode == LINE:
+            if func.lines and func.lines[-1][0] == index:
+                func.lines.pop()
+            if not func.lines or func.lines[-1][1] != args[0]:
+                func.lines.append((index, args[0]))
+        else:
+            index += 1
+
+    def resolve(arg):
+        if isinstance(arg, Label):
+            return Reference.target(positions[arg])
+        return arg
+
+    func.code = [(opcode, flags, pre, list(map(resolve, args)), post)
+                 for opcode, flags, pre, args, post in func.code
+                 if opcode not in PSEUDO_OPS]
+
 ##############################################
 # Optimizers
 ##############################################
@@ -290,7 +613,7 @@ class ConstantCompiler:
 
         # generate code for them
         self.output.constants_header(len(all_constants))
-        for constant in all_constants:
+        for constant_type, constant in all_constants:
             self.output.constant(constant)
         self.output.constants_footer()
 
@@ -298,9 +621,15 @@ class ConstantCompiler:
         return {constant: index + 1 for index, constant in
                 enumerate(all_constants)}
 
+    @staticmethod
+    def constant_key(value):
+        """Returns the key a constant is stored under. The type is part of
+        the key, since 1 and 1.0 are equal in Python, but not in the pool."""
+        return (value.__class__, value)
+
     def add_occurrence(self, node):
         if node.kind in ConstantCompiler.CONST_NODES:
-            self.constant_occurrences[node.value] += 1
+            self.constant_occurrences[self.constant_key(node.value)] += 1
 
 ##############################################
 # Compiling actual code
@@ -326,6 +655,16 @@ class Reference:
     def argument_name(cls, index):
         return cls(REF_ARGNAME, index)
 
+    @classmethod
+    def target(cls, index):
+        return cls(REF_TARGET, index)
+
+
+class Label:
+    """A position in a function's code that jumps can target. Resolved into
+    a target reference once the code is final."""
+    pass
+
 
 class CompiledFunction:
     """Represents a single September function."""
@@ -338,6 +677,12 @@ class CompiledFunction:
         self.index = index
         self.params = params
         self.code = []
+        # how many lowered loops and try statements the code being compiled
+        # is nested in
+        self.loop_depth = 0
+        self.try_depth = 0
+        # (operation index, source line) pairs, filled in at the very end
+        self.lines = []
 
     def compile_node(self, node):
         self.compiler.compile_node(self, node)
@@ -357,6 +702,15 @@ class CompiledFunction:
                                         [pre_args, args, post_args])
         self.code += [(opcode, flags, pre_args, args, post_args)]
 
+    def add_label(self, label):
+        """Marks the current position in the code with a label."""
+        self.code += [(LABEL, "", [], [label], [])]
+
+    def add_line(self, line):
+        """Marks the current position as the start of code from a source line."""
+        if line is not None:
+            self.code += [(LINE, "", [], [line], [])]
+
 class CodeCompiler:
     """Walks over the AST and compiles all the functions contained within,
     starting from the root function of the module.
@@ -366,10 +720,12 @@ class CodeCompiler:
         self.output = output
         self.constants = constants
         self.functions = []
+        # flow control is not lowered while this is above zero
+        self.lowering_disabled_depth = 0
 
     def find_constant_index(self, constant):
         try:
-            return self.constants[constant]
+            return self.constants[ConstantCompiler.constant_key(constant)]
         except KeyError:
             raise CompilationError("Constant %s is not in the constant index." % constant)
 
@@ -396,6 +752,8 @@ class CodeCompiler:
                 self.create_references(thing.value))
         if isinstance(thing, CompiledFunction):
             return [Reference.function(thing.index)]
+        if isinstance(thing, Label):
+            return [thing]
         else:
             return [Reference.constant(self.find_constant_index(thing))]
 
@@ -415,11 +773,32 @@ class CodeCompiler:
 
         # compile the body
         for statement in statements:
-            self.compile_node(func, statement)
-            func.add(NOP, F_POP_RESULT, [], [], [])
+            self.compile_statement(func, statement)
 
         return func
 
+    def compile_statement(self, func, statement):
+        """Emits code for a statement, popping its result afterwards."""
+        func.add_line(statement.line)
+        if not self.lowering_disabled_depth:
+            for lowering in LOWERINGS:
+                start = len(func.code)
+                if lowering(func, statement):
+                    lowered = func.code[start:]
+                    if sum(map(code_units, lowered)) > MAX_LOWERED_CODE_UNITS:
+                        undo_lowering(func, start)
+                    return
+        self.compile_node(func, statement)
+        func.add(NOP, F_POP_RESULT, [], [], [])
+
+    @contextlib.contextmanager
+    def lowering_disabled(self):
+        """Used when compiling the fallback for lowered flow control - lowering
+        it once more would only make the code bigger."""
+        self.lowering_disabled_depth += 1
+        yield
+        self.lowering_disabled_depth -= 1
+
     def compile_node(self, target_function, node):
         """Emits code for a single node into the provided function."""
         emitter = EMITTERS[node.kind]
@@ -435,12 +814,13 @@ class CodeCompiler:
         for func in self.functions:
             for optimizer in OPTIMIZERS:
                 optimizer(func)
+            resolve_positions(func)
 
         for func in self.functions:
             self.output.function_header(func.params)
             for line in func.code:
                 self.output.code(*line)
-            self.output.function_footer()
+            self.output.function_footer(func.lines)
 
 ##############################################
 # Debugging
@@ -483,7 +863,10 @@ class StringOutput:
         self.string += ",".join(param_names)
         self.string += "):\n"
 
-    def function_footer(self):
+    def function_footer(self, lines):
+        if lines:
+            lines = ["%d:%d" % line for line in lines]
+            self.string += "\tlines         %s\n" % ", ".join(lines)
         self.string += "\n"
 
     def file_header(self):
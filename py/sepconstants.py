@@ -12,6 +12,29 @@ NOP = "nop"
 PUSH = "push"
 LAZY = "lazy"
 
+### Flow control opcodes (all encoded as a single 'flow' opcode, followed by
+### a byte identifying the actual operation)
+JUMP = "jump"
+JUMP_UNLESS = "jumpunless"
+GUARD_SYNTAX = "guard"
+PUSH_NOTHING = "pushnothing"
+LOOP_START = "loopstart"
+FOR_START = "forstart"
+LOOP_NEXT = "loopnext"
+LOOP_END = "loopend"
+TRY_START = "trystart"
+TRY_END = "tryend"
+CATCH_MATCH = "catchmatch"
+RETHROW = "rethrow"
+
+### Element access, encoded the same way as flow control
+INDEX = "index"
+
+### Pseudo-opcodes marking the position jumps go to, and the position
+### where code from a new source line starts
+LABEL = "label"
+LINE = "line"
+
 ### Operation flags
 F_PUSH_LOCALS = "l"
 F_FETCH_PROPERTY = "f"
@@ -29,3 +52,4 @@ P_OPTIONAL = "optional"
 REF_CONSTANT = "constant"
 REF_FUNCTION = "function"
 REF_ARGNAME = "argname"
+REF_TARGET = "target"
@@ -8,6 +8,7 @@
 ##########################################################################
 
 import math
+import struct
 
 from sepconstants import *
 
@@ -22,6 +23,25 @@ OPCODE_ENCODING = {
     LAZY: 0x4
 }
 
+### Flow control operations, written as FLOW_OPCODE followed by one of
+### these (they match the opcodes used by the VM)
+FLOW_OPCODE = 0x2
+FLOW_ENCODING = {
+    JUMP: 0x10,
+    JUMP_UNLESS: 0x11,
+    GUARD_SYNTAX: 0x12,
+    PUSH_NOTHING: 0x13,
+    LOOP_START: 0x14,
+    FOR_START: 0x15,
+    LOOP_NEXT: 0x16,
+    LOOP_END: 0x17,
+    TRY_START: 0x18,
+    TRY_END: 0x19,
+    CATCH_MATCH: 0x1A,
+    RETHROW: 0x1B,
+    INDEX: 0x1C
+}
+
 ### Bitmask for particular operation flags
 FLAG_ENCODING = {
     F_PUSH_LOCALS:    0x80,
@@ -47,10 +67,10 @@ PARAM_FLAG_ENCODING = {
 
 
 ### Constant types writable to the file
-# Note: float is not yet supported
 CONSTANT_TYPE = {
     int: 0x1,
-    str: 0x2
+    str: 0x2,
+    float: 0x3
 }
 
 ##############################################
@@ -59,7 +79,10 @@ CONSTANT_TYPE = {
 
 def encode_operation(operation, flags):
     """Encodes a flagged operation as a single-byte opcode."""
-    encoding = OPCODE_ENCODING[operation]
+    if operation in FLOW_ENCODING:
+        encoding = FLOW_OPCODE
+    else:
+        encoding = OPCODE_ENCODING[operation]
     for flag in flags:
         encoding |= FLAG_ENCODING[flag]
     return encoding
@@ -110,7 +133,8 @@ class ModuleFileOutput:
 
     def _write_ref(self, reference):
         """Encodes a constant/code pool reference inside the file."""
-        if reference.type == REF_CONSTANT:
+        if reference.type in (REF_CONSTANT, REF_TARGET):
+            # jump targets are just instruction indices
             self._write_int(reference.index)
         else:
             code = (reference.index << 1) | REFERENCE_TYPE_ENCODING[reference.type]
@@ -124,6 +148,12 @@ class ModuleFileOutput:
         self._write_int(len(utf8encoding))
         self.file.write(utf8encoding)
 
+    def _write_float(self, float_value):
+        """Encodes a float inside the file.
+        The encoding is simply the 8 bytes of an IEEE double, big-endian.
+        """
+        self.file.write(struct.pack(">d", float_value))
+
     def constants_header(self, num_constants):
         """Writes the module constants header for the given number of
         constants."""
@@ -140,6 +170,8 @@ class ModuleFileOutput:
 
         if isinstance(value, int):
             self._write_int(value)
+        if isinstance(value, float):
+            self._write_float(value)
         if isinstance(value, str):
             self._write_str(value)
 
@@ -166,9 +198,16 @@ class ModuleFileOutput:
                 self._write_ref(parameter.default_value_ref)
             self._write_str(param_name)
 
-    def function_footer(self):
-        """Writes the function footer after the function's code is encoded."""
+    def function_footer(self, lines):
+        """Writes the function footer after the function's code is encoded.
+        The footer holds the line table for debugging - a list of
+        (operation index, source line) pairs.
+        """
         self._write_byte(0xff)
+        self._write_int(len(lines))
+        for index, line in lines:
+            self._write_int(index)
+            self._write_int(line)
 
     def code(self, opcode, flags, pre, args, post):
         """Writes a single instruction with the parameters provided.
@@ -179,6 +218,8 @@ class ModuleFileOutput:
         self._write_byte(encode_operation(opcode, flags))
         for arg in pre:
             self._write_ref(arg)
+        if opcode in FLOW_ENCODING:
+            self._write_byte(FLOW_ENCODING[opcode])
         if is_vararg(opcode):
             self._write_int(len(args))
         for arg in args:
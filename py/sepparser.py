@@ -31,6 +31,8 @@ class Node:
                              # magic that Python does
         self.value = value
         self.children = []
+        # the source line the node starts on, if known
+        self.line = None
         if children_names:
             # create a mapping from name to its index
             self.name_map = dict(zip(children_names,
@@ -758,6 +760,17 @@ class Parser:
         or the next operator has precedence lower than the minimum specified.
         This ensures correct operator nesting.
         """
+        location = getattr(self.token, "location", None)
+        expression = self.expression_terms(min_precedence)
+
+        # remember where it started for debugging information
+        if expression.line is None and location:
+            expression.line = location[0]
+        return expression
+
+    def expression_terms(self, min_precedence):
+        """Parses the terms and operators making up an expression - used
+        by expression()."""
 
         # read the first term
         expression = None
@@ -0,0 +1,190 @@
+/*****************************************************************
+ **
+ ** benchmarks/exceptions.c
+ **
+ ** Measures how much creating an exception costs with and without
+ ** capturing its backtrace, for call stacks of varying depth, and
+ ** how much turning that backtrace into 'module:line' costs later.
+ ** Also compares lazily formatted messages with eager ones.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <septvm.h>
+
+// ===============================================================
+//  A fake call stack
+// ===============================================================
+
+// The number of code units in the block every frame is running.
+#define BLOCK_LENGTH 64
+// The number of entries in that block's line table.
+#define BLOCK_LINES 16
+
+CodeUnit code[BLOCK_LENGTH];
+CodeBlock block;
+
+// Sets up a code block with a line table, so that it can be symbolised.
+void create_block() {
+	LineTable *lines = mem_unmanaged_allocate(sizeof(LineTable) + BLOCK_LINES * sizeof(LineEntry));
+	lines->count = BLOCK_LINES;
+	int entry;
+	for (entry = 0; entry < BLOCK_LINES; entry++) {
+		lines->entries[entry].offset = entry * (BLOCK_LENGTH / BLOCK_LINES);
+		lines->entries[entry].line = entry + 1;
+	}
+
+	block.module = NULL;
+	block.parameter_count = 0;
+	block.parameters = NULL;
+	block.instructions = code;
+	block.instructions_end = code + BLOCK_LENGTH;
+	block.lines = lines;
+}
+
+// Creates a VM that looks like it's 'depth' interpreted calls deep. Nothing
+// ever runs in it - it's only there for the backtrace to be taken from, but
+// it has to be in a good enough shape for the GC to go through it.
+SepVM *create_call_stack(int depth, SepFunc *function) {
+	SepVM *vm = calloc(1, sizeof(SepVM));
+	vm->data = stack_create();
+	int f;
+	for (f = 0; f < depth; f++) {
+		ExecutionFrame *frame = &vm->frames[f];
+		frame->vm = vm;
+		frame->function = function;
+		frame->block = &block;
+		frame->instruction_ptr = code + 1 + (f * 7) % (BLOCK_LENGTH - 1);
+		frame->data = vm->data;
+		frame->locals = SEPV_NOTHING;
+		frame->return_value = si_nothing();
+		ga_init(&frame->gc_roots, 4, sizeof(SepV), &allocator_unmanaged);
+		frame->prev_frame = f ? frame - 1 : NULL;
+	}
+	vm->frame_depth = depth - 1;
+	return vm;
+}
+
+void free_call_stack(SepVM *vm) {
+	int f;
+	for (f = 0; f <= vm->frame_depth; f++)
+		ga_free_entries(&vm->frames[f].gc_roots);
+	stack_free(vm->data);
+	free(vm);
+}
+
+// ===============================================================
+//  Measurements
+// ===============================================================
+
+// The property name used in the messages, the way EMissingProperty uses it.
+SepString *property_name;
+
+// Creates 'count' exceptions in a given VM, and returns the average time
+// taken by a single one in nanoseconds. Exceptions are created in batches,
+// with the VM swapped out while the GC cleans up after each of them. The
+// message is formatted right away if 'eager' is set.
+double time_exceptions(SepVM *vm, SepObj *prototype, bool eager, int count) {
+	const int BATCH = 10000;
+
+	clock_t total = 0;
+	int done, index;
+	for (done = 0; done < count; done += BATCH) {
+		gc_start_context();
+		lsvm_globals.set_vm_for_current_thread(vm);
+		clock_t start = clock();
+		if (eager) {
+			for (index = 0; index < BATCH; index++)
+				sepv_exception(prototype, sepstr_sprintf("Property '%.*s' does not exist.",
+						property_name->length, property_name->cstr));
+		} else {
+			for (index = 0; index < BATCH; index++)
+				sepv_exceptionf(prototype, "Property '%.*s' does not exist.",
+						property_name->length, property_name->cstr);
+		}
+		total += clock() - start;
+		// everything got registered in the innermost frame, which never finishes
+		ga_clear(&vm->frames[vm->frame_depth].gc_roots);
+		lsvm_globals.set_vm_for_current_thread(NULL);
+		gc_end_context();
+	}
+
+	double seconds = (double)total / CLOCKS_PER_SEC;
+	return seconds * 1e9 / count;
+}
+
+// Symbolises the whole backtrace of an exception 'count' times, and returns
+// the average time taken for a single backtrace in nanoseconds.
+double time_symbolising(SepV exception, int count) {
+	Backtrace *backtrace = exception_backtrace(exception);
+	int round;
+	uint32_t entry;
+	clock_t start = clock();
+	for (round = 0; round < count; round++) {
+		gc_start_context();
+		for (entry = 0; entry < backtrace->depth; entry++)
+			backtrace_describe(&backtrace->entries[entry]);
+		gc_end_context();
+	}
+	clock_t end = clock();
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return seconds * 1e9 / count;
+}
+
+// Runs the benchmark for a call stack 'depth' frames deep.
+void benchmark_depth(int depth, SepFunc *function, SepObj *prototype) {
+	const int EXCEPTIONS = 1000000;
+	const int SYMBOLISATIONS = 20000;
+
+	SepVM *vm = create_call_stack(depth, function);
+
+	*lsvm_globals.capture_backtraces = false;
+	double without = time_exceptions(vm, prototype, false, EXCEPTIONS);
+	*lsvm_globals.capture_backtraces = true;
+	double with = time_exceptions(vm, prototype, false, EXCEPTIONS);
+	double eager = time_exceptions(vm, prototype, true, EXCEPTIONS);
+
+	lsvm_globals.set_vm_for_current_thread(vm);
+	SepV exception = sepv_exception(prototype, property_name);
+	lsvm_globals.set_vm_for_current_thread(NULL);
+	gc_register(exception);
+	double symbolising = time_symbolising(exception, SYMBOLISATIONS);
+
+	printf("%8d %14.2f %14.2f %14.2f %16.2f\n", depth, without, with, eager, symbolising);
+	free_call_stack(vm);
+}
+
+// ===============================================================
+//  Entry point
+// ===============================================================
+
+int main(int argc, char **argv) {
+	const int DEPTHS[] = {1, 8, 32, 100, 0};
+
+	libseptvm_initialize();
+	create_block();
+
+	gc_start_context();
+	SepFunc *function = (SepFunc*)ifunc_create(&block, SEPV_NOTHING);
+	SepObj *prototype = obj_create();
+	property_name = sepstr_for("someProperty");
+
+	printf("%8s %14s %14s %14s %16s\n", "depth", "no trace (ns)", "trace (ns)",
+			"eager (ns)", "symbolise (ns)");
+	const int *depth;
+	for (depth = DEPTHS; *depth; depth++)
+		benchmark_depth(*depth, function, prototype);
+
+	gc_end_context();
+	return 0;
+}
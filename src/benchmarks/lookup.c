@@ -0,0 +1,104 @@
+/*****************************************************************
+ **
+ ** benchmarks/lookup.c
+ **
+ ** Measures the performance of property lookups going through
+ ** chains of prototypes of varying depth, the way methods are
+ ** found on instances of classes.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <septvm.h>
+
+// ===============================================================
+//  Measurements
+// ===============================================================
+
+// The number of properties in each object of the chain.
+#define PROPERTIES_PER_OBJECT 12
+
+// Builds a chain of 'depth' prototypes, each with its own set of properties,
+// and returns an object inheriting from the last one. The names of the
+// properties in the root of the chain are written to 'root_names'.
+SepObj *build_chain(int depth, SepString **root_names) {
+	char buffer[32];
+	SepV prototype = SEPV_NOTHING;
+	int level, index;
+	for (level = 0; level < depth; level++) {
+		SepObj *object = obj_create_with_proto(prototype);
+		for (index = 0; index < PROPERTIES_PER_OBJECT; index++) {
+			sprintf(buffer, "level%dMethod%d", level, index);
+			SepString *name = sepstr_for(buffer);
+			props_add_prop(object, name, &st_field, int_to_sepv(index));
+			if (level == 0)
+				root_names[index] = name;
+		}
+		prototype = obj_to_sepv(object);
+	}
+	return obj_create_with_proto(prototype);
+}
+
+// Looks up all the names from 'instance' 'rounds' times, and returns the
+// average time taken by a single lookup in nanoseconds.
+double time_lookups(SepObj *instance, SepString **names, int rounds) {
+	SepV instance_v = obj_to_sepv(instance);
+	SepV err = SEPV_NOTHING;
+	int round, index, found = 0;
+	clock_t start = clock();
+	for (round = 0; round < rounds; round++) {
+		for (index = 0; index < PROPERTIES_PER_OBJECT; index++) {
+			if (sepv_lookup(instance_v, names[index], NULL, &err))
+				found++;
+		}
+	}
+	clock_t end = clock();
+
+	// sanity check, which also keeps the loop from being optimized away
+	if (found != PROPERTIES_PER_OBJECT * rounds) {
+		fprintf(stderr, "Lookup results are wrong: %d found.\n", found);
+		exit(1);
+	}
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return seconds * 1e9 / ((double)PROPERTIES_PER_OBJECT * rounds);
+}
+
+// Runs the benchmark for a chain of 'depth' prototypes.
+void benchmark_chain(int depth) {
+	const int LOOKUPS = 12000000;
+
+	SepString *root_names[PROPERTIES_PER_OBJECT];
+	SepObj *instance = build_chain(depth, root_names);
+
+	double lookup_time = time_lookups(instance, root_names, LOOKUPS / PROPERTIES_PER_OBJECT);
+	printf("%8d %12.2f\n", depth, lookup_time);
+}
+
+// ===============================================================
+//  Entry point
+// ===============================================================
+
+int main(int argc, char **argv) {
+	const int DEPTHS[] = {1, 2, 4, 8, 0};
+
+	libseptvm_initialize();
+	gc_start_context();
+
+	printf("%8s %12s\n", "depth", "lookup (ns)");
+	const int *depth;
+	for (depth = DEPTHS; *depth; depth++)
+		benchmark_chain(*depth);
+
+	gc_end_context();
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*****************************************************************
+ **
+ ** benchmarks/parallel.c
+ **
+ ** Measures how parallel sorting of a large array of integers
+ ** scales with the number of threads used.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <septvm.h>
+#include <common/sorting.h>
+
+// ===============================================================
+//  Sorting
+// ===============================================================
+
+#define less_int(context, a, b) ((a) < (b))
+#define never_stopped(context) false
+
+DEFINE_INTROSORT(sort_ints, int64_t, less_int, void, never_stopped)
+DEFINE_MERGE(merge_ints, int64_t, less_int, void)
+
+static void sort_chunk(void *elements, size_t count, void *context) {
+	sort_ints(elements, count, context);
+}
+
+static void merge_runs(void *out, const void *a, size_t na, const void *b, size_t nb, void *context) {
+	merge_ints(out, a, na, b, nb, context);
+}
+
+// ===============================================================
+//  Measurements
+// ===============================================================
+
+// The number of integers sorted.
+#define ELEMENTS (4 * 1024 * 1024)
+
+// Returns the wall-clock time in seconds - clock() would add up the time of all threads.
+double wall_time() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Fills an array with pseudo-random integers, the same ones every time.
+void fill_random(int64_t *elements, size_t count) {
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	size_t index;
+	for (index = 0; index < count; index++) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		elements[index] = (int64_t)state;
+	}
+}
+
+// Sorts the same array using 'threads' threads, and returns the time taken in milliseconds.
+double time_sort(int64_t *elements, size_t count, uint32_t threads) {
+	fill_random(elements, count);
+	parallel_set_thread_count(threads);
+
+	double start = wall_time();
+	parallel_sort(elements, count, sizeof(int64_t), &sort_chunk, &merge_runs, NULL);
+	double end = wall_time();
+
+	// sanity check
+	size_t index;
+	for (index = 1; index < count; index++) {
+		if (elements[index - 1] > elements[index]) {
+			fprintf(stderr, "The array is not sorted at index %zu.\n", index);
+			exit(1);
+		}
+	}
+
+	return (end - start) * 1e3;
+}
+
+// ===============================================================
+//  Entry point
+// ===============================================================
+
+int main(int argc, char **argv) {
+	libseptvm_initialize();
+
+	// goes up to the number of CPUs, unless told otherwise
+	uint32_t max_threads = (argc > 1) ? (uint32_t)atoi(argv[1]) : parallel_thread_count();
+	if (max_threads < 1)
+		max_threads = 1;
+	int64_t *elements = malloc(ELEMENTS * sizeof(int64_t));
+
+	printf("%8s %12s %10s\n", "threads", "sort (ms)", "speedup");
+	double single = time_sort(elements, ELEMENTS, 1);
+	printf("%8d %12.2f %10.2f\n", 1, single, 1.0);
+
+	uint32_t threads;
+	for (threads = 2; threads <= max_threads; threads *= 2) {
+		double time = time_sort(elements, ELEMENTS, threads);
+		printf("%8d %12.2f %10.2f\n", threads, time, single / time);
+	}
+	if ((max_threads & (max_threads - 1)) != 0) {
+		double time = time_sort(elements, ELEMENTS, max_threads);
+		printf("%8d %12.2f %10.2f\n", max_threads, time, single / time);
+	}
+
+	free(elements);
+	return 0;
+}
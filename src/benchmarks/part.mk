@@ -0,0 +1,58 @@
+# ==========================
+# File lists
+# ==========================
+
+BENCH_DIR := src/benchmarks
+BENCH_BIN_DIR := $(BIN_DIR)/benchmarks
+
+BENCH_SOURCE_FILES := $(wildcard $(BENCH_DIR)/*.c)
+
+BENCH_OBJECTS = $(BENCH_SOURCE_FILES:.c=.o)
+BENCH_DEPENDENCIES = $(BENCH_SOURCE_FILES:.c=.d)
+
+BENCH_LDFLAGS = -L$(LIB_DIR) -lseptvm -lpthread
+
+# ==========================
+# System dependent parts
+# ==========================
+
+ifeq ($(PLATFORM),MinGW)
+  BENCH_EXEC_SUFFIX = .exe
+else
+  BENCH_EXEC_SUFFIX =
+endif
+BENCH_EXECUTABLES := $(patsubst $(BENCH_DIR)/%.c,$(BENCH_BIN_DIR)/%$(BENCH_EXEC_SUFFIX),$(BENCH_SOURCE_FILES))
+
+# ==========================
+# Executables
+# ==========================
+
+.PHONY: benchmarks benchmarks-clean benchmarks-distclean
+
+benchmarks: $(BENCH_EXECUTABLES)
+
+$(BENCH_BIN_DIR)/%$(BENCH_EXEC_SUFFIX): $(BENCH_DIR)/%.o $(LIBSVM_TARGET_LIB) | $(BENCH_BIN_DIR)
+	$(CC) $< $(BENCH_LDFLAGS) -o$@
+
+$(BENCH_BIN_DIR): | $(BIN_DIR)
+	$(MKDIR) $(call fix_paths,$(BENCH_BIN_DIR))
+
+# ==========================
+# Cleaning
+# ==========================
+
+benchmarks-clean:
+	$(RM) $(call fix_paths,$(BENCH_EXECUTABLES) $(BENCH_OBJECTS))
+	-$(RMDIR) $(call fix_paths,$(BENCH_BIN_DIR))
+
+benchmarks-distclean: benchmarks-clean
+	$(RM) $(call fix_paths,$(BENCH_DEPENDENCIES))
+
+# ==========================
+# Autogenerated dependencies
+# ==========================
+
+# cleaning does not need dependencies
+ifeq (,$(findstring clean,$(MAKECMDGOALS)))
+    -include $(BENCH_DEPENDENCIES)
+endif
@@ -0,0 +1,199 @@
+/*****************************************************************
+ **
+ ** benchmarks/propmap.c
+ **
+ ** Measures the performance of property maps on realistic sets
+ ** of property names - the time taken by successful and failed
+ ** lookups and by insertions, and the memory taken by the
+ ** property table.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <septvm.h>
+
+// ===============================================================
+//  Property name sets
+// ===============================================================
+
+// Names actually used by the runtime and the standard prototypes.
+const char *RUNTIME_NAMES[] = {
+	"length", "at", "view", "iterator", "next", "toString", "upperCase",
+	"prototypes", "resolve", "resolveAsLiteral", "accept", "spawn", "is",
+	"message", "start", "end", "openEnded", "current", "range", "sum",
+	"normalizeIndex", "normalizeIndexSequence", "normalizeIndexRange",
+	"join", "map", "filter", "realize", "source", "function", "condition",
+	"print", "if", "elseif", "else", "while", "for", "in", "try", "catch",
+	"finally", "throw", "break", "continue", "return", "export", "this",
+	"locals", "syntax", "globals", "Object", "Array", "Integer", "String",
+	"Bool", "Function", "Slot", "Class", "Exception", "Range", "Sequence",
+	"<class>", "<superclass>", "<name>", "<constructor>", "<compareTo>",
+	"+", "-", "*", "/", "%", "==", "!=", "<", ">",
+	"<=", ">=", "..", "...", "!", "&&", "||", "[]", "field", "method",
+	NULL
+};
+
+// Prefixes and nouns used to generate typical camelCase member names.
+const char *PREFIXES[] = {"get", "set", "is", "has", "on", "to", "find", "create", NULL};
+const char *NOUNS[] = {"Name", "Value", "Index", "Count", "Parent", "Child", "Item", "Key",
+	"Node", "Size", "State", "Handler", "Buffer", "Position", "Width", "Height", NULL};
+
+// Fills 'names' with 'count' property names - first the runtime ones, then
+// generated camelCase names, then numbered fields.
+void generate_names(const char **names, char *storage, int count) {
+	int index = 0;
+	const char **name;
+	for (name = RUNTIME_NAMES; *name && index < count; name++)
+		names[index++] = *name;
+
+	const char **prefix, **noun;
+	for (prefix = PREFIXES; *prefix && index < count; prefix++) {
+		for (noun = NOUNS; *noun && index < count; noun++) {
+			sprintf(storage, "%s%s", *prefix, *noun);
+			names[index++] = storage;
+			storage += strlen(storage) + 1;
+		}
+	}
+
+	int field = 0;
+	while (index < count) {
+		sprintf(storage, "field%d", field++);
+		names[index++] = storage;
+		storage += strlen(storage) + 1;
+	}
+}
+
+// ===============================================================
+//  Measurements
+// ===============================================================
+
+// Returns the number of bytes allocated for the property table of a map,
+// read from the header the memory manager puts in front of every block.
+size_t table_bytes(PropertyMap *map) {
+	// inline entries are a part of the object itself
+	if (map->inline_storage)
+		return map->capacity * sizeof(PropertyEntry);
+	UsedBlockHeader *header = (UsedBlockHeader*)((char*)map->entries - ALLOCATION_UNIT);
+	return header->size * ALLOCATION_UNIT;
+}
+
+// Looks up all the keys provided 'rounds' times, and returns the average time
+// taken by a single lookup in nanoseconds.
+double time_lookups(SepObj *map, SepString **keys, int count, int rounds, bool expect_found) {
+	int round, index, found = 0;
+	clock_t start = clock();
+	for (round = 0; round < rounds; round++) {
+		for (index = 0; index < count; index++) {
+			if (props_find_prop(map, keys[index]))
+				found++;
+		}
+	}
+	clock_t end = clock();
+
+	// sanity check, which also keeps the loop from being optimized away
+	if (found != (expect_found ? count * rounds : 0)) {
+		fprintf(stderr, "Lookup results are wrong: %d found.\n", found);
+		exit(1);
+	}
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return seconds * 1e9 / ((double)count * rounds);
+}
+
+// Builds maps with all the names 'rounds' times, and returns the average time
+// taken by a single insertion in nanoseconds.
+double time_inserts(SepString **names, int count, int rounds) {
+	int round, index;
+	clock_t start = clock();
+	for (round = 0; round < rounds; round++) {
+		// each map gets its own GC context, so that it can be collected
+		// once we're done with it
+		gc_start_context();
+		SepObj *map = obj_create_with_proto(SEPV_NOTHING);
+		for (index = 0; index < count; index++)
+			props_add_prop(map, names[index], &st_field, int_to_sepv(index));
+		gc_end_context();
+	}
+	clock_t end = clock();
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return seconds * 1e9 / ((double)count * rounds);
+}
+
+// Runs the benchmark for a map with 'count' properties.
+void benchmark_map(int count) {
+	// total number of lookups and insertions to do in each measurement
+	const int LOOKUPS = 4000000;
+	const int INSERTS = 400000;
+
+	const char **names = malloc(sizeof(char*) * count);
+	char *storage = malloc(count * 32);
+	generate_names(names, storage, count);
+
+	// build the map out of interned names, like the runtime does
+	SepObj *map = obj_create_with_proto(SEPV_NOTHING);
+	SepString **interned = malloc(sizeof(SepString*) * count);
+	int index;
+	for (index = 0; index < count; index++) {
+		interned[index] = sepstr_for(names[index]);
+		props_add_prop(map, interned[index], &st_field, int_to_sepv(index));
+	}
+
+	// look the properties up using separate string instances, as happens
+	// with names coming from constant pools or computed at runtime
+	SepString **hits = malloc(sizeof(SepString*) * count);
+	SepString **misses = malloc(sizeof(SepString*) * count);
+	char buffer[64];
+	for (index = 0; index < count; index++) {
+		hits[index] = sepstr_new(names[index]);
+		sprintf(buffer, "%s_", names[index]);
+		misses[index] = sepstr_new(buffer);
+	}
+
+	int rounds = LOOKUPS / count;
+	double hit_time = time_lookups(map, hits, count, rounds, true);
+	double miss_time = time_lookups(map, misses, count, rounds, false);
+
+	int insert_rounds = INSERTS / count;
+	double insert_time = time_inserts(interned, count, insert_rounds ? insert_rounds : 1);
+	double bytes_per_property = (double)table_bytes(&map->props) / count;
+
+	printf("%8d %12.2f %12.2f %12.2f %12.1f\n", count,
+			hit_time, miss_time, insert_time, bytes_per_property);
+
+	free(interned);
+	free(hits);
+	free(misses);
+	free(names);
+	free(storage);
+}
+
+// ===============================================================
+//  Entry point
+// ===============================================================
+
+int main(int argc, char **argv) {
+	const int SIZES[] = {4, 16, 64, 256, 1024, 4096, 0};
+
+	libseptvm_initialize();
+	gc_start_context();
+
+	printf("%8s %12s %12s %12s %12s\n", "props",
+			"hit (ns)", "miss (ns)", "insert (ns)", "bytes/prop");
+	const int *size;
+	for (size = SIZES; *size; size++)
+		benchmark_map(*size);
+
+	gc_end_context();
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*****************************************************************
+ **
+ ** benchmarks/stack.c
+ **
+ ** Measures the data stack operations the interpreter does the
+ ** most - pushing and popping r-values for arithmetic, and
+ ** replacing an object with one of its properties as an l-value.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <septvm.h>
+
+// ===============================================================
+//  Measurements
+// ===============================================================
+
+// Does what 'a + b' does to the stack 'count' times, and returns the average
+// time taken by one such operation in nanoseconds.
+double time_arithmetic(SepStack *stack, int count) {
+	SepInt total = 0;
+	int index;
+	clock_t start = clock();
+	for (index = 0; index < count; index++) {
+		stack_push_rvalue(stack, int_to_sepv(index));
+		stack_push_rvalue(stack, int_to_sepv(2));
+		SepInt b = sepv_to_int(stack_pop_value(stack));
+		SepInt a = sepv_to_int(stack_pop_value(stack));
+		stack_push_rvalue(stack, int_to_sepv(a + b));
+		total += sepv_to_int(stack_pop_value(stack));
+	}
+	clock_t end = clock();
+
+	// sanity check, which also keeps the loop from being optimized away
+	if (total != (SepInt)count * (count + 3) / 2) {
+		fprintf(stderr, "Arithmetic results are wrong: %lld.\n", (long long)total);
+		exit(1);
+	}
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return seconds * 1e9 / count;
+}
+
+// Does what 'object.property' does to the stack 'count' times, and returns
+// the average time taken by one such operation in nanoseconds.
+double time_property(SepStack *stack, SepObj *host, SepString *name, int count) {
+	SepV host_v = obj_to_sepv(host);
+	Slot *slot = props_find_prop(host, name);
+	int index, found = 0;
+	clock_t start = clock();
+	for (index = 0; index < count; index++) {
+		stack_push_rvalue(stack, host_v);
+		SepItem property = item_property_lvalue(host_v, host_v, name, slot, slot->value);
+		stack_replace_top(stack, property);
+		SepItem popped = stack_pop_item(stack);
+		if (popped.slot == slot)
+			found++;
+	}
+	clock_t end = clock();
+
+	if (found != count) {
+		fprintf(stderr, "Property results are wrong: %d found.\n", found);
+		exit(1);
+	}
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return seconds * 1e9 / count;
+}
+
+// Fills the stack up to 'depth' items, every fourth one an l-value, and drops
+// them all at once, 'rounds' times. Returns the average time per item pushed
+// in nanoseconds.
+double time_filling(SepStack *stack, SepObj *host, SepString *name, int depth, int rounds) {
+	SepV host_v = obj_to_sepv(host);
+	Slot *slot = props_find_prop(host, name);
+	int round, index;
+	clock_t start = clock();
+	for (round = 0; round < rounds; round++) {
+		for (index = 0; index < depth; index++) {
+			if (index % 4 == 3)
+				stack_push_item(stack, item_property_lvalue(host_v, host_v, name, slot, slot->value));
+			else
+				stack_push_rvalue(stack, int_to_sepv(index));
+		}
+		stack_truncate(stack, 0);
+	}
+	clock_t end = clock();
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return seconds * 1e9 / ((double)depth * rounds);
+}
+
+// ===============================================================
+//  Entry point
+// ===============================================================
+
+int main(int argc, char **argv) {
+	const int OPERATIONS = 50000000;
+	const int FILL_DEPTH = 256;
+
+	libseptvm_initialize();
+	gc_start_context();
+
+	SepStack *stack = stack_create();
+	SepObj *host = obj_create();
+	SepString *name = sepstr_for("property");
+	obj_add_field(host, "property", int_to_sepv(42));
+
+	printf("%16s %16s %16s\n", "arithmetic (ns)", "property (ns)", "filling (ns)");
+	printf("%16.2f %16.2f %16.2f\n",
+			time_arithmetic(stack, OPERATIONS),
+			time_property(stack, host, name, OPERATIONS),
+			time_filling(stack, host, name, FILL_DEPTH, OPERATIONS / FILL_DEPTH));
+
+	stack_free(stack);
+	gc_end_context();
+	return 0;
+}
@@ -39,14 +39,19 @@ enum ExitCodes {
 // ===============================================================
 
 void report_exception(SepV exception_v) {
+	// the message and the backtrace are only rendered now, so we need
+	// a place for the strings that creates
+	gc_start_context();
+
 	// wound up with an exception, extract it
 	exception_v = exception_to_obj_sepv(exception_v);
+	gc_register(exception_v);
 
 	const char *class_name, *message;
 	SepV class_v = property(exception_v, "<class>");
 	SepV class_name_v = property(class_v, "<name>");
 	if (sepv_is_str(class_name_v))
-		class_name = sepv_to_str(class_name_v)->cstr;
+		class_name = sepstr_flatten(sepv_to_str(class_name_v))->cstr;
 	else
 		class_name = "<unknown type>";
 
@@ -54,12 +59,22 @@ void report_exception(SepV exception_v) {
 	if (property_exists(exception_v, "message")) {
 		SepV message_sepv = property(exception_v, "message");
 		if (sepv_is_str(message_sepv))
-			message = sepv_to_str(message_sepv)->cstr;
+			message = sepstr_flatten(sepv_to_str(message_sepv))->cstr;
 	}
 
 	// report it
 	fprintf(stderr, "Exception encountered during execution:\n");
 	fprintf(stderr, "  %s: %s\n", class_name, message);
+
+	// only now do we work out where it came from
+	Backtrace *backtrace = exception_backtrace(exception_v);
+	uint32_t entry;
+	for (entry = 0; backtrace && (entry < backtrace->depth); entry++) {
+		SepString *location = backtrace_describe(&backtrace->entries[entry]);
+		fprintf(stderr, "    at %s\n", sepstr_flatten(location)->cstr);
+	}
+
+	gc_end_context();
 }
 
 // ===============================================================
@@ -127,6 +127,13 @@ void ga_clear(GenericArray *this) {
 	this->end = this->start;
 }
 
+// Truncates the array to a given length, if it's longer than that.
+void ga_truncate(GenericArray *this, uint32_t length) {
+	void *new_end = this->start + length * this->element_size;
+	if (new_end < this->end)
+		this->end = new_end;
+}
+
 // Gets the length of this array.
 uint32_t ga_length(GenericArray *this) {
 	return (this->end - this->start) / this->element_size;
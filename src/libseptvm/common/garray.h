@@ -53,6 +53,8 @@ void *ga_set(GenericArray *this, uint32_t index, void *value_ptr);
 void ga_grow(GenericArray *this, uint32_t cells);
 // Clears the array, truncating it to 0 entries, but keeping its storage intact.
 void ga_clear(GenericArray *this);
+// Truncates the array to a given length, if it's longer than that.
+void ga_truncate(GenericArray *this, uint32_t length);
 // Gets the length of this array.
 uint32_t ga_length(GenericArray *this);
 // Finds an object in the array (memcmp is used for comparison) and returns its index, or -1 if the object is not found.
@@ -0,0 +1,268 @@
+/*****************************************************************
+ **
+ ** parallel.c
+ **
+ ** Implementation of the worker thread pool and parallel sorting.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+#include "parallel.h"
+#include "../vm/mem.h"
+
+// ===============================================================
+//  Thread pool - privates
+// ===============================================================
+
+// the most threads we'll ever use
+#define MAX_THREADS 64
+
+/**
+ * The pool is started lazily on first use, and its threads sleep on
+ * a condition variable between loops. A loop is published by bumping
+ * 'generation', after which every thread (including the caller) keeps
+ * claiming parts until there are none left.
+ */
+typedef struct ThreadPool {
+	// protects everything below
+	pthread_mutex_t lock;
+	// signalled when a new loop starts, and when a loop is finished
+	pthread_cond_t loop_started, loop_finished;
+	// only one parallel_for() can be running at a time
+	pthread_mutex_t running;
+
+	// the number of threads configured (including the caller) and started (excluding it)
+	uint32_t thread_count, started_workers;
+
+	// the current loop
+	uint64_t generation;
+	ParallelTask task;
+	void *data;
+	uint32_t parts, next_part, finished_parts;
+} ThreadPool;
+
+static ThreadPool pool = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	PTHREAD_MUTEX_INITIALIZER, 0, 0
+};
+
+// Returns the number of CPUs available.
+static uint32_t cpu_count() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long count = info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (count < 1) count = 1;
+	if (count > MAX_THREADS) count = MAX_THREADS;
+	return (uint32_t)count;
+}
+
+// Claims and runs parts of the current loop until there are none left.
+// Has to be called with the lock held, and returns with it held.
+static void pool_work() {
+	while (pool.next_part < pool.parts) {
+		uint32_t part = pool.next_part++;
+		pthread_mutex_unlock(&pool.lock);
+		pool.task(pool.data, part);
+		pthread_mutex_lock(&pool.lock);
+		if (++pool.finished_parts == pool.parts)
+			pthread_cond_signal(&pool.loop_finished);
+	}
+}
+
+// The body of each worker thread.
+static void *pool_worker(void *index_ptr) {
+	uint32_t index = (uint32_t)(uintptr_t)index_ptr;
+	uint64_t seen_generation = 0;
+
+	pthread_mutex_lock(&pool.lock);
+	while (true) {
+		while (pool.generation == seen_generation)
+			pthread_cond_wait(&pool.loop_started, &pool.lock);
+		seen_generation = pool.generation;
+
+		// workers above the configured count sit this one out
+		if (index + 1 < pool.thread_count)
+			pool_work();
+	}
+	return NULL;
+}
+
+// Makes sure enough worker threads are running for the configured count.
+// Has to be called with the lock held.
+static void pool_start_workers() {
+	if (!pool.thread_count)
+		pool.thread_count = cpu_count();
+
+	while (pool.started_workers + 1 < pool.thread_count) {
+		pthread_t thread;
+		pthread_attr_t attributes;
+		pthread_attr_init(&attributes);
+		pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+		int error = pthread_create(&thread, &attributes, &pool_worker, (void*)(uintptr_t)pool.started_workers);
+		pthread_attr_destroy(&attributes);
+		if (error) {
+			// couldn't start any more - make do with what we have
+			pool.thread_count = pool.started_workers + 1;
+			break;
+		}
+		pool.started_workers++;
+	}
+}
+
+// ===============================================================
+//  Thread pool - public
+// ===============================================================
+
+// Runs 'task' for each part in 0..parts-1, spreading them over the worker threads.
+void parallel_for(uint32_t parts, ParallelTask task, void *data) {
+	pthread_mutex_lock(&pool.running);
+	pthread_mutex_lock(&pool.lock);
+	pool_start_workers();
+
+	// single-threaded? no need to wake anybody up
+	if ((parts == 1) || (pool.thread_count == 1)) {
+		pthread_mutex_unlock(&pool.lock);
+		uint32_t part;
+		for (part = 0; part < parts; part++)
+			task(data, part);
+		pthread_mutex_unlock(&pool.running);
+		return;
+	}
+
+	// publish the loop and take part in it
+	pool.task = task;
+	pool.data = data;
+	pool.parts = parts;
+	pool.next_part = 0;
+	pool.finished_parts = 0;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.loop_started);
+	pool_work();
+
+	// wait for the parts still running on other threads
+	while (pool.finished_parts < pool.parts)
+		pthread_cond_wait(&pool.loop_finished, &pool.lock);
+
+	pthread_mutex_unlock(&pool.lock);
+	pthread_mutex_unlock(&pool.running);
+}
+
+// Returns the number of threads parallel loops use, including the calling thread.
+uint32_t parallel_thread_count() {
+	pthread_mutex_lock(&pool.lock);
+	if (!pool.thread_count)
+		pool.thread_count = cpu_count();
+	uint32_t count = pool.thread_count;
+	pthread_mutex_unlock(&pool.lock);
+	return count;
+}
+
+// Sets the number of threads parallel loops use. Defaults to the number of CPUs.
+void parallel_set_thread_count(uint32_t threads) {
+	pthread_mutex_lock(&pool.running);
+	pthread_mutex_lock(&pool.lock);
+	pool.thread_count = (threads < 1) ? 1 : ((threads > MAX_THREADS) ? MAX_THREADS : threads);
+	pthread_mutex_unlock(&pool.lock);
+	pthread_mutex_unlock(&pool.running);
+}
+
+// ===============================================================
+//  Parallel sorting
+// ===============================================================
+
+// arrays shorter than this are not worth splitting up
+#define PARALLEL_SORT_THRESHOLD 65536
+
+/**
+ * The state of a single parallel sort. The array is split into 'chunks'
+ * (a power of two) runs of roughly equal length, which are then merged
+ * pairwise, going back and forth between the array and a buffer.
+ */
+typedef struct ParallelSort {
+	size_t count, element_size;
+	SortFunc sort;
+	MergeFunc merge;
+	void *context;
+	// the number of chunks, and the current width of the merged runs (in chunks)
+	uint32_t chunks, width;
+	// where the runs are taken from and where they're merged to
+	char *source, *destination;
+} ParallelSort;
+
+// Returns the index of the first element of a given chunk.
+static size_t chunk_start(ParallelSort *this, uint32_t chunk) {
+	// count * chunk / chunks, without overflowing
+	size_t quotient = this->count / this->chunks, remainder = this->count % this->chunks;
+	return quotient * chunk + remainder * chunk / this->chunks;
+}
+
+static void sort_chunk_task(void *data, uint32_t chunk) {
+	ParallelSort *this = data;
+	size_t start = chunk_start(this, chunk), end = chunk_start(this, chunk + 1);
+	this->sort(this->source + start * this->element_size, end - start, this->context);
+}
+
+static void merge_runs_task(void *data, uint32_t merge) {
+	ParallelSort *this = data;
+	uint32_t first = merge * 2 * this->width;
+	size_t start = chunk_start(this, first);
+	size_t middle = chunk_start(this, first + this->width);
+	size_t end = chunk_start(this, first + 2 * this->width);
+	size_t size = this->element_size;
+	this->merge(this->destination + start * size,
+			this->source + start * size, middle - start,
+			this->source + middle * size, end - middle, this->context);
+}
+
+// Sorts an array with a parallel merge sort - each thread sorts one chunk
+// using 'sort', then the chunks are merged pairwise. Short arrays are just
+// sorted on the calling thread.
+void parallel_sort(void *elements, size_t count, size_t element_size, SortFunc sort, MergeFunc merge, void *context) {
+	uint32_t threads = parallel_thread_count();
+	if ((threads == 1) || (count < PARALLEL_SORT_THRESHOLD)) {
+		sort(elements, count, context);
+		return;
+	}
+
+	// one chunk per thread, rounded up to a power of two
+	uint32_t chunks = 1;
+	while (chunks < threads)
+		chunks *= 2;
+
+	char *buffer = mem_unmanaged_allocate(count * element_size);
+	ParallelSort this = {count, element_size, sort, merge, context, chunks, 1, elements, buffer};
+
+	// sort the chunks
+	parallel_for(chunks, &sort_chunk_task, &this);
+
+	// merge them, halving the number of runs each time
+	for (this.width = 1; this.width < chunks; this.width *= 2) {
+		parallel_for(chunks / (2 * this.width), &merge_runs_task, &this);
+		char *swapped = this.source;
+		this.source = this.destination;
+		this.destination = swapped;
+	}
+
+	// the result might have ended up in the buffer
+	if (this.source != (char*)elements)
+		memcpy(elements, this.source, count * element_size);
+	mem_unmanaged_free(buffer);
+}
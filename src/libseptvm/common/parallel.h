@@ -0,0 +1,60 @@
+#ifndef _SEP_PARALLEL_H
+#define _SEP_PARALLEL_H
+
+/*****************************************************************
+ **
+ ** parallel.h
+ **
+ ** A small pool of worker threads for running data-parallel
+ ** native code - bulk operations on large arrays and the like.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ===============================================================
+//  Parallel loops
+// ===============================================================
+
+/**
+ * The tasks run on the worker threads are plain C and must not touch
+ * the VM in any way - no allocation, no calls into September code and
+ * no GC. The heap and the GC are shared by the whole process, and the
+ * VM itself can only run on its own thread. The thread calling
+ * parallel_for() takes part in the work and waits until all of it is
+ * done, so tasks can safely read managed memory it keeps alive. Tasks
+ * can't start parallel loops of their own.
+ */
+typedef void (*ParallelTask)(void *data, uint32_t part);
+
+// Runs 'task' for each part in 0..parts-1, spreading them over the worker threads.
+void parallel_for(uint32_t parts, ParallelTask task, void *data);
+// Returns the number of threads parallel loops use, including the calling thread.
+uint32_t parallel_thread_count();
+// Sets the number of threads parallel loops use. Defaults to the number of CPUs.
+void parallel_set_thread_count(uint32_t threads);
+
+// ===============================================================
+//  Parallel sorting
+// ===============================================================
+
+// Sorts 'count' elements in place (with a sequential sort, e.g. from sorting.h).
+typedef void (*SortFunc)(void *elements, size_t count, void *context);
+// Merges two sorted runs into 'out'.
+typedef void (*MergeFunc)(void *out, const void *a, size_t a_count, const void *b, size_t b_count, void *context);
+
+// Sorts an array with a parallel merge sort - each thread sorts one chunk
+// using 'sort', then the chunks are merged pairwise. Short arrays are just
+// sorted on the calling thread.
+void parallel_sort(void *elements, size_t count, size_t element_size, SortFunc sort, MergeFunc merge, void *context);
+
+/*****************************************************************/
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef _SEP_SORTING_H
+#define _SEP_SORTING_H
+
+/*****************************************************************
+ **
+ ** sorting.h
+ **
+ ** Type-specialized sorting and merging routines, instantiated
+ ** with macros for each element type that needs them.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// ===============================================================
+//  Introsort
+// ===============================================================
+
+#define SORT_SWAP(type, x, y) do { type _swapped = (x); (x) = (y); (y) = _swapped; } while(0)
+
+/**
+ * Introsort - quicksort with a median-of-three pivot, which switches to
+ * heapsort once the recursion gets too deep and finishes short ranges
+ * with insertion sort. The instance defines a function:
+ *
+ *   void name(type *a, size_t n, context_type *context)
+ *
+ * with 'less(context, a, b)' defining the order. All the index checks
+ * are explicit, so an inconsistent comparison can mess up the order, but
+ * never make the sort go out of bounds. Comparisons that can fail should
+ * return false from then on and make 'stopped(context)' true, which gets
+ * the sort to finish quickly.
+ */
+#define DEFINE_INTROSORT(name, type, less, context_type, stopped) \
+	static void name##_insertion(type *a, size_t n, context_type *context) { \
+		size_t i, j; \
+		for (i = 1; i < n; i++) { \
+			type value = a[i]; \
+			for (j = i; (j > 0) && less(context, value, a[j-1]); j--) \
+				a[j] = a[j-1]; \
+			a[j] = value; \
+		} \
+	} \
+	static void name##_sift_down(type *a, size_t root, size_t n, context_type *context) { \
+		while (2 * root + 1 < n) { \
+			size_t child = 2 * root + 1; \
+			if ((child + 1 < n) && less(context, a[child], a[child+1])) \
+				child++; \
+			if (!less(context, a[root], a[child])) \
+				return; \
+			SORT_SWAP(type, a[root], a[child]); \
+			root = child; \
+		} \
+	} \
+	static void name##_heapsort(type *a, size_t n, context_type *context) { \
+		size_t i; \
+		for (i = n / 2; i-- > 0;) \
+			name##_sift_down(a, i, n, context); \
+		for (i = n; i-- > 1;) { \
+			SORT_SWAP(type, a[0], a[i]); \
+			name##_sift_down(a, 0, i, context); \
+		} \
+	} \
+	static void name##_introsort(type *a, size_t n, int depth, context_type *context) { \
+		while ((n > 16) && !stopped(context)) { \
+			if (depth-- == 0) { \
+				name##_heapsort(a, n, context); \
+				return; \
+			} \
+			size_t middle = (n - 1) / 2; \
+			if (less(context, a[middle], a[0])) SORT_SWAP(type, a[middle], a[0]); \
+			if (less(context, a[n-1], a[0])) SORT_SWAP(type, a[n-1], a[0]); \
+			if (less(context, a[n-1], a[middle])) SORT_SWAP(type, a[n-1], a[middle]); \
+			type pivot = a[middle]; \
+			size_t i = 0, j = n - 1; \
+			while (true) { \
+				while ((i < n - 1) && less(context, a[i], pivot)) i++; \
+				while ((j > 0) && less(context, pivot, a[j])) j--; \
+				if (i >= j) break; \
+				SORT_SWAP(type, a[i], a[j]); \
+				i++; j--; \
+			} \
+			size_t split = (j < n - 1) ? j + 1 : n - 1; \
+			if (split < n - split) { \
+				name##_introsort(a, split, depth, context); \
+				a += split; n -= split; \
+			} else { \
+				name##_introsort(a + split, n - split, depth, context); \
+				n = split; \
+			} \
+		} \
+		name##_insertion(a, n, context); \
+	} \
+	static void name(type *a, size_t n, context_type *context) { \
+		int depth = 0; \
+		size_t size; \
+		for (size = n; size > 1; size >>= 1) \
+			depth += 2; \
+		name##_introsort(a, n, depth, context); \
+	}
+
+// ===============================================================
+//  Merging
+// ===============================================================
+
+/**
+ * Merges two sorted runs into 'out', keeping equal elements in order.
+ * The instance defines a function:
+ *
+ *   void name(type *out, const type *a, size_t na, const type *b, size_t nb, context_type *context)
+ */
+#define DEFINE_MERGE(name, type, less, context_type) \
+	static void name(type *out, const type *a, size_t na, const type *b, size_t nb, context_type *context) { \
+		size_t i = 0, j = 0; \
+		while ((i < na) && (j < nb)) \
+			*out++ = less(context, b[j], a[i]) ? b[j++] : a[i++]; \
+		while (i < na) *out++ = a[i++]; \
+		while (j < nb) *out++ = b[j++]; \
+	}
+
+/*****************************************************************/
+
+#endif
@@ -17,7 +17,9 @@
 #include <stdint.h>
 
 #include "../common/debugging.h"
+#include "../common/garray.h"
 
+#include "../vm/mem.h"
 #include "../vm/opcodes.h"
 #include "../vm/functions.h"
 #include "../vm/support.h"
@@ -36,6 +38,12 @@ enum OpcodeFlags {
 	MFILE_FLAG_POP = 0x08
 };
 
+// Flow control operations share one opcode in module files, followed by a byte
+// saying which one it is (those values match the opcode enum 1:1).
+enum FileOpcodes {
+	MFILE_OP_FLOW = 0x2
+};
+
 enum ParamFlags {
 	MFILE_P_LAZY_EVALUATED = 0x01,
 	MFILE_P_SINK = 0x10,
@@ -50,7 +58,8 @@ enum ParamFlags {
 // One byte type-tags used for constants in SEPT files.
 enum ConstantType {
 	CT_INT = 1,
-	CT_STRING = 2
+	CT_STRING = 2,
+	CT_FLOAT = 3
 };
 
 // ===============================================================
@@ -89,6 +98,19 @@ int32_t decoder_read_int(BytecodeDecoder *this, SepV *error) {
 	return negative ? -magnitude : magnitude;
 }
 
+// Reads a float, stored as an IEEE double in big-endian byte order.
+SepFloat decoder_read_float(BytecodeDecoder *this, SepV *error) {
+	SepV err = SEPV_NOTHING;
+
+	_SepFloatBits value = {0.0};
+	int index;
+	for (index = 0; index < 8; index++) {
+		uint8_t next_byte = decoder_read_byte(this, &err) or_fail_with(0.0);
+		value.bits = (value.bits << 8) | next_byte;
+	}
+	return value.number;
+}
+
 char *decoder_read_string(BytecodeDecoder *this, SepV *error) {
 	SepV err = SEPV_NOTHING;
 	int32_t length = decoder_read_int(this, &err)
@@ -159,6 +181,16 @@ ConstantPool *decoder_read_cpool(BytecodeDecoder *this, SepV *error) {
 				break;
 			}
 
+			case CT_FLOAT:
+			{
+				SepFloat number = decoder_read_float(this, &err);
+					or_fail_with(pool);
+				if (!float_fits_sepv(number))
+					fail(pool, exception(exc.EMalformedModule, "Float constant %g is out of the supported range.", number));
+				cpool_add_float(pool, number);
+				break;
+			}
+
 			case CT_STRING:
 			{
 				char *string = decoder_read_string(this, &err);
@@ -218,14 +250,123 @@ void decoder_read_block_params(BytecodeDecoder *this, BlockPool *pool, int param
 	}
 }
 
+/**
+ * Jumps are stored in module files as the index of the instruction they go to.
+ * Instructions expand into a different number of code units each, so those
+ * indices are turned into offsets once the whole function has been read.
+ */
+typedef struct JumpFixup {
+	// the position of the offset in the code
+	uint32_t position;
+	// the index of the instruction it should point to
+	int32_t target;
+} JumpFixup;
+
+void decoder_read_jump(BytecodeDecoder *this, BlockPool *pool, GenericArray *jumps, SepV *error) {
+	SepV err = SEPV_NOTHING;
+	JumpFixup jump;
+	jump.target = decoder_read_int(this, &err);
+		or_fail();
+	jump.position = bpool_code_position(pool);
+	ga_push(jumps, &jump);
+
+	// placeholder until the offset is known
+	bpool_write_code(pool, 0);
+}
+
+void decoder_read_flow_operation(BytecodeDecoder *this, BlockPool *pool, GenericArray *jumps, SepV *error) {
+	SepV err = SEPV_NOTHING;
+
+	uint8_t operation = decoder_read_byte(this, &err);
+		or_fail();
+	if ((operation < OP_JUMP) || (operation > OP_INDEX))
+		fail(exception(exc.EMalformedModule, "Unrecognized flow control operation: %d.", operation));
+	bpool_write_code(pool, operation);
+
+	// the name of the syntax built-in guarded, of the loop variable, or of
+	// the indexing method
+	if ((operation == OP_GUARD_SYNTAX) || (operation == OP_FOR_START) || (operation == OP_INDEX)) {
+		bpool_write_code(pool, (int16_t)decoder_read_int(this, &err));
+			or_fail();
+	}
+
+	// the place to jump to
+	switch (operation) {
+		case OP_PUSH_NOTHING: case OP_LOOP_NEXT: case OP_LOOP_END:
+		case OP_TRY_END: case OP_RETHROW: case OP_INDEX:
+			break;
+		default:
+			decoder_read_jump(this, pool, jumps, &err);
+				or_fail();
+	}
+}
+
+void decoder_resolve_jumps(GenericArray *instructions, GenericArray *jumps, BlockPool *pool, SepV *error) {
+	GenericArrayIterator it = ga_iterate_over(jumps);
+	while (!gait_end(&it)) {
+		JumpFixup *jump = (JumpFixup*)gait_current(&it);
+		if ((jump->target < 0) || (jump->target >= ga_length(instructions)))
+			fail(exception(exc.EMalformedModule, "Jump target %d is out of bounds.", jump->target));
+
+		// offsets are relative to their own position
+		int32_t target = *((uint32_t*)ga_get(instructions, jump->target));
+		int32_t offset = target - (int32_t)jump->position;
+		if ((offset < INT16_MIN) || (offset > INT16_MAX))
+			fail(exception(exc.EMalformedModule, "Jump to instruction %d is too long.", jump->target));
+		bpool_patch_code(pool, jump->position, (CodeUnit)offset);
+
+		gait_advance(&it);
+	}
+}
+
+// Reads the line table following the code of a block, translating the
+// instruction indices used in the file into offsets into the code.
+void decoder_read_block_lines(BytecodeDecoder *this, GenericArray *instructions, BlockPool *pool, SepV *error) {
+	SepV err = SEPV_NOTHING;
+	int32_t count = decoder_read_int(this, &err);
+		or_fail();
+	if ((count < 0) || (count > ga_length(instructions)))
+		fail(exception(exc.EMalformedModule, "Line table with %d entries is malformed.", count));
+	if (!count)
+		return;
+
+	LineTable *table = mem_unmanaged_allocate(sizeof(LineTable) + count * sizeof(LineEntry));
+	table->count = count;
+	int32_t entry;
+	for (entry = 0; entry < count; entry++) {
+		int32_t index = decoder_read_int(this, &err);
+			or_go(clean_up);
+		int32_t line = decoder_read_int(this, &err);
+			or_go(clean_up);
+		if ((index < 0) || (index >= ga_length(instructions)))
+			fail(exception(exc.EMalformedModule, "Line table entry for instruction %d is out of bounds.", index));
+		table->entries[entry].offset = *((uint32_t*)ga_get(instructions, index));
+		table->entries[entry].line = line;
+	}
+	bpool_attach_lines(pool, table);
+	return;
+
+clean_up:
+	mem_unmanaged_free(table);
+	fail(err);
+}
+
 void decoder_read_block_code(BytecodeDecoder *this, BlockPool *pool, SepV *error) {
 	SepV err = SEPV_NOTHING;
+
+	// where each instruction starts, and the jumps that need their offsets
+	GenericArray instructions, jumps;
+	ga_init(&instructions, 16, sizeof(uint32_t), &allocator_unmanaged);
+	ga_init(&jumps, 4, sizeof(JumpFixup), &allocator_unmanaged);
 	
 	uint8_t opcode = decoder_read_byte(this, &err);
-		or_fail();
+		or_go(clean_up);
 	
 	// read operations until end of block  
 	while (opcode != 0xFF) {
+		uint32_t position = bpool_code_position(pool);
+		ga_push(&instructions, &position);
+
 		// handle pre-operation flags
 		if (opcode & MFILE_FLAG_LOCALS)
 			bpool_write_code(pool, OP_PUSH_LOCALS);
@@ -243,7 +384,7 @@ void decoder_read_block_code(BytecodeDecoder *this, BlockPool *pool, SepV *error
 		// operation (module file values match opcode enum, so this is 1:1)
 		// nops are skipped altogether
 		uint8_t raw_op = opcode & 0x7;
-		if (raw_op)
+		if (raw_op && (raw_op != MFILE_OP_FLOW))
 			bpool_write_code(pool, raw_op);
 		
 		// read arguments depending on opcode
@@ -252,20 +393,23 @@ void decoder_read_block_code(BytecodeDecoder *this, BlockPool *pool, SepV *error
 			case OP_PUSH_CONST:
 				// constant
 				bpool_write_code(pool, (int16_t)decoder_read_int(this, &err));
-					or_fail();
+					or_go(clean_up);
 				break;
 			case OP_LAZY_CALL:
 				// count arguments
 				op_arg_count = decoder_read_byte(this, &err);
-					or_fail();
+					or_go(clean_up);
 				bpool_write_code(pool, op_arg_count);
 				// read them all
 				for (arg_index = 0; arg_index < op_arg_count; arg_index++) {
 					bpool_write_code(pool, (int16_t)decoder_read_int(this, &err));
-						or_fail();
+						or_go(clean_up);
 				}
 				break;
-				
+			case MFILE_OP_FLOW:
+				decoder_read_flow_operation(this, pool, &jumps, &err);
+					or_go(clean_up);
+				break;
 		}
 		
 		// handle post-operation flags
@@ -277,11 +421,23 @@ void decoder_read_block_code(BytecodeDecoder *this, BlockPool *pool, SepV *error
 		
 		// next!
 		opcode = decoder_read_byte(this, &err);
-			or_fail();
+			or_go(clean_up);
 	}
+
+	// the end of the function can be jumped to as well
+	uint32_t end = bpool_code_position(pool);
+	ga_push(&instructions, &end);
+	decoder_resolve_jumps(&instructions, &jumps, pool, &err);
+		or_go(clean_up);
+	decoder_read_block_lines(this, &instructions, pool, &err);
+		or_go(clean_up);
 	
 	// close the code block
 	bpool_end_block(pool);
+
+clean_up:
+	ga_free_entries(&instructions);
+	ga_free_entries(&jumps);
 }
 
 BlockPool *decoder_read_bpool(BytecodeDecoder *this, SepModule *module, SepV *error) {
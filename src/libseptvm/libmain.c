@@ -16,6 +16,7 @@
 #include "vm/vm.h"
 #include "vm/gc.h"
 #include "vm/runtime.h"
+#include "vm/strings.h"
 #include "libmain.h"
 
 // ===============================================================
@@ -29,6 +30,13 @@ LibSeptVMGlobals lsvm_globals = {NULL, NULL, NULL, NULL, NULL};
 // only run one VM at a time, and each thread has its own VM.
 __thread SepVM *_currently_running_vm = NULL;
 
+// The property cache version pointed to from lsvm_globals.
+uint64_t _property_cache_version = 1;
+// The lookup cache pointed to from lsvm_globals.
+LookupCache _lookup_cache;
+// The backtrace capture switch pointed to from lsvm_globals.
+bool _capture_backtraces = true;
+
 // ===============================================================
 //  Internals
 // ===============================================================
@@ -64,12 +72,18 @@ void libseptvm_initialize() {
 	lsvm_globals.gc_contexts = ga_create(0, sizeof(GCContext*), &allocator_unmanaged);
 	lsvm_globals.debugged_module_names = mem_unmanaged_allocate(4096);
 	lsvm_globals.debugged_module_names[0] = '\0';
-	lsvm_globals.property_cache_version = 0;
+	lsvm_globals.property_cache_version = &_property_cache_version;
+	lsvm_globals.lookup_cache = &_lookup_cache;
+	lsvm_globals.capture_backtraces = &_capture_backtraces;
 	lsvm_globals.runtime_objects = &rt;
 	lsvm_globals.builtin_exceptions = &exc;
 
 	gc_start_context();
 	lsvm_globals.module_cache = obj_create_with_proto(SEPV_NOTHING);
 	lsvm_globals.string_cache = obj_create_with_proto(SEPV_NOTHING);
+	sepstr_initialize_char_table();
+	lsvm_globals.class_property = sepstr_for("<class>");
+	lsvm_globals.superclass_property = sepstr_for("<superclass>");
+	lsvm_globals.ancestors_property = sepstr_for("<ancestors>");
 	gc_end_context();
 }
@@ -17,13 +17,16 @@
 // ===============================================================
 
 #include <stdint.h>
+#include <stdbool.h>
 
 struct ManagedMemory;
 struct SepObj;
+struct SepString;
 struct SepVM;
 struct GenericArray;
 struct RuntimeObjects;
 struct BuiltinExceptions;
+struct LookupCache;
 
 // ===============================================================
 //  Globals used by LibSeptVM
@@ -36,6 +39,11 @@ typedef struct LibSeptVMGlobals {
 	struct SepObj *module_cache;
 	// the interned string cache
 	struct SepObj *string_cache;
+	// interned one-character strings, indexed by the character
+	struct SepString **character_strings;
+	// interned names of the properties classes are described by, looked
+	// up by every class check
+	struct SepString *class_property, *superclass_property, *ancestors_property;
 	// garbage collection contexts
 	struct GenericArray *gc_contexts;
 	// quick object reference caches
@@ -45,8 +53,14 @@ typedef struct LibSeptVMGlobals {
 	struct SepVM *(*get_vm_for_current_thread)();
 	struct SepVM *(*set_vm_for_current_thread)(struct SepVM *);
 
-	// global used for property resolution cache invalidation
-	uint64_t property_cache_version;
+	// global used for property resolution cache invalidation - bumped
+	// every time a prototype list that might be cached somewhere changes
+	// (it's a pointer, so that slave libraries share it with the master)
+	uint64_t *property_cache_version;
+	// the global property lookup cache (see objects.h), shared the same way
+	struct LookupCache *lookup_cache;
+	// should exceptions capture backtraces when they're created?
+	bool *capture_backtraces;
 
 	// names of the library modules for which debug logging is turned on
 	char *debugged_module_names;
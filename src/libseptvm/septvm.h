@@ -18,12 +18,16 @@
 
 #include "common/debugging.h"
 #include "common/garray.h"
+#include "common/parallel.h"
 #include "io/loader.h"
 #include "vm/runtime.h"
 #include "vm/support.h"
 #include "vm/arrays.h"
+#include "vm/bigints.h"
 #include "vm/exceptions.h"
 #include "vm/functions.h"
+#include "vm/iterators.h"
+#include "vm/maps.h"
 #include "vm/mem.h"
 #include "vm/gc.h"
 #include "vm/module.h"
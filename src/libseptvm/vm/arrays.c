@@ -25,6 +25,84 @@
 #include "../vm/runtime.h"
 #include "../vm/support.h"
 
+// ===============================================================
+//  Element representation
+// ===============================================================
+
+// Picks the most specific array kind able to hold a value.
+static ArrayKind array_kind_for(SepV value) {
+	if (sepv_is_int(value))
+		return ARRAY_PACKED_INT;
+	if (sepv_is_float(value))
+		return ARRAY_PACKED_FLOAT;
+	return ARRAY_GENERIC;
+}
+
+// Encodes a value the way an array of a given kind stores it. Returns false
+// if the value can't be stored in an array of this kind.
+static inline bool array_try_encode(ArrayKind kind, SepV value, uint64_t *cell) {
+	switch(kind) {
+		case ARRAY_PACKED_INT:
+			if (!sepv_is_int(value))
+				return false;
+			*cell = (uint64_t)sepv_to_int(value);
+			return true;
+		case ARRAY_PACKED_FLOAT: {
+			if (!sepv_is_float(value))
+				return false;
+			_SepFloatBits f = {sepv_to_float(value)};
+			*cell = f.bits;
+			return true;
+		}
+		default:
+			*cell = value;
+			return true;
+	}
+}
+
+// Decodes a single cell of an array of a given kind.
+static inline SepV array_decode(ArrayKind kind, uint64_t cell) {
+	switch(kind) {
+		case ARRAY_PACKED_INT:
+			return int_to_sepv((int64_t)cell);
+		case ARRAY_PACKED_FLOAT: {
+			_SepFloatBits f;
+			f.bits = cell;
+			return float_to_sepv(f.number);
+		}
+		default:
+			return cell;
+	}
+}
+
+// Encodes a value for storage in this array, changing the kind of the
+// array first if the value doesn't fit.
+static uint64_t array_encode(SepArray *this, SepV value) {
+	uint64_t cell;
+	if (array_try_encode(this->kind, value, &cell))
+		return cell;
+
+	// an empty array can simply start over with the right kind,
+	// a non-empty one has to go generic
+	if (array_length(this) == 0)
+		this->kind = array_kind_for(value);
+	else
+		array_generalize(this);
+	array_try_encode(this->kind, value, &cell);
+	return cell;
+}
+
+// Switches the array to the generic representation, converting all elements to SepVs.
+void array_generalize(SepArray *this) {
+	if (this->kind == ARRAY_GENERIC)
+		return;
+
+	uint64_t *cell = this->array.start, *end = this->array.end;
+	for (; cell < end; cell++)
+		*cell = array_decode(this->kind, *cell);
+	this->kind = ARRAY_GENERIC;
+}
+
 // ===============================================================
 //  Array implementation - public
 // ===============================================================
@@ -43,15 +121,19 @@ SepArray *array_create(uint32_t initial_size) {
 	// make sure all unallocated pointers are NULL to make sure GC
 	// does not trip over some uninitialized pointers
 	array->array.start = NULL;
-	array->base.props.entries = NULL;
 	array->base.data = NULL;
+	array->base.c3_order = NULL;
+	array->base.c3_version = 0;
 
-	// register as GC root to avoid collection
-	gc_register(obj_to_sepv(array));
+	// no elements yet, so the first one stored decides the kind
+	array->kind = ARRAY_PACKED_INT;
 
 	// initialize property map (arrays don't usually hold
-	// properties, so make it as small as possible)
-	props_init((PropertyMap*)array, 1);
+	// properties, so don't allocate anything until they do)
+	props_init_inline((PropertyMap*)array, NULL, 0);
+
+	// register as GC root to avoid collection
+	gc_register(obj_to_sepv(array));
 
 	// allocate the underlying dynamic array
 	ga_init(&array->array, initial_size, sizeof(SepV), &allocator_managed);
@@ -62,15 +144,29 @@ SepArray *array_create(uint32_t initial_size) {
 
 // Pushes a new value at the end of this array.
 void array_push(SepArray *this, SepV value) {
-	ga_push(&this->array, &value);
+	uint64_t cell = array_encode(this, value);
+	ga_push(&this->array, &cell);
 }
 
 // Pushes all values from another array at the end of this array.
 void array_push_all(SepArray *this, SepArray *other) {
 	uint32_t initial_length = array_length(this), i;
 	uint32_t other_length = array_length(other);
-	array_grow(this, other_length);
+	if (other_length == 0)
+		return;
+
+	// an empty array takes over the representation of the other one
+	if (initial_length == 0)
+		this->kind = other->kind;
+
+	// same representation - the cells can be copied over directly
+	if (this->kind == other->kind) {
+		array_grow(this, other_length);
+		memcpy(ga_get(&this->array, initial_length), other->array.start, other_length * sizeof(uint64_t));
+		return;
+	}
 
+	array_grow(this, other_length);
 	SepArrayIterator iterator = array_iterate_over(other);
 	for (i = initial_length; i < initial_length + other_length; i++) {
 		SepV value = arrayit_next(&iterator);
@@ -81,59 +177,70 @@ void array_push_all(SepArray *this, SepArray *other) {
 // Pops a value from the end of this array.
 SepV array_pop(SepArray *this) {
 	// pop
-	SepV *value_ptr = ga_pop(&this->array);
+	uint64_t *cell_ptr = ga_pop(&this->array);
 
 	// underflow exception?
-	if (value_ptr == NULL) {
+	if (cell_ptr == NULL) {
 		return sepv_exception(exc.EWrongIndex,
 			sepstr_for("Attempted to pop a value from an empty array."));
 	}
 
 	// return
-	return *value_ptr;
+	return array_decode(this->kind, *cell_ptr);
 }
 
 // Gets a value at a given index.
 SepV array_get(SepArray *this, uint32_t index) {
-	SepV *pointer = ga_get(&this->array, index);
+	uint64_t *pointer = ga_get(&this->array, index);
 	if (!pointer) {
 		// out of bounds!
-		return sepv_exception(exc.EWrongIndex,
-				sepstr_sprintf("Out of bounds access to array, index = %d", index));
+		return sepv_exceptionf(exc.EWrongIndex,
+				"Out of bounds access to array, index = %d", index);
 	}
 
 	// return value
-	return *pointer;
+	return array_decode(this->kind, *pointer);
 }
 
 // Sets a value at a given index.
 SepV array_set(SepArray *this, uint32_t index, SepV value) {
-	SepV *pointer = ga_set(&this->array, index, &value);
-	if (!pointer) {
+	if (index >= array_length(this)) {
 		// out of bounds!
-		return sepv_exception(exc.EWrongIndex,
-				sepstr_sprintf("Out of bounds access to array, index = %d", index));
+		return sepv_exceptionf(exc.EWrongIndex,
+				"Out of bounds access to array, index = %d", index);
 	}
 
-	// return the value
-	return *pointer;
+	// store and return the value
+	uint64_t cell = array_encode(this, value);
+	ga_set(&this->array, index, &cell);
+	return value;
 }
 
 // Grows the array by a given number of cells.
 void array_grow(SepArray *this, uint32_t cells) {
-	// delegate
+	uint32_t length = array_length(this);
 	ga_grow(&this->array, cells);
+
+	// zero the new cells, so that they're valid in every representation
+	if (cells)
+		memset(ga_get(&this->array, length), 0, cells * sizeof(uint64_t));
 }
 
 // Finds an object in the array (object identity used for equality) and returns its index, or -1 if the object is not found.
 int32_t array_index_of(SepArray *this, SepV value) {
-	return ga_index_of(&this->array, &value);
+	uint64_t cell;
+	if (!array_try_encode(this->kind, value, &cell))
+		return -1;
+	return ga_index_of(&this->array, &cell);
 }
 
 // Removes the first occurence of an object from the array (memcmp is used for comparisons) if it is present.
 // Returns true if the object was present, false otherwise.
 bool array_remove(SepArray *this, SepV value) {
-	return ga_remove(&this->array, &value);
+	uint64_t cell;
+	if (!array_try_encode(this->kind, value, &cell))
+		return false;
+	return ga_remove(&this->array, &cell);
 }
 
 // Removes a single element from the given index.
@@ -159,19 +266,18 @@ uint32_t array_length(SepArray *this) {
 
 // Starts a new iteration over an array.
 SepArrayIterator array_iterate_over(SepArray *this) {
-	return ga_iterate_over(&this->array);
+	SepArrayIterator iterator = {this, ga_iterate_over(&this->array)};
+	return iterator;
 }
 
 // Returns the current element under the iterator and advances the iterator itself.
 SepV arrayit_next(SepArrayIterator *this) {
-	SepV value = *((SepV*)gait_current(this));
-	gait_advance(this);
-	return value;
+	uint64_t cell = *((uint64_t*)gait_current(&this->position));
+	gait_advance(&this->position);
+	return array_decode(this->array->kind, cell);
 }
 
 // Returns true if we have iterated over all the elements.
 bool arrayit_end(SepArrayIterator *this) {
-	return gait_end(this);
+	return gait_end(&this->position);
 }
-
-
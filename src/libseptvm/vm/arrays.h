@@ -25,6 +25,24 @@
 //  Arrays
 // ===============================================================
 
+/**
+ * Arrays that hold only integers or only floats store them packed, as
+ * plain int64_t/double values instead of SepVs. This lets the numeric
+ * kernels work on them directly, and lets the GC skip the elements.
+ * Every kind uses 8-byte cells, so switching to the generic kind is
+ * done in place. That happens automatically whenever a value that
+ * doesn't fit the current kind is stored, so the representation is
+ * never visible from September code.
+ */
+typedef enum ArrayKind {
+	// elements are stored as SepVs
+	ARRAY_GENERIC = 0,
+	// elements are small integers, stored as int64_t
+	ARRAY_PACKED_INT = 1,
+	// elements are floats, stored as doubles
+	ARRAY_PACKED_FLOAT = 2
+} ArrayKind;
+
 /**
  * September arrays are an extension of September objects, so they
  * start with a SepObj struct and all obj_* methods can apply also
@@ -36,8 +54,15 @@ typedef struct SepArray {
 	SepObj base;
 	// the actual backing array
 	GenericArray array;
+	// how the elements are represented - empty arrays start out as
+	// packed integers, and the first value stored picks the right kind
+	ArrayKind kind;
 } SepArray;
 
+// Direct access to the storage of packed arrays.
+#define array_ints(arr) ((int64_t*)((arr)->array.start))
+#define array_floats(arr) ((double*)((arr)->array.start))
+
 // Creates a new, empty array.
 SepArray *array_create(uint32_t initial_size);
 // Pushes a new value at the end of this array.
@@ -63,13 +88,21 @@ void array_remove_at(SepArray *this, uint32_t index);
 SepArray *array_copy(SepArray *this);
 // Pushes all values from another array at the end of this array.
 void array_push_all(SepArray *this, SepArray *other);
+// Switches the array to the generic representation, converting all elements to SepVs.
+void array_generalize(SepArray *this);
 
 // ===============================================================
 //  Iteration
 // ===============================================================
 
-// Iterator for a SepArray is just a generic iterator, nothing special.
-typedef GenericArrayIterator SepArrayIterator;
+// Iterator for a SepArray - a generic iterator, plus the array itself
+// to know how to interpret the elements.
+typedef struct SepArrayIterator {
+	// the array we're iterating over
+	SepArray *array;
+	// the current position
+	GenericArrayIterator position;
+} SepArrayIterator;
 
 // Starts a new iteration over an array.
 SepArrayIterator array_iterate_over(SepArray *this);
@@ -0,0 +1,575 @@
+/*****************************************************************
+ **
+ ** vm/bigints.c
+ **
+ ** Implementation for arbitrary precision integers.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "mem.h"
+#include "gc.h"
+#include "bigints.h"
+
+#include "../vm/runtime.h"
+
+// ===============================================================
+//  Constants
+// ===============================================================
+
+// operands at least this long (in digits) are multiplied using Karatsuba
+#define KARATSUBA_THRESHOLD 32
+
+// the largest power of 10 fitting in a digit, used for decimal conversion
+#define DECIMAL_CHUNK 1000000000u
+#define DECIMAL_CHUNK_DIGITS 9
+
+#define DIGIT_BITS 32
+#define DIGIT_BASE (1ull << DIGIT_BITS)
+
+// ===============================================================
+//  Views of integers
+// ===============================================================
+
+/**
+ * A uniform view of any integer, small or big. For small integers, the
+ * digits are stored in the view itself, so it should always be passed
+ * around by pointer.
+ */
+typedef struct BigView {
+	bool negative;
+	uint32_t length;
+	const BigDigit *digits;
+	BigDigit storage[2];
+} BigView;
+
+// Sets up a view of an integer SepV.
+static void _big_view(SepV value, BigView *view) {
+	if (sepv_is_int(value)) {
+		SepInt integer = sepv_to_int(value);
+		uint64_t magnitude = (integer < 0) ? -(uint64_t)integer : (uint64_t)integer;
+		view->negative = integer < 0;
+		view->storage[0] = (BigDigit)magnitude;
+		view->storage[1] = (BigDigit)(magnitude >> DIGIT_BITS);
+		view->length = view->storage[1] ? 2 : (view->storage[0] ? 1 : 0);
+		view->digits = view->storage;
+	} else {
+		SepBigInt *big = sepv_to_bigint(value);
+		view->negative = big->negative;
+		view->length = big->length;
+		view->digits = big->digits;
+	}
+}
+
+// Temporary digit buffers - these are never seen by the GC, so they
+// come from unmanaged memory.
+static BigDigit *_digits_allocate(uint32_t length) {
+	return mem_unmanaged_allocate((length ? length : 1) * sizeof(BigDigit));
+}
+
+static BigDigit *_digits_zeroed(uint32_t length) {
+	BigDigit *digits = _digits_allocate(length);
+	memset(digits, 0, (length ? length : 1) * sizeof(BigDigit));
+	return digits;
+}
+
+// Returns the length of a digit string after stripping leading zeroes.
+static uint32_t _digits_normalize(const BigDigit *digits, uint32_t length) {
+	while (length && !digits[length-1])
+		length--;
+	return length;
+}
+
+// ===============================================================
+//  Creating results
+// ===============================================================
+
+// Allocates a new big integer with room for 'length' digits.
+static SepBigInt *_bigint_create(uint32_t length) {
+	static ObjectTraits BIGINT_TRAITS = {REPRESENTATION_BIGINT};
+
+	SepBigInt *big = mem_allocate(sizeof(SepBigInt) + length * sizeof(BigDigit));
+
+	// prototypes and traits
+	big->base.prototypes = obj_to_sepv(rt.Integer);
+	big->base.traits = BIGINT_TRAITS;
+	big->negative = false;
+	big->length = length;
+
+	// make sure all unallocated pointers are NULL to make sure GC
+	// does not trip over some uninitialized pointers
+	big->base.data = NULL;
+	big->base.c3_order = NULL;
+	big->base.c3_version = 0;
+
+	// initialize property map (integers don't hold properties,
+	// so don't allocate anything unless they do)
+	props_init_inline((PropertyMap*)big, NULL, 0);
+
+	// register as GC root to avoid collection
+	gc_register(obj_to_sepv(big));
+
+	return big;
+}
+
+// Turns a sign and magnitude into a SepV in canonical form - the digits are
+// copied and the buffer is not taken over.
+static SepV _bigint_result(bool negative, const BigDigit *digits, uint32_t length) {
+	length = _digits_normalize(digits, length);
+
+	// demote to a small integer if possible
+	if (length == 0)
+		return int_to_sepv(0);
+	if (length <= 2) {
+		uint64_t magnitude = digits[0];
+		if (length == 2)
+			magnitude |= ((uint64_t)digits[1]) << DIGIT_BITS;
+		if (!negative && (magnitude <= (uint64_t)SEPV_INT_MAX))
+			return int_to_sepv((SepInt)magnitude);
+		if (negative && (magnitude <= -(uint64_t)SEPV_INT_MIN))
+			return int_to_sepv(-(SepInt)magnitude);
+	}
+
+	// a real big integer
+	SepBigInt *big = _bigint_create(length);
+	big->negative = negative;
+	memcpy(big->digits, digits, length * sizeof(BigDigit));
+	return obj_to_sepv(big);
+}
+
+// Same as _bigint_result(), but also frees the digit buffer.
+static SepV _bigint_result_and_free(bool negative, BigDigit *digits, uint32_t length) {
+	SepV result = _bigint_result(negative, digits, length);
+	mem_unmanaged_free(digits);
+	return result;
+}
+
+// ===============================================================
+//  Magnitude arithmetics
+// ===============================================================
+
+// Compares two normalized magnitudes.
+static int _mag_compare(const BigDigit *a, uint32_t a_length, const BigDigit *b, uint32_t b_length) {
+	if (a_length != b_length)
+		return (a_length < b_length) ? -1 : 1;
+	while (a_length--) {
+		if (a[a_length] != b[a_length])
+			return (a[a_length] < b[a_length]) ? -1 : 1;
+	}
+	return 0;
+}
+
+// Adds 'b' into 'a' (in-place), where 'a' has room for all the carries.
+static void _mag_add_into(BigDigit *a, uint32_t a_length, const BigDigit *b, uint32_t b_length) {
+	uint64_t carry = 0;
+	uint32_t index;
+	for (index = 0; index < b_length; index++) {
+		carry += (uint64_t)a[index] + b[index];
+		a[index] = (BigDigit)carry;
+		carry >>= DIGIT_BITS;
+	}
+	for (; carry && (index < a_length); index++) {
+		carry += a[index];
+		a[index] = (BigDigit)carry;
+		carry >>= DIGIT_BITS;
+	}
+}
+
+// Subtracts 'b' from 'a' (in-place), 'a' has to be at least as large as 'b'.
+static void _mag_sub_from(BigDigit *a, uint32_t a_length, const BigDigit *b, uint32_t b_length) {
+	int64_t borrow = 0;
+	uint32_t index;
+	for (index = 0; index < b_length; index++) {
+		borrow += (int64_t)a[index] - b[index];
+		a[index] = (BigDigit)borrow;
+		borrow >>= DIGIT_BITS;
+	}
+	for (; borrow && (index < a_length); index++) {
+		borrow += a[index];
+		a[index] = (BigDigit)borrow;
+		borrow >>= DIGIT_BITS;
+	}
+}
+
+// Schoolbook multiplication, the result goes into 'r', which has to hold
+// a_length + b_length digits.
+static void _mag_mul_simple(BigDigit *r, const BigDigit *a, uint32_t a_length, const BigDigit *b, uint32_t b_length) {
+	memset(r, 0, (a_length + b_length) * sizeof(BigDigit));
+	uint32_t i, j;
+	for (i = 0; i < a_length; i++) {
+		uint64_t carry = 0, digit = a[i];
+		if (!digit)
+			continue;
+		for (j = 0; j < b_length; j++) {
+			carry += digit * b[j] + r[i+j];
+			r[i+j] = (BigDigit)carry;
+			carry >>= DIGIT_BITS;
+		}
+		r[i+b_length] = (BigDigit)carry;
+	}
+}
+
+static void _mag_mul(BigDigit *r, const BigDigit *a, uint32_t a_length, const BigDigit *b, uint32_t b_length);
+
+// Karatsuba multiplication for operands of similar length, a_length >= b_length > a_length / 2.
+// Splitting both numbers in two halves at 'm' digits:
+//   a * b = z2 * B^2m + z1 * B^m + z0
+// where z0 = a0 * b0, z2 = a1 * b1, z1 = (a0 + a1) * (b0 + b1) - z0 - z2,
+// so only three half-size multiplications are needed instead of four.
+static void _mag_mul_karatsuba(BigDigit *r, const BigDigit *a, uint32_t a_length, const BigDigit *b, uint32_t b_length) {
+	uint32_t m = a_length / 2;
+	const BigDigit *a0 = a, *a1 = a + m, *b0 = b, *b1 = b + m;
+	uint32_t a1_length = a_length - m, b1_length = b_length - m;
+
+	// z0 and z2 go directly into their places in the result
+	memset(r, 0, (a_length + b_length) * sizeof(BigDigit));
+	_mag_mul(r, a0, m, b0, m);
+	_mag_mul(r + 2*m, a1, a1_length, b1, b1_length);
+
+	// the sums of the halves
+	uint32_t sa_length = a1_length + 1, sb_length = a1_length + 1;
+	BigDigit *sa = _digits_zeroed(sa_length), *sb = _digits_zeroed(sb_length);
+	memcpy(sa, a1, a1_length * sizeof(BigDigit));
+	_mag_add_into(sa, sa_length, a0, m);
+	memcpy(sb, b1, b1_length * sizeof(BigDigit));
+	_mag_add_into(sb, sb_length, b0, m);
+	sa_length = _digits_normalize(sa, sa_length);
+	sb_length = _digits_normalize(sb, sb_length);
+
+	// z1 = (a0 + a1) * (b0 + b1) - z0 - z2
+	uint32_t z1_length = sa_length + sb_length;
+	BigDigit *z1 = _digits_zeroed(z1_length);
+	if (sa_length && sb_length) {
+		if (sa_length >= sb_length)
+			_mag_mul(z1, sa, sa_length, sb, sb_length);
+		else
+			_mag_mul(z1, sb, sb_length, sa, sa_length);
+	}
+	_mag_sub_from(z1, z1_length, r, _digits_normalize(r, 2*m));
+	_mag_sub_from(z1, z1_length, r + 2*m, _digits_normalize(r + 2*m, a1_length + b1_length));
+
+	// add it in the middle
+	z1_length = _digits_normalize(z1, z1_length);
+	_mag_add_into(r + m, a_length + b_length - m, z1, z1_length);
+
+	mem_unmanaged_free(sa);
+	mem_unmanaged_free(sb);
+	mem_unmanaged_free(z1);
+}
+
+// Multiplies two magnitudes, a_length >= b_length. The result goes into 'r',
+// which has to hold a_length + b_length digits.
+static void _mag_mul(BigDigit *r, const BigDigit *a, uint32_t a_length, const BigDigit *b, uint32_t b_length) {
+	if (b_length < KARATSUBA_THRESHOLD) {
+		_mag_mul_simple(r, a, a_length, b, b_length);
+		return;
+	}
+
+	if (b_length > a_length / 2) {
+		_mag_mul_karatsuba(r, a, a_length, b, b_length);
+		return;
+	}
+
+	// very unbalanced lengths - multiply 'b' by slices of 'a' of the same
+	// length as 'b' and add the partial results together
+	memset(r, 0, (a_length + b_length) * sizeof(BigDigit));
+	BigDigit *partial = _digits_allocate(2 * b_length);
+	uint32_t offset;
+	for (offset = 0; offset < a_length; offset += b_length) {
+		uint32_t slice_length = a_length - offset;
+		if (slice_length > b_length)
+			slice_length = b_length;
+		if (slice_length >= b_length)
+			_mag_mul(partial, a + offset, slice_length, b, b_length);
+		else
+			_mag_mul(partial, b, b_length, a + offset, slice_length);
+		_mag_add_into(r + offset, a_length + b_length - offset, partial, slice_length + b_length);
+	}
+	mem_unmanaged_free(partial);
+}
+
+// Divides a magnitude by a single digit, the quotient goes into 'q' (can be the
+// same as 'a'). Returns the remainder.
+static BigDigit _mag_divmod_digit(BigDigit *q, const BigDigit *a, uint32_t a_length, BigDigit divisor) {
+	uint64_t remainder = 0;
+	while (a_length--) {
+		uint64_t current = (remainder << DIGIT_BITS) | a[a_length];
+		q[a_length] = (BigDigit)(current / divisor);
+		remainder = current % divisor;
+	}
+	return (BigDigit)remainder;
+}
+
+// Long division (Knuth's algorithm D), u_length >= v_length >= 2 and the top digit
+// of 'v' is non-zero. The quotient (u_length - v_length + 1 digits) goes to 'q',
+// the remainder (v_length digits) to 'r'. Either can be NULL if not needed.
+static void _mag_divmod(BigDigit *q, BigDigit *r, const BigDigit *u, uint32_t u_length, const BigDigit *v, uint32_t v_length) {
+	uint32_t m = u_length, n = v_length;
+	int i, j;
+
+	// normalize, so that the top digit of the divisor has its highest bit set -
+	// this makes the quotient digit estimates at most 2 off
+	int shift = __builtin_clz(v[n-1]);
+	BigDigit *vn = _digits_allocate(n), *un = _digits_allocate(m + 1);
+	for (i = n - 1; i > 0; i--)
+		vn[i] = (v[i] << shift) | (BigDigit)((uint64_t)v[i-1] >> (DIGIT_BITS - shift));
+	vn[0] = v[0] << shift;
+	un[m] = (BigDigit)((uint64_t)u[m-1] >> (DIGIT_BITS - shift));
+	for (i = m - 1; i > 0; i--)
+		un[i] = (u[i] << shift) | (BigDigit)((uint64_t)u[i-1] >> (DIGIT_BITS - shift));
+	un[0] = u[0] << shift;
+
+	for (j = m - n; j >= 0; j--) {
+		// estimate the quotient digit
+		uint64_t numerator = ((uint64_t)un[j+n] << DIGIT_BITS) | un[j+n-1];
+		uint64_t qhat = numerator / vn[n-1];
+		uint64_t rhat = numerator - qhat * vn[n-1];
+		while ((qhat >= DIGIT_BASE) || (qhat * vn[n-2] > ((rhat << DIGIT_BITS) | un[j+n-2]))) {
+			qhat--;
+			rhat += vn[n-1];
+			if (rhat >= DIGIT_BASE)
+				break;
+		}
+
+		// multiply and subtract
+		int64_t borrow = 0, t;
+		for (i = 0; i < (int)n; i++) {
+			uint64_t product = qhat * vn[i];
+			t = (int64_t)un[i+j] - borrow - (int64_t)(product & 0xffffffffull);
+			un[i+j] = (BigDigit)t;
+			borrow = (int64_t)(product >> DIGIT_BITS) - (t >> DIGIT_BITS);
+		}
+		t = (int64_t)un[j+n] - borrow;
+		un[j+n] = (BigDigit)t;
+
+		// the estimate was one too many - add back
+		if (t < 0) {
+			qhat--;
+			uint64_t carry = 0;
+			for (i = 0; i < (int)n; i++) {
+				carry += (uint64_t)un[i+j] + vn[i];
+				un[i+j] = (BigDigit)carry;
+				carry >>= DIGIT_BITS;
+			}
+			un[j+n] += (BigDigit)carry;
+		}
+		if (q)
+			q[j] = (BigDigit)qhat;
+	}
+
+	// denormalize the remainder
+	if (r) {
+		for (i = 0; i < (int)n; i++)
+			r[i] = (un[i] >> shift) | (BigDigit)((uint64_t)un[i+1] << (DIGIT_BITS - shift));
+	}
+
+	mem_unmanaged_free(vn);
+	mem_unmanaged_free(un);
+}
+
+// ===============================================================
+//  Operations
+// ===============================================================
+
+// Adds two integers with the sign of 'b' flipped if requested.
+static SepV _bigint_add_signed(SepV a, SepV b, bool flip_b) {
+	BigView va, vb;
+	_big_view(a, &va);
+	_big_view(b, &vb);
+	bool b_negative = vb.negative ^ flip_b;
+
+	uint32_t length = ((va.length > vb.length) ? va.length : vb.length) + 1;
+	BigDigit *result = _digits_zeroed(length);
+	bool negative;
+
+	if (va.negative == b_negative) {
+		// same signs - add the magnitudes
+		memcpy(result, va.digits, va.length * sizeof(BigDigit));
+		_mag_add_into(result, length, vb.digits, vb.length);
+		negative = va.negative;
+	} else if (_mag_compare(va.digits, va.length, vb.digits, vb.length) >= 0) {
+		// different signs - subtract the smaller magnitude from the bigger one
+		memcpy(result, va.digits, va.length * sizeof(BigDigit));
+		_mag_sub_from(result, length, vb.digits, vb.length);
+		negative = va.negative;
+	} else {
+		memcpy(result, vb.digits, vb.length * sizeof(BigDigit));
+		_mag_sub_from(result, length, va.digits, va.length);
+		negative = b_negative;
+	}
+
+	return _bigint_result_and_free(negative, result, length);
+}
+
+SepV bigint_add(SepV a, SepV b) {
+	return _bigint_add_signed(a, b, false);
+}
+
+SepV bigint_sub(SepV a, SepV b) {
+	return _bigint_add_signed(a, b, true);
+}
+
+SepV bigint_mul(SepV a, SepV b) {
+	BigView va, vb;
+	_big_view(a, &va);
+	_big_view(b, &vb);
+	if (!va.length || !vb.length)
+		return int_to_sepv(0);
+
+	uint32_t length = va.length + vb.length;
+	BigDigit *result = _digits_allocate(length);
+	if (va.length >= vb.length)
+		_mag_mul(result, va.digits, va.length, vb.digits, vb.length);
+	else
+		_mag_mul(result, vb.digits, vb.length, va.digits, va.length);
+
+	return _bigint_result_and_free(va.negative != vb.negative, result, length);
+}
+
+// Divides two integers, returning either the quotient or the remainder.
+static SepV _bigint_divmod(SepV a, SepV b, bool want_remainder) {
+	BigView va, vb;
+	_big_view(a, &va);
+	_big_view(b, &vb);
+
+	// the divisor is bigger - the quotient is zero
+	if (_mag_compare(va.digits, va.length, vb.digits, vb.length) < 0)
+		return want_remainder ? a : int_to_sepv(0);
+
+	uint32_t q_length = va.length - vb.length + 1;
+	BigDigit *quotient = _digits_allocate(va.length);
+	BigDigit *remainder = _digits_zeroed(vb.length);
+	if (vb.length == 1) {
+		remainder[0] = _mag_divmod_digit(quotient, va.digits, va.length, vb.digits[0]);
+		q_length = va.length;
+	} else {
+		_mag_divmod(quotient, remainder, va.digits, va.length, vb.digits, vb.length);
+	}
+
+	SepV result;
+	if (want_remainder)
+		result = _bigint_result(va.negative, remainder, vb.length);
+	else
+		result = _bigint_result(va.negative != vb.negative, quotient, q_length);
+
+	mem_unmanaged_free(quotient);
+	mem_unmanaged_free(remainder);
+	return result;
+}
+
+SepV bigint_div(SepV a, SepV b) {
+	return _bigint_divmod(a, b, false);
+}
+
+SepV bigint_mod(SepV a, SepV b) {
+	return _bigint_divmod(a, b, true);
+}
+
+SepV bigint_negate(SepV a) {
+	return bigint_sub(int_to_sepv(0), a);
+}
+
+int bigint_compare(SepV a, SepV b) {
+	BigView va, vb;
+	_big_view(a, &va);
+	_big_view(b, &vb);
+
+	// zero is never negative, so the signs decide if they differ
+	if (va.negative != vb.negative)
+		return va.negative ? -1 : 1;
+	int comparison = _mag_compare(va.digits, va.length, vb.digits, vb.length);
+	return va.negative ? -comparison : comparison;
+}
+
+// ===============================================================
+//  Conversions
+// ===============================================================
+
+SepString *bigint_to_string(SepV a) {
+	if (sepv_is_int(a))
+		return sepstr_sprintf("%lld", sepv_to_int(a));
+
+	BigView va;
+	_big_view(a, &va);
+
+	// split the number into chunks of 9 decimal digits, least significant first
+	// by repeatedly dividing by 10^9 (each digit holds at most 9.64 decimal digits)
+	uint32_t length = va.length;
+	BigDigit *magnitude = _digits_allocate(length);
+	memcpy(magnitude, va.digits, length * sizeof(BigDigit));
+	BigDigit *chunks = _digits_allocate(length * 2);
+	uint32_t chunk_count = 0;
+	while (length) {
+		chunks[chunk_count++] = _mag_divmod_digit(magnitude, magnitude, length, DECIMAL_CHUNK);
+		length = _digits_normalize(magnitude, length);
+	}
+
+	// the top chunk is printed without padding, the rest are zero-padded
+	char buffer[DECIMAL_CHUNK_DIGITS + 2];
+	int top_length = sprintf(buffer, "%s%u", va.negative ? "-" : "", chunks[chunk_count-1]);
+	SepString *string = sepstr_with_length(top_length + (chunk_count - 1) * DECIMAL_CHUNK_DIGITS);
+	char *dest = string->cstr;
+	memcpy(dest, buffer, top_length);
+	dest += top_length;
+	int32_t index;
+	for (index = chunk_count - 2; index >= 0; index--) {
+		BigDigit chunk = chunks[index];
+		int position;
+		for (position = DECIMAL_CHUNK_DIGITS - 1; position >= 0; position--) {
+			dest[position] = '0' + (chunk % 10);
+			chunk /= 10;
+		}
+		dest += DECIMAL_CHUNK_DIGITS;
+	}
+
+	mem_unmanaged_free(magnitude);
+	mem_unmanaged_free(chunks);
+	return string;
+}
+
+SepFloat bigint_to_float(SepV a) {
+	if (sepv_is_int(a))
+		return (SepFloat)sepv_to_int(a);
+
+	// the top three digits hold more than enough precision
+	BigView va;
+	_big_view(a, &va);
+	SepFloat result = 0.0;
+	int32_t index, lowest = (va.length > 3) ? va.length - 3 : 0;
+	for (index = va.length - 1; index >= lowest; index--)
+		result = result * (SepFloat)DIGIT_BASE + va.digits[index];
+	for (index = 0; index < lowest; index++)
+		result *= (SepFloat)DIGIT_BASE;
+
+	return va.negative ? -result : result;
+}
+
+SepV bigint_from_float(SepFloat number) {
+	if ((number > (SepFloat)SEPV_INT_MIN) && (number < (SepFloat)SEPV_INT_MAX))
+		return int_to_sepv((SepInt)number);
+
+	// the number is at least 2^60 in magnitude, so it's an integer
+	// made of the 53-bit mantissa shifted left by 'shift' bits
+	_SepFloatBits f = {number};
+	uint64_t mantissa = (f.bits & ((1ull << 52) - 1)) | (1ull << 52);
+	int shift = (int)((f.bits >> 52) & 0x7ff) - 1075;
+
+	uint32_t length = (53 + shift) / DIGIT_BITS + 2;
+	BigDigit *digits = _digits_zeroed(length);
+	uint32_t offset = shift / DIGIT_BITS, bit_shift = shift % DIGIT_BITS;
+	digits[offset] = (BigDigit)(mantissa << bit_shift);
+	digits[offset+1] = (BigDigit)(mantissa >> (DIGIT_BITS - bit_shift));
+	if (offset + 2 < length)
+		digits[offset+2] = (BigDigit)((mantissa >> (DIGIT_BITS - bit_shift)) >> DIGIT_BITS);
+
+	return _bigint_result_and_free(number < 0, digits, length);
+}
@@ -0,0 +1,103 @@
+#ifndef _SEP_BIGINTS_H
+#define _SEP_BIGINTS_H
+
+/*****************************************************************
+ **
+ ** vm/bigints.h
+ **
+ ** Arbitrary precision integers. Integers normally live unboxed
+ ** inside a SepV, but once a result doesn't fit in the 61 bits
+ ** available, it is transparently promoted to a heap-allocated
+ ** big integer - and demoted back once it fits again.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdint.h>
+#include "types.h"
+#include "objects.h"
+
+// ===============================================================
+//  Big integers
+// ===============================================================
+
+// The range of integers that fits inside a SepV.
+#define SEPV_INT_MAX ((1LL << 60) - 1LL)
+#define SEPV_INT_MIN (-(1LL << 60))
+#define int_fits_sepv(i) (((i) >= SEPV_INT_MIN) && ((i) <= SEPV_INT_MAX))
+
+// Big integers are stored as sign-magnitude, with the magnitude split
+// into 32-bit digits.
+typedef uint32_t BigDigit;
+
+/**
+ * Like arrays, big integers are an extension of September objects,
+ * with Integer as their prototype - so from the point of view of
+ * September code, they're indistinguishable from small integers.
+ * The digits are stored inline, least significant first, and the
+ * most significant digit is never zero. Big integers are immutable
+ * and never hold a value that would fit in a SepV.
+ */
+typedef struct SepBigInt {
+	// the SepObj base struct
+	SepObj base;
+	// the sign
+	bool negative;
+	// the number of digits
+	uint32_t length;
+	// the digits themselves
+	BigDigit digits[];
+} SepBigInt;
+
+#define obj_is_bigint(obj) (((SepObj*)(obj))->traits.representation == REPRESENTATION_BIGINT)
+#define sepv_is_bigint(val) (sepv_is_obj(val) && obj_is_bigint(sepv_to_obj(val)))
+#define sepv_to_bigint(val) ((SepBigInt*)(sepv_to_obj(val)))
+
+// Checks whether the value is an integer of any size.
+#define sepv_is_integer(val) (sepv_is_int(val) || sepv_is_bigint(val))
+
+// ===============================================================
+//  Operations
+// ===============================================================
+
+/**
+ * All the operations below accept any integers - small or big - and
+ * return results in the canonical form: small if they fit in a SepV,
+ * big otherwise.
+ */
+
+// Adds two integers.
+SepV bigint_add(SepV a, SepV b);
+// Subtracts two integers.
+SepV bigint_sub(SepV a, SepV b);
+// Multiplies two integers.
+SepV bigint_mul(SepV a, SepV b);
+// Divides two integers, rounding towards zero. The divisor can't be 0.
+SepV bigint_div(SepV a, SepV b);
+// Finds the remainder of a division rounding towards zero (so the sign
+// follows the dividend, like in C). The divisor can't be 0.
+SepV bigint_mod(SepV a, SepV b);
+// Negates an integer.
+SepV bigint_negate(SepV a);
+// Compares two integers, returning a negative number, 0 or a positive number.
+int bigint_compare(SepV a, SepV b);
+
+// ===============================================================
+//  Conversions
+// ===============================================================
+
+// Converts an integer to its decimal representation.
+SepString *bigint_to_string(SepV a);
+// Converts an integer to a float. Numbers too large become an infinity.
+SepFloat bigint_to_float(SepV a);
+// Converts a finite float to an integer, rounding towards zero.
+SepV bigint_from_float(SepFloat number);
+
+/*****************************************************************/
+
+#endif
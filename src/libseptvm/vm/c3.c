@@ -24,45 +24,26 @@
 //  Caching
 // ===============================================================
 
-// Returns the cached C3 order stored within an object, if there is one.
-// If not, returns NULL.
+// Returns the cached C3 order stored within an object, if there is one
+// and it's still valid. If not, returns NULL.
 SepArray *c3_cached_order(SepV object_v) {
 	if (!sepv_is_obj(object_v))
 		return NULL;
 	SepObj *object = sepv_to_obj(object_v);
-	Slot *cache_slot = props_find_prop(object, sepstr_for("<c3>"));
-	if (cache_slot && cache_slot->value != SEPV_NO_VALUE) {
-		return sepv_to_array(cache_slot->value);
-	} else {
+	if (object->c3_version != *lsvm_globals.property_cache_version)
 		return NULL;
-	}
-}
-
-// Returns the version number of the cached C3 order stored within an
-// object, or 0 if there isn't one. These version numbers can be used
-// to detect when the cache has to be invalidated due to prototype
-// changes.
-int64_t c3_cache_version(SepV object_v) {
-	if (!sepv_is_obj(object_v))
-		return 0;
-	SepObj *object = sepv_to_obj(object_v);
-	Slot *cache_v_slot = props_find_prop(object, sepstr_for("<c3version>"));
-	if (cache_v_slot) {
-		return sepv_to_int(cache_v_slot->value);
-	} else {
-		return 0;
-	}
+	return object->c3_order;
 }
 
 // Stores the previously calculated C3 order in the object it belongs to,
-// along with a version number used to validate this cache.
+// along with the version number used to validate this cache.
 void c3_store_cached_order(SepV object_v, SepArray *order) {
 	if (!sepv_is_obj(object_v))
 		return;
 
 	SepObj *object = sepv_to_obj(object_v);
-	obj_add_field(object, "<c3>", obj_to_sepv(order));
-	obj_add_field(object, "<c3version>", int_to_sepv(lsvm_globals.property_cache_version));
+	object->c3_order = order;
+	object->c3_version = *lsvm_globals.property_cache_version;
 }
 
 // Invalidates the internally cached C3 order stored within the object,
@@ -71,10 +52,12 @@ void c3_invalidate_cache(SepV object_v) {
 	if (!sepv_is_obj(object_v))
 		return;
 	SepObj *object = sepv_to_obj(object_v);
-	Slot *cache_slot = props_find_prop(object, sepstr_for("<c3>"));
-	if (cache_slot) {
-		cache_slot->value = SEPV_NO_VALUE;
-        props_set_prop(object, sepstr_for("<c3version>"), ++lsvm_globals.property_cache_version);
+	if (object->c3_order) {
+		// calculating the order of any object caches the orders of all its
+		// prototypes, so only objects with a cache can be a part of other
+		// cached orders - and these orders have to be invalidated too
+		object->c3_order = NULL;
+		(*lsvm_globals.property_cache_version)++;
 	}
 }
 
@@ -187,14 +170,9 @@ SepArray *c3_order(SepV object_v, SepV *error) {
 	SepV err = SEPV_NO_VALUE;
 
 	// do we have a resolution order cached?
-	if (sepv_is_obj(object_v)) {
-		SepObj *object = sepv_to_obj(object_v);
-		Slot *cache_slot = props_find_prop(object, sepstr_for("<c3>"));
-		if (cache_slot && (cache_slot->value != SEPV_NO_VALUE)) {
-			// yes, there is a cached order - return it
-			return sepv_to_array(cache_slot->value);
-		}
-	}
+	SepArray *cached = c3_cached_order(object_v);
+	if (cached)
+		return cached;
 
 	// no - calculate it
 	SepArray *order = c3_determine_order(object_v, &err);
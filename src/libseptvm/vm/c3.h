@@ -30,12 +30,6 @@ struct SepArray;
 // an error will be raised.
 struct SepArray *c3_order(SepV object_v, SepV *error);
 
-// Returns the version number of the cached C3 order stored within an
-// object, or 0 if there isn't one. These version numbers can be used
-// to detect when the cache has to be invalidated due to prototype
-// changes.
-int64_t c3_cache_version(SepV object_v);
-
 // Invalidates the internally cached C3 order stored within the object,
 // causing it to be recalculated on next property access.
 void c3_invalidate_cache(SepV object_v);
@@ -12,10 +12,230 @@
 //  Includes
 // ===============================================================
 
+#include <ctype.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "types.h"
 #include "objects.h"
+#include "strings.h"
 #include "exceptions.h"
+#include "functions.h"
+#include "module.h"
+#include "mem.h"
+#include "vm.h"
 #include "../vm/runtime.h"
+#include "../libmain.h"
+
+// ===============================================================
+//  Capturing messages
+// ===============================================================
+
+/**
+ * The arguments of a lazily formatted message, captured on the stack before
+ * we know how much memory they will need.
+ */
+typedef struct MessageCapture {
+	// the format the arguments are for
+	const char *format;
+	// the arguments, and the number of characters to copy for each string
+	MessageArgument arguments[EXCEPTION_MAX_ARGUMENTS];
+	size_t lengths[EXCEPTION_MAX_ARGUMENTS];
+	uint8_t count;
+	// the memory needed for the copies of all strings, terminators included
+	size_t string_bytes;
+} MessageCapture;
+
+// Adds a new argument to a capture, returning NULL if there is no more space.
+static inline MessageArgument *capture_next(MessageCapture *this, char kind) {
+	if (this->count == EXCEPTION_MAX_ARGUMENTS)
+		return NULL;
+	this->lengths[this->count] = 0;
+	MessageArgument *argument = &this->arguments[this->count++];
+	argument->kind = kind;
+	return argument;
+}
+
+// Checks whether a character is a conversion taking an integer.
+static inline bool is_integer_conversion(char c) {
+	return c && strchr("diouxXc", c);
+}
+
+// Goes through the conversions in a printf-style format, capturing the
+// arguments they take. Returns false if the format uses anything that can't
+// be captured or needs too many arguments.
+static bool capture_arguments(MessageCapture *this, va_list args) {
+	const char *c = this->format;
+	this->count = 0;
+	this->string_bytes = 0;
+	while ((c = strchr(c, '%'))) {
+		c++;
+		if (*c == '%') {
+			c++;
+			continue;
+		}
+
+		// flags, width and precision - '*' takes an argument of its own
+		int precision = -1;
+		MessageArgument *star;
+		while (*c && strchr("-+ #0", *c))
+			c++;
+		if (*c == '*') {
+			if (!(star = capture_next(this, 'i'))) return false;
+			star->value.integer = va_arg(args, int);
+			c++;
+		}
+		while (isdigit(*c))
+			c++;
+		if (*c == '.') {
+			c++;
+			if (*c == '*') {
+				if (!(star = capture_next(this, 'i'))) return false;
+				precision = star->value.integer = va_arg(args, int);
+				c++;
+			} else {
+				precision = atoi(c);
+				while (isdigit(*c))
+					c++;
+			}
+		}
+
+		// length modifiers
+		char length = ' ';
+		if (*c == 'h') {
+			c += (c[1] == 'h') ? 2 : 1;
+		} else if (*c == 'l') {
+			length = (c[1] == 'l') ? 'L' : 'l';
+			c += (c[1] == 'l') ? 2 : 1;
+		} else if (*c && strchr("zjtL", *c)) {
+			length = *c++;
+		}
+
+		// the conversion itself
+		char conversion = *c++;
+		bool is_signed = strchr("dic", conversion) != NULL;
+		MessageArgument *argument = capture_next(this, is_signed ? 'i' : 'u');
+		if (!argument)
+			return false;
+		if (is_integer_conversion(conversion) && is_signed) {
+			switch (length) {
+				case ' ': argument->value.integer = va_arg(args, int); break;
+				case 'l': argument->value.integer = va_arg(args, long); break;
+				case 'L': argument->value.integer = va_arg(args, long long); break;
+				case 'z': argument->value.integer = va_arg(args, ptrdiff_t); break;
+				case 'j': argument->value.integer = va_arg(args, intmax_t); break;
+				case 't': argument->value.integer = va_arg(args, ptrdiff_t); break;
+				default: return false;
+			}
+		} else if (is_integer_conversion(conversion)) {
+			switch (length) {
+				case ' ': argument->value.unsigned_integer = va_arg(args, unsigned int); break;
+				case 'l': argument->value.unsigned_integer = va_arg(args, unsigned long); break;
+				case 'L': argument->value.unsigned_integer = va_arg(args, unsigned long long); break;
+				case 'z': argument->value.unsigned_integer = va_arg(args, size_t); break;
+				case 'j': argument->value.unsigned_integer = va_arg(args, uintmax_t); break;
+				case 't': argument->value.unsigned_integer = va_arg(args, size_t); break;
+				default: return false;
+			}
+		} else if (conversion && strchr("eEfFgGaA", conversion) && (length == ' ')) {
+			argument->kind = 'f';
+			argument->value.real = va_arg(args, double);
+		} else if (conversion == 's' && (length == ' ')) {
+			// strings are copied, as whatever they point to might be gone by the time we need them
+			const char *string = va_arg(args, const char*);
+			if (!string)
+				string = "(null)";
+			size_t string_length = (precision >= 0) ? strnlen(string, precision) : strlen(string);
+			argument->kind = 's';
+			argument->value.string = string;
+			this->lengths[this->count - 1] = string_length;
+			this->string_bytes += string_length + 1;
+		} else if (conversion == 'p') {
+			argument->kind = 'p';
+			argument->value.pointer = va_arg(args, void*);
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+// ===============================================================
+//  Exception details
+// ===============================================================
+
+// Captures the backtrace of the current VM into an array, returning its depth.
+static uint32_t capture_backtrace(BacktraceEntry *entries) {
+	SepVM *vm = vm_current();
+	if (!*lsvm_globals.capture_backtraces || !vm)
+		return 0;
+
+	uint32_t depth = 0;
+	int f;
+	for (f = vm->frame_depth; (f >= 0) && (depth < BACKTRACE_MAX_DEPTH); f--) {
+		ExecutionFrame *frame = &vm->frames[f];
+		if (!frame->block || !frame->instruction_ptr)
+			continue;
+		// the instruction pointer is already past the instruction that got us here
+		entries[depth].block = frame->block;
+		entries[depth].offset = frame->instruction_ptr - frame->block->instructions - 1;
+		depth++;
+	}
+	return depth;
+}
+
+// Attaches the details to a freshly created exception object - the backtrace,
+// and the captured message arguments (if 'message' isn't NULL).
+static void exception_attach_details(SepObj *exception, MessageCapture *message) {
+	BacktraceEntry entries[BACKTRACE_MAX_DEPTH];
+	uint32_t depth = capture_backtrace(entries);
+	if (!depth && !message)
+		return;
+
+	// everything goes into one allocation
+	uint8_t argument_count = message ? message->count : 0;
+	size_t string_bytes = message ? message->string_bytes : 0;
+	ExceptionDetails *details = mem_allocate(sizeof(ExceptionDetails)
+			+ depth * sizeof(BacktraceEntry)
+			+ argument_count * sizeof(MessageArgument)
+			+ string_bytes);
+
+	details->backtrace.depth = depth;
+	memcpy(details->backtrace.entries, entries, depth * sizeof(BacktraceEntry));
+
+	details->format = message ? message->format : NULL;
+	details->argument_count = argument_count;
+	details->arguments = (MessageArgument*)(details->backtrace.entries + depth);
+	char *strings = (char*)(details->arguments + argument_count);
+	uint8_t index;
+	for (index = 0; index < argument_count; index++) {
+		MessageArgument *argument = &details->arguments[index];
+		*argument = message->arguments[index];
+		if (argument->kind == 's') {
+			size_t length = message->lengths[index];
+			memcpy(strings, argument->value.string, length);
+			strings[length] = '\0';
+			argument->value.string = strings;
+			strings += length + 1;
+		}
+	}
+
+	exception->data = details;
+	exception->traits.exception_details = true;
+}
+
+// Returns the details for an exception (given either as a live exception
+// or as the object), or NULL if it has none.
+static ExceptionDetails *exception_details(SepV exception) {
+	SepV exception_v = exception_to_obj_sepv(exception);
+	if (!sepv_is_obj(exception_v))
+		return NULL;
+	SepObj *obj = sepv_to_obj(exception_v);
+	return obj->traits.exception_details ? obj->data : NULL;
+}
 
 // ===============================================================
 //  Working with exceptions
@@ -28,8 +248,9 @@ SepV sepv_exception(SepObj *prototype, SepString *message) {
 		prototype = exc.Exception;
 	SepObj *exception_obj = obj_create_with_proto(obj_to_sepv(prototype));
 
-	// set the message
+	// set the message and remember where we were
 	props_add_field(exception_obj, "message", str_to_sepv(message));
+	exception_attach_details(exception_obj, NULL);
 
 	// return it
 	return obj_to_exception(exception_obj);
@@ -39,3 +260,164 @@ SepV sepv_exception(SepObj *prototype, SepString *message) {
 SepItem si_exception(SepObj *prototype, SepString *message) {
 	return item_rvalue(sepv_exception(prototype, message));
 }
+
+// Creates a new live exception with a message formatted only when needed.
+static SepV vsepv_exceptionf(SepObj *prototype, const char *format, va_list args) {
+	if (prototype == NULL)
+		prototype = exc.Exception;
+	SepObj *exception_obj = obj_create_with_proto(obj_to_sepv(prototype));
+
+	MessageCapture message;
+	message.format = format;
+	va_list captured_args;
+	va_copy(captured_args, args);
+	bool captured = capture_arguments(&message, captured_args);
+	va_end(captured_args);
+
+	if (captured) {
+		exception_attach_details(exception_obj, &message);
+	} else {
+		// not something we can capture, so it has to be formatted right away
+		props_add_field(exception_obj, "message", str_to_sepv(sepstr_vsprintf(format, args)));
+		exception_attach_details(exception_obj, NULL);
+	}
+	return obj_to_exception(exception_obj);
+}
+
+SepV sepv_exceptionf(SepObj *prototype, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	SepV exception = vsepv_exceptionf(prototype, format, args);
+	va_end(args);
+	return exception;
+}
+
+SepItem si_exceptionf(SepObj *prototype, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	SepV exception = vsepv_exceptionf(prototype, format, args);
+	va_end(args);
+	return item_rvalue(exception);
+}
+
+// ===============================================================
+//  Formatting messages
+// ===============================================================
+
+// Formats a single conversion with a captured argument into the buffer (if there is one),
+// returning the number of characters it takes. 'arguments' is advanced past everything
+// the conversion used.
+static int format_conversion(const char *conversion, size_t conversion_length,
+		MessageArgument **arguments, char *buffer, size_t size) {
+	// rebuild the conversion with '*'s filled in, and all integers passed as long longs
+	char spec[48], *out = spec;
+	const char *c;
+	for (c = conversion; c < conversion + conversion_length - 1; c++) {
+		if (*c == '*') {
+			int64_t number = (*arguments)++->value.integer;
+			if ((number >= 0) || (c[-1] != '.'))
+				out += sprintf(out, "%d", (int)number);
+			else
+				out--; // negative precision means no precision at all
+		} else if (!strchr("hlzjtL", *c)) {
+			*out++ = *c;
+		}
+	}
+	char type = conversion[conversion_length - 1];
+	if (is_integer_conversion(type) && (type != 'c')) {
+		*out++ = 'l';
+		*out++ = 'l';
+	}
+	*out++ = type;
+	*out = '\0';
+
+	MessageArgument *argument = (*arguments)++;
+	switch (argument->kind) {
+		case 'i':
+			if (type == 'c')
+				return snprintf(buffer, size, spec, (int)argument->value.integer);
+			return snprintf(buffer, size, spec, (long long)argument->value.integer);
+		case 'u': return snprintf(buffer, size, spec, (unsigned long long)argument->value.unsigned_integer);
+		case 'f': return snprintf(buffer, size, spec, argument->value.real);
+		case 's': return snprintf(buffer, size, spec, argument->value.string);
+		default: return snprintf(buffer, size, spec, argument->value.pointer);
+	}
+}
+
+// Formats the message from the details into a buffer of a given size. Returns
+// the length of the whole message, even if it didn't fit.
+static size_t format_message(ExceptionDetails *details, char *buffer, size_t size) {
+	MessageArgument *arguments = details->arguments;
+	size_t length = 0;
+	const char *c = details->format;
+	while (*c) {
+		// the text between conversions is copied as it is
+		const char *next = strchr(c, '%');
+		size_t text_length = next ? (size_t)(next - c) : strlen(c);
+		if (length + text_length < size)
+			memcpy(buffer + length, c, text_length);
+		length += text_length;
+		c += text_length;
+		if (!next)
+			break;
+
+		// '%%' is just a percent sign
+		if (c[1] == '%') {
+			if (length + 1 < size)
+				buffer[length] = '%';
+			length++;
+			c += 2;
+			continue;
+		}
+
+		// find the end of the conversion and format it
+		const char *end = c + 1;
+		while (*end && !isalpha(*end))
+			end++;
+		while (*end && strchr("hlzjtL", *end))
+			end++;
+		end++;
+		bool fits = length < size;
+		length += format_conversion(c, end - c, &arguments,
+				fits ? buffer + length : NULL, fits ? size - length : 0);
+		c = end;
+	}
+	if (length < size)
+		buffer[length] = '\0';
+	return length;
+}
+
+SepString *exception_message(SepV exception) {
+	ExceptionDetails *details = exception_details(exception);
+	if (!details || !details->format)
+		return NULL;
+
+	// measure first, then format it straight into the string
+	size_t length = format_message(details, NULL, 0);
+	SepString *message = sepstr_with_length(length);
+	format_message(details, message->cstr, length + 1);
+	return message;
+}
+
+// ===============================================================
+//  Backtraces
+// ===============================================================
+
+void exception_capture_backtrace(SepObj *exception) {
+	if (!exception->data)
+		exception_attach_details(exception, NULL);
+}
+
+Backtrace *exception_backtrace(SepV exception) {
+	ExceptionDetails *details = exception_details(exception);
+	return details ? &details->backtrace : NULL;
+}
+
+SepString *backtrace_describe(BacktraceEntry *entry) {
+	char *module_name = entry->block->module ? entry->block->module->name : "?";
+	uint32_t line = codeblock_line(entry->block, entry->offset);
+	if (line)
+		return sepstr_sprintf("%s:%d", module_name, line);
+	else
+		return sepstr_sprintf("%s:?", module_name);
+}
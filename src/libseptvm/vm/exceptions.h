@@ -16,9 +16,12 @@
 //  Includes
 // ===============================================================
 
+#include <stdint.h>
 #include "types.h"
 #include "objects.h"
 
+struct CodeBlock;
+
 // ===============================================================
 //  Working with exceptions
 // ===============================================================
@@ -28,6 +31,92 @@ SepV sepv_exception(SepObj *prototype, SepString *message);
 // Creates a new live exception and returns it as an r-value.
 SepItem si_exception(SepObj *prototype, SepString *message);
 
+// Creates a new live exception with a printf-style message that is only
+// formatted once somebody reads it. The arguments (strings included) are
+// captured right away, but the format itself is not copied, so it has to
+// stay around forever (a string literal, in other words).
+SepV sepv_exceptionf(SepObj *prototype, const char *format, ...);
+// Same as above, returning the exception as an r-value.
+SepItem si_exceptionf(SepObj *prototype, const char *format, ...);
+// Formats the message of an exception created by sepv_exceptionf(). Returns
+// NULL for exceptions that were created in any other way.
+SepString *exception_message(SepV exception);
+
+// ===============================================================
+//  Backtraces
+// ===============================================================
+
+// how many frames (counting from the innermost) a backtrace can hold
+#define BACKTRACE_MAX_DEPTH 32
+
+/**
+ * A backtrace is captured whenever an exception is created or thrown, but
+ * it's kept as cheap as possible - it's just the code block and the offset
+ * inside it for every interpreted frame. Turning that into anything
+ * readable (which requires looking through line tables) only happens when
+ * someone actually asks for it.
+ */
+typedef struct BacktraceEntry {
+	// the code block the frame was running
+	struct CodeBlock *block;
+	// the offset of the instruction being executed inside that block
+	uint32_t offset;
+} BacktraceEntry;
+
+typedef struct Backtrace {
+	// the number of entries, the innermost frame coming first
+	uint32_t depth;
+	BacktraceEntry entries[0];
+} Backtrace;
+
+// Captures the backtrace of the current VM into an exception object. Does nothing
+// if the object already has one, or has other data attached.
+void exception_capture_backtrace(SepObj *exception);
+// Returns the backtrace captured for an exception (given either as a live
+// exception or as the object), or NULL if there is none.
+Backtrace *exception_backtrace(SepV exception);
+// Describes a single backtrace entry as 'module:line' in a string.
+SepString *backtrace_describe(BacktraceEntry *entry);
+
+// ===============================================================
+//  Exception details
+// ===============================================================
+
+// the most arguments a lazily formatted message can capture
+#define EXCEPTION_MAX_ARGUMENTS 8
+
+/**
+ * A single argument captured for a lazily formatted message. Width and
+ * precision given as '*' are captured as separate integer arguments.
+ */
+typedef struct MessageArgument {
+	// 'i' for integers, 'u' for unsigned ones, 'f' for doubles,
+	// 's' for strings, 'p' for pointers
+	char kind;
+	union {
+		int64_t integer;
+		uint64_t unsigned_integer;
+		double real;
+		const char *string;
+		void *pointer;
+	} value;
+} MessageArgument;
+
+/**
+ * Everything the C side knows about an exception, kept in the exception
+ * object's auxillary data - all in one allocation, the backtrace entries
+ * first, followed by the arguments and copies of any strings among them.
+ */
+typedef struct ExceptionDetails {
+	// the format of the message, or NULL if the message is a plain field
+	const char *format;
+	// the arguments for the format
+	MessageArgument *arguments;
+	uint8_t argument_count;
+	// where the exception came from
+	Backtrace backtrace;
+} ExceptionDetails;
+
 /*****************************************************************/
 
 #endif
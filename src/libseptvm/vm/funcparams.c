@@ -63,8 +63,8 @@ Argument *_bytecode_next_argument(ArgumentSource *_this) {
 			// block - that's a lazy evaluated argument
 			CodeBlock *block = frame_block(frame, ref_index);
 			if (!block) {
-				this->current_arg.value = sepv_exception(exc.EInternal,
-						sepstr_sprintf("Code block %d out of bounds.", ref_index));
+				this->current_arg.value = sepv_exceptionf(exc.EInternal,
+						"Code block %d out of bounds.", ref_index);
 				return &this->current_arg;
 			}
 			SepFunc *argument_l = (SepFunc*)lazy_create(block, frame->locals);
@@ -72,7 +72,7 @@ Argument *_bytecode_next_argument(ArgumentSource *_this) {
 			break;
 		}
 		default:
-			this->current_arg.value = sepv_exception(exc.EInternal, sepstr_sprintf("Unrecognized reference type: %d", ref_type));
+			this->current_arg.value = sepv_exceptionf(exc.EInternal, "Unrecognized reference type: %d", ref_type);
 	}
 
 	// return a pointer into our own structure
@@ -155,11 +155,11 @@ SepV funcparam_set_in_standard_parameter(FuncParam *param, SepObj *scope, SepV a
 	if (props_find_prop(scope, param->name)) {
 		// duplicate parameter
 		if (param->flags.type != PT_STANDARD_PARAMETER) {
-			return sepv_exception(exc.EWrongArguments,
-					sepstr_sprintf("Values for sink parameter '%s' provided both implicitly and explicitly.", param->name->cstr));
+			return sepv_exceptionf(exc.EWrongArguments,
+					"Values for sink parameter '%s' provided both implicitly and explicitly.", param->name->cstr);
 		} else {
-			return sepv_exception(exc.EWrongArguments,
-					sepstr_sprintf("Parameter '%s' was passed more than once in a function call.", param->name->cstr));
+			return sepv_exceptionf(exc.EWrongArguments,
+					"Parameter '%s' was passed more than once in a function call.", param->name->cstr);
 		}
 	}
 	props_add_prop(scope, param->name, &st_field, argument_value);
@@ -195,8 +195,8 @@ SepV funcparam_set_in_named_sink(FuncParam *this, SepObj *scope, SepString *argu
 	}
 	// set the property on the sink object
 	if (props_find_prop(sink_obj, argument_name)) {
-		return sepv_exception(exc.EWrongArguments,
-				sepstr_sprintf("Parameter '%s' was passed more than once in a function call.", this->name->cstr));
+		return sepv_exceptionf(exc.EWrongArguments,
+				"Parameter '%s' was passed more than once in a function call.", this->name->cstr);
 	}
 	props_add_prop(sink_obj, argument_name, &st_field, argument_value);
 	return SEPV_NOTHING;
@@ -225,7 +225,7 @@ SepV funcparam_set_in_scope(ExecutionFrame *frame, FuncParam *param, SepObj *sco
 		or_raise_sepv(value);
 
 	// did we arrive at this parameter by directly naming it in the call?
-	bool directly_named = argument->name && !sepstr_cmp(argument->name, param->name);
+	bool directly_named = argument->name && sepstr_equals(argument->name, param->name);
 	// pass value in the right manner for the parameter
 	if (param->flags.type == PT_STANDARD_PARAMETER || directly_named) {
 		// standard parameter, just set the value
@@ -237,8 +237,8 @@ SepV funcparam_set_in_scope(ExecutionFrame *frame, FuncParam *param, SepObj *sco
 	} else if (param->flags.type == PT_POSITIONAL_SINK) {
 		return funcparam_set_in_positional_sink(param, scope, value);
 	} else {
-		return sepv_exception(exc.EInternal,
-				sepstr_sprintf("Unrecognized paramer type for parameter '%s'.", param->name));
+		return sepv_exceptionf(exc.EInternal,
+				"Unrecognized paramer type for parameter '%s'.", param->name->cstr);
 	}
 
 	// everything OK
@@ -304,9 +304,9 @@ SepV funcparam_finalize_value(ExecutionFrame *frame, SepFunc *func, FuncParam *t
 			return SEPV_NOTHING;
 		} else {
 			// no default value to be found, that's an error
-			return sepv_exception(exc.EWrongArguments, sepstr_sprintf(
+			return sepv_exceptionf(exc.EWrongArguments,
 				"Required parameter '%s' is missing.", this->name->cstr
-			));
+			);
 		}
 	}
 
@@ -326,7 +326,7 @@ FuncParam *funcparam_find_parameter_for_named_argument(FuncParam *parameters, ar
 	FuncParam *named_sink = NULL;
 	for (p = 0; p < param_count; p++) {
 		param = &parameters[p];
-		if (!sepstr_cmp(param->name, argument->name))
+		if (sepstr_equals(param->name, argument->name))
 			return param;
 		if (param->flags.type == PT_NAMED_SINK)
 			named_sink = param;
@@ -374,14 +374,14 @@ SepV funcparam_pass_arguments(ExecutionFrame *frame, SepFunc *func, SepObj *scop
 			// named argument, find the right parameter to put it in
 			parameter = funcparam_find_parameter_for_named_argument(parameters, param_count, argument);
 			if (!parameter) {
-				return sepv_exception(exc.EWrongArguments,
-					sepstr_sprintf("Named argument '%s' does not match any parameter.", argument->name->cstr));
+				return sepv_exceptionf(exc.EWrongArguments,
+					"Named argument '%s' does not match any parameter.", argument->name->cstr);
 			}
 		} else {
 			// positional argument, find next positional parameter
 			if (position >= param_count) {
-				return sepv_exception(exc.EWrongArguments,
-					sepstr_sprintf("Too many arguments specified."));
+				return sepv_exceptionf(exc.EWrongArguments,
+					"Too many arguments specified.");
 			}
 			parameter = &parameters[position];
 		}
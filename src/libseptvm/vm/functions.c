@@ -203,6 +203,7 @@ void _interpreted_initialize_frame(SepFunc *_this, ExecutionFrame *frame) {
 
 	// set up instruction pointer
 	frame->module = this->block->module;
+	frame->block = this->block;
 	frame->instruction_ptr = this->block->instructions;
 }
 
@@ -97,6 +97,23 @@ BuiltInFunc *builtin_create_va(BuiltInImplFunc implementation, uint8_t parameter
 //  Code blocks
 // ===============================================================
 
+/**
+ * Debugging information for a code block, mapping offsets in the code to
+ * source lines. Entries are sorted by offset, and each one covers the code
+ * up to the next one.
+ */
+typedef struct LineEntry {
+	// offset into the block's instructions, in code units
+	uint32_t offset;
+	// the source line the code at that offset comes from
+	uint32_t line;
+} LineEntry;
+
+typedef struct LineTable {
+	uint32_t count;
+	LineEntry entries[0];
+} LineTable;
+
 /**
  * Represents a single code block from a module file. Those are just
  * the instructions - to get something callable, the block is wrapped
@@ -115,8 +132,14 @@ typedef struct CodeBlock {
 	CodeUnit *instructions;
 	// pointer to the space right after the last instruction in this block
 	CodeUnit *instructions_end;
+	// the line table for this block (NULL if there is none)
+	LineTable *lines;
 } CodeBlock;
 
+// Returns the source line the code at a given offset in a block comes from,
+// or 0 if there is no way to tell.
+uint32_t codeblock_line(CodeBlock *block, uint32_t offset);
+
 // ===============================================================
 //  Interpreted (September) functions
 // ===============================================================
@@ -24,6 +24,8 @@
 #include "objects.h"
 #include "functions.h"
 #include "arrays.h"
+#include "maps.h"
+#include "iterators.h"
 #include "vm.h"
 
 // ===============================================================
@@ -188,11 +190,14 @@ void gc_mark_region(void *region) {
 // Queues objects reachable from a SepObj for marking and marks its internal
 // memory regions.
 void gc_mark_and_queue_obj(GarbageCollection *this, SepObj *object) {
-	// mark the property map region
-	gc_mark_region(object->props.entries);
+	// mark the property map region (inline storage is a part of the object)
+	if (!object->props.inline_storage)
+		gc_mark_region(object->props.entries);
 
 	// mark auxillary C data, if we hold any
 	gc_mark_region(object->data);
+	if (object->traits.native_iterator)
+		iterator_mark_and_queue(object->data, this);
 
 	// queue property values
 	if (object->props.entries) {
@@ -210,8 +215,10 @@ void gc_mark_and_queue_obj(GarbageCollection *this, SepObj *object) {
 		}
 	}
 
-	// the prototypes are not to be collected
+	// the prototypes are not to be collected, and neither is the C3 order
 	gc_add_to_queue(this, object->prototypes);
+	if (object->c3_order)
+		gc_add_to_queue(this, obj_to_sepv(object->c3_order));
 
 	// arrays need to collect their elements too
 	if (object->traits.representation == REPRESENTATION_ARRAY) {
@@ -219,13 +226,31 @@ void gc_mark_and_queue_obj(GarbageCollection *this, SepObj *object) {
 		if (array->array.start) {
 			// mark the array's storage area as used
 			gc_mark_region(array->array.start);
-			// queue all elements of this array
+			// queue all elements of this array - packed arrays
+			// hold only numbers, so there's nothing to queue
+			if (array->kind != ARRAY_GENERIC)
+				return;
 			SepArrayIterator ait = array_iterate_over(array);
 			while (!arrayit_end(&ait)) {
 				gc_add_to_queue(this, arrayit_next(&ait));
 			}
 		}
 	}
+
+	// maps need to collect their keys and values
+	if (object->traits.representation == REPRESENTATION_MAP) {
+		SepMap *map = (SepMap*)object;
+		if (map->entries) {
+			// the entries and the hash table share a single region
+			gc_mark_region(map->entries);
+			SepMapIterator mit = map_iterate_over(map);
+			while (!mapit_end(&mit)) {
+				MapEntry *entry = mapit_next(&mit);
+				gc_add_to_queue(this, entry->key);
+				gc_add_to_queue(this, entry->value);
+			}
+		}
+	}
 }
 
 // Queues objects reachable from a SepFunc for marking and marks its internal
@@ -266,6 +291,11 @@ void gc_mark_one_object(GarbageCollection *this, SepV object) {
 		case SEPV_TYPE_SLOT:
 			gc_mark_and_queue_slot(this, (Slot*)ptr);
 			break;
+		case SEPV_TYPE_STRING:
+			// slices keep the string holding their characters alive - since
+			// slices never point to other slices, marking the region is enough
+			gc_mark_region(((SepString*)ptr)->parent);
+			break;
 	}
 }
 
@@ -472,6 +502,10 @@ void gc_perform_full_gc() {
 	gc_sweep_all(collection);
 	gc_free(collection);
 
+	// the memory of freed objects can now be reused for new ones, which
+	// would confuse the lookup cache
+	lsvm_globals.lookup_cache->collections++;
+
 	// update allocated/used tallies
 	mem_update_statistics();
 
@@ -0,0 +1,101 @@
+/*****************************************************************
+ **
+ ** vm/iterators.c
+ **
+ ** Implementation for the native iteration protocol.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include "mem.h"
+#include "gc.h"
+#include "exceptions.h"
+#include "strings.h"
+#include "iterators.h"
+#include "vm.h"
+
+#include "../vm/runtime.h"
+#include "../vm/support.h"
+
+// ===============================================================
+//  Native iterators
+// ===============================================================
+
+SepObj *iterator_create(SepV prototypes, IteratorVT *vt, SepV source) {
+	SepObj *obj = obj_create_with_proto(prototypes);
+
+	SepIterator *iterator = mem_allocate(sizeof(SepIterator));
+	iterator->vt = vt;
+	iterator->source = source;
+	iterator->position = 0;
+	iterator->limit = 0;
+	iterator->data = NULL;
+
+	obj->data = iterator;
+	obj->traits.native_iterator = true;
+	return obj;
+}
+
+SepIterator *sepv_to_iterator(SepV value) {
+	if (!sepv_is_obj(value))
+		return NULL;
+	SepObj *obj = sepv_to_obj(value);
+	return obj->traits.native_iterator ? (SepIterator*)obj->data : NULL;
+}
+
+void iterator_mark_and_queue(SepIterator *this, GarbageCollection *gc) {
+	gc_add_to_queue(gc, this->source);
+	if (this->vt->mark_and_queue)
+		this->vt->mark_and_queue(this, gc);
+}
+
+// The 'next' method shared by all native iterators.
+SepItem native_iterator_next(SepObj *scope, ExecutionFrame *frame) {
+	SepIterator *iterator = sepv_to_iterator(target(scope));
+	if (!iterator)
+		raise(exc.EWrongType, "This method can only be called on native iterators.");
+
+	SepV element;
+	if (!iterator->vt->next(iterator, &element))
+		raise(exc.ENoMoreElements, "No more elements.");
+	return item_rvalue(element);
+}
+
+SepObj *make_iterator_class(char *name) {
+	SepObj *cls = make_class(name, NULL);
+	obj_add_builtin_method(cls, "next", native_iterator_next, 0);
+	return cls;
+}
+
+// ===============================================================
+//  Iterating over anything
+// ===============================================================
+
+SepV iteration_start(SepIteration *this, SepVM *vm, SepV iterator) {
+	this->vm = vm;
+	this->native = sepv_to_iterator(iterator);
+	this->next = SEPV_NOTHING;
+	if (this->native)
+		return SEPV_NOTHING;
+
+	// not a native iterator, we'll have to call 'next'
+	this->next = property(iterator, "next");
+		or_raise_sepv(this->next);
+	return SEPV_NOTHING;
+}
+
+SepV iteration_next(SepIteration *this) {
+	SepV element;
+	if (this->native)
+		return this->native->vt->next(this->native, &element) ? element : SEPV_NO_VALUE;
+
+	element = vm_invoke(this->vm, this->next, 0).value;
+	if (sepv_is_no_more_elements(this->vm, element))
+		return SEPV_NO_VALUE;
+	return element;
+}
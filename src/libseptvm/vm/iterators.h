@@ -0,0 +1,104 @@
+#ifndef _SEP_ITERATORS_H
+#define _SEP_ITERATORS_H
+
+/*****************************************************************
+ **
+ ** vm/iterators.h
+ **
+ ** The native iteration protocol - iterators over built-in
+ ** collections that can be advanced directly from C, without
+ ** calling 'next' and waiting for ENoMoreElements.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "types.h"
+#include "objects.h"
+
+struct SepVM;
+struct SepIterator;
+struct GarbageCollection;
+
+// ===============================================================
+//  Native iterators
+// ===============================================================
+
+/**
+ * Each kind of native iterator provides its own v-table.
+ */
+typedef struct IteratorVT {
+	// Advances the iterator. Returns false once there are no more elements,
+	// otherwise stores the next element (or an exception, if getting it
+	// failed) in *element and returns true.
+	bool (*next)(struct SepIterator *this, SepV *element);
+	// Queues everything the iterator references for the GC, apart from
+	// the source, which is always queued. Can be NULL if there is nothing.
+	void (*mark_and_queue)(struct SepIterator *this, struct GarbageCollection *gc);
+} IteratorVT;
+
+/**
+ * The state of a native iterator. What exactly 'position' and 'limit'
+ * mean is up to the v-table, and 'data' can point to any additional state
+ * (allocated from managed memory and marked by the v-table).
+ */
+typedef struct SepIterator {
+	// the v-table for this kind of iterator
+	IteratorVT *vt;
+	// the collection we're iterating over
+	SepV source;
+	// the current position in the collection
+	int64_t position;
+	// the position at which the iteration ends
+	int64_t limit;
+	// any additional state
+	void *data;
+} SepIterator;
+
+/**
+ * Native iterators are also September objects. Their 'data' points to the
+ * SepIterator, and they can be used from September like any other iterator
+ * - their 'next' method throws ENoMoreElements at the end, as usual.
+ */
+
+// Creates a new iterator object with a given prototype, iterating over 'source'.
+SepObj *iterator_create(SepV prototypes, IteratorVT *vt, SepV source);
+// Returns the native iterator behind an object, or NULL if it isn't one.
+SepIterator *sepv_to_iterator(SepV value);
+// Creates a new class for native iterators, with a 'next' method that works for all of them.
+SepObj *make_iterator_class(char *name);
+// Queues everything a native iterator references for the GC.
+void iterator_mark_and_queue(SepIterator *this, struct GarbageCollection *gc);
+
+// ===============================================================
+//  Iterating over anything
+// ===============================================================
+
+/**
+ * Pulls elements out of any iterator - directly, if it's a native one,
+ * and by calling its 'next' method otherwise.
+ */
+typedef struct SepIteration {
+	// the VM to call 'next' in
+	struct SepVM *vm;
+	// the native iterator, if there is one
+	SepIterator *native;
+	// the 'next' method, if there isn't
+	SepV next;
+} SepIteration;
+
+// Starts pulling elements from an iterator. Returns an exception if it has no
+// 'next' method, SEPV_NOTHING otherwise.
+SepV iteration_start(SepIteration *this, struct SepVM *vm, SepV iterator);
+// Returns the next element, SEPV_NO_VALUE if there are no more, or an exception.
+SepV iteration_next(SepIteration *this);
+
+/*****************************************************************/
+
+#endif
@@ -0,0 +1,397 @@
+/*****************************************************************
+ **
+ ** vm/maps.c
+ **
+ ** Implementation for September maps and sets.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <string.h>
+
+#include "mem.h"
+#include "gc.h"
+#include "exceptions.h"
+#include "bigints.h"
+#include "strings.h"
+#include "maps.h"
+#include "vm.h"
+
+#include "../vm/runtime.h"
+#include "../vm/support.h"
+
+// the string hash from strings.c, reused for big integers
+uint32_t cstring_hash(const char *chars, uint32_t length);
+
+// ===============================================================
+//  Hashing and comparing keys
+// ===============================================================
+
+/**
+ * A key being looked up, with everything we know about it.
+ */
+typedef struct MapKey {
+	// the key itself
+	SepV key;
+	// its hash
+	uint32_t hash;
+	// does it implement the hashing protocol?
+	bool custom;
+} MapKey;
+
+// Scrambles raw bits into a hash.
+static inline uint32_t hash_bits(uint64_t bits) {
+	uint64_t mixed = bits * 0x9E3779B97F4A7C15ULL;
+	return (uint32_t)(mixed >> 32) ^ (uint32_t)mixed;
+}
+
+// Checks if a float holds an integral value that fits in a SepV, and returns it if so.
+static inline bool float_as_int(SepFloat number, SepInt *integer) {
+	if ((number < (SepFloat)SEPV_INT_MIN) || (number > (SepFloat)SEPV_INT_MAX))
+		return false;
+	*integer = (SepInt)number;
+	return (SepFloat)*integer == number;
+}
+
+// Hashes a big integer by its digits.
+static uint32_t hash_bigint(SepBigInt *big) {
+	uint32_t hash = cstring_hash((const char*)big->digits, big->length * sizeof(BigDigit));
+	return big->negative ? ~hash : hash;
+}
+
+// Prepares a key for lookup, calculating its hash. Returns an exception if
+// the key's own 'hash' method fails.
+static SepV map_key(SepVM *vm, SepV key, MapKey *result) {
+	result->key = key;
+	result->custom = false;
+
+	if (sepv_is_int(key)) {
+		result->hash = hash_bits((uint64_t)sepv_to_int(key));
+	} else if (sepv_is_float(key)) {
+		// integral floats hash the same as the integers they're equal to
+		SepInt integer;
+		SepFloat number = sepv_to_float(key);
+		if (float_as_int(number, &integer))
+			result->hash = hash_bits((uint64_t)integer);
+		else
+			result->hash = hash_bits(key);
+	} else if (sepv_is_str(key)) {
+		result->hash = sepstr_hash(sepv_to_str(key));
+	} else if (sepv_is_bigint(key)) {
+		result->hash = hash_bigint(sepv_to_bigint(key));
+	} else if (sepv_is_obj(key) && property_exists(key, "hash")) {
+		SepV hash = call_method(vm, key, "hash", 0);
+			or_raise_sepv(hash);
+		if (sepv_is_int(hash))
+			result->hash = hash_bits((uint64_t)sepv_to_int(hash));
+		else if (sepv_is_bigint(hash))
+			result->hash = hash_bigint(sepv_to_bigint(hash));
+		else
+			raise_sepv(exc.EWrongType, "The hash() method has to return an integer.");
+		result->custom = true;
+	} else {
+		// everything else goes by identity
+		result->hash = hash_bits(key);
+	}
+	return SEPV_NOTHING;
+}
+
+// Checks whether a key stored in the map is equal to the key being looked up.
+// Returns SEPV_TRUE/SEPV_FALSE, or an exception if '==' fails.
+static SepV map_key_equals(SepVM *vm, MapKey *key, SepV stored) {
+	SepV looked_up = key->key;
+	if (looked_up == stored)
+		return SEPV_TRUE;
+
+	if (key->custom)
+		return call_method(vm, looked_up, "==", 1, stored);
+
+	// numbers are equal across types
+	SepInt integer;
+	if (sepv_is_int(looked_up) && sepv_is_float(stored))
+		return sepv_bool(float_as_int(sepv_to_float(stored), &integer) && (integer == sepv_to_int(looked_up)));
+	if (sepv_is_float(looked_up) && sepv_is_int(stored))
+		return sepv_bool(float_as_int(sepv_to_float(looked_up), &integer) && (integer == sepv_to_int(stored)));
+	if (sepv_is_float(looked_up) && sepv_is_float(stored))
+		return sepv_bool(sepv_to_float(looked_up) == sepv_to_float(stored));
+
+	// strings and big integers by content
+	if (sepv_is_str(looked_up) && sepv_is_str(stored))
+		return sepv_bool(sepstr_equals(sepv_to_str(looked_up), sepv_to_str(stored)));
+	if (sepv_is_bigint(looked_up) && sepv_is_bigint(stored))
+		return sepv_bool(bigint_compare(looked_up, stored) == 0);
+
+	return SEPV_FALSE;
+}
+
+// ===============================================================
+//  The hash table
+// ===============================================================
+
+#define SLOT_EMPTY 0
+#define slot_make(hash, entry) ((((uint64_t)(hash)) << 32) | ((uint64_t)(entry) + 1))
+#define slot_hash(slot) ((uint32_t)((slot) >> 32))
+#define slot_entry(slot) ((uint32_t)(slot) - 1)
+
+// The number of slots in the hash table.
+#define map_slot_count(map) ((map)->capacity * 2)
+
+// The capacity of newly created maps.
+#define MAP_INITIAL_CAPACITY 8
+
+/**
+ * Finds the slot holding a key. Returns SEPV_TRUE if found (with '*slot'
+ * set to its position), SEPV_FALSE if not (with '*slot' set to the empty
+ * slot where the key would go), or an exception if comparing keys failed.
+ */
+static SepV map_probe(SepMap *this, SepVM *vm, MapKey *key, uint32_t *slot) {
+	if (!this->capacity) {
+		*slot = 0;
+		return SEPV_FALSE;
+	}
+
+restart:;
+	uint32_t mask = map_slot_count(this) - 1;
+	uint32_t version = this->version;
+	uint32_t position = key->hash & mask;
+	while (this->slots[position] != SLOT_EMPTY) {
+		uint64_t contents = this->slots[position];
+		if (slot_hash(contents) == key->hash) {
+			SepV equal = map_key_equals(vm, key, this->entries[slot_entry(contents)].key);
+				or_raise_sepv(equal);
+			// '==' might have changed the map - if it did, we have to start over
+			if (this->version != version)
+				goto restart;
+			if (equal == SEPV_TRUE) {
+				*slot = position;
+				return SEPV_TRUE;
+			}
+		}
+		position = (position + 1) & mask;
+	}
+
+	*slot = position;
+	return SEPV_FALSE;
+}
+
+// Builds the hash table from scratch, using a given capacity and squeezing
+// out the holes left by removed entries. No keys are compared, the hashes
+// stored in the entries are used.
+static void map_rebuild(SepMap *this, uint32_t capacity) {
+	size_t entries_size = capacity * sizeof(MapEntry);
+	size_t slots_size = capacity * 2 * sizeof(uint64_t);
+	MapEntry *entries = mem_allocate(entries_size + slots_size);
+	uint64_t *slots = (uint64_t*)((char*)entries + entries_size);
+	memset(slots, 0, slots_size);
+
+	uint32_t index, count = 0, mask = capacity * 2 - 1;
+	for (index = 0; index < this->used; index++) {
+		MapEntry *entry = &this->entries[index];
+		if (entry->key == SEPV_NO_VALUE)
+			continue;
+
+		uint32_t position = entry->hash & mask;
+		while (slots[position] != SLOT_EMPTY)
+			position = (position + 1) & mask;
+		slots[position] = slot_make(entry->hash, count);
+		entries[count++] = *entry;
+	}
+
+	this->entries = entries;
+	this->slots = slots;
+	this->capacity = capacity;
+	this->used = count;
+	this->version++;
+}
+
+// Makes room for at least one more entry.
+static void map_make_room(SepMap *this) {
+	if (this->used < this->capacity)
+		return;
+
+	// if there are enough holes, squeezing them out is enough
+	uint32_t capacity = this->capacity ? this->capacity : MAP_INITIAL_CAPACITY;
+	while (this->count + 1 > capacity / 2)
+		capacity *= 2;
+	map_rebuild(this, capacity);
+}
+
+// Empties a slot, shifting the slots after it back to close the gap.
+static void map_free_slot(SepMap *this, uint32_t slot) {
+	uint32_t mask = map_slot_count(this) - 1;
+	uint32_t hole = slot, position = slot;
+	while (true) {
+		position = (position + 1) & mask;
+		uint64_t contents = this->slots[position];
+		if (contents == SLOT_EMPTY)
+			break;
+
+		// can this slot move back into the hole without getting
+		// in front of its home position?
+		uint32_t home = slot_hash(contents) & mask;
+		if (((position - home) & mask) >= ((position - hole) & mask)) {
+			this->slots[hole] = contents;
+			hole = position;
+		}
+	}
+	this->slots[hole] = SLOT_EMPTY;
+}
+
+// ===============================================================
+//  Maps - public
+// ===============================================================
+
+// Creates a new, empty map with a given prototype (Map, Set or a subclass).
+SepMap *map_create(SepV prototypes) {
+	static ObjectTraits MAP_TRAITS = {REPRESENTATION_MAP};
+
+	// allocate
+	SepMap *map = mem_allocate(sizeof(SepMap));
+
+	// prototypes and traits
+	map->base.prototypes = prototypes;
+	map->base.traits = MAP_TRAITS;
+
+	// make sure all unallocated pointers are NULL to make sure GC
+	// does not trip over some uninitialized pointers
+	map->entries = NULL;
+	map->slots = NULL;
+	map->base.data = NULL;
+	map->base.c3_order = NULL;
+	map->base.c3_version = 0;
+
+	// the table is only allocated once something is stored
+	map->count = map->used = map->capacity = 0;
+	map->version = 0;
+
+	// initialize property map (maps don't usually hold
+	// properties, so don't allocate anything until they do)
+	props_init_inline((PropertyMap*)map, NULL, 0);
+
+	// register as GC root to avoid collection
+	gc_register(obj_to_sepv(map));
+
+	return map;
+}
+
+// Gets the value stored under a key, or SEPV_NO_VALUE if there is none.
+SepV map_get(SepMap *this, SepVM *vm, SepV key) {
+	MapKey lookup;
+	uint32_t slot;
+	SepV err = map_key(vm, key, &lookup);
+		or_raise_sepv(err);
+	SepV found = map_probe(this, vm, &lookup, &slot);
+		or_raise_sepv(found);
+	if (found == SEPV_FALSE)
+		return SEPV_NO_VALUE;
+	return this->entries[slot_entry(this->slots[slot])].value;
+}
+
+// Stores a value under a key, replacing the old value if there is one. Returns the value.
+SepV map_put(SepMap *this, SepVM *vm, SepV key, SepV value) {
+	MapKey lookup;
+	uint32_t slot;
+	SepV err = map_key(vm, key, &lookup);
+		or_raise_sepv(err);
+
+	// make room first, so that the slot found stays valid
+	map_make_room(this);
+	SepV found = map_probe(this, vm, &lookup, &slot);
+		or_raise_sepv(found);
+	if (found == SEPV_TRUE) {
+		this->entries[slot_entry(this->slots[slot])].value = value;
+		return value;
+	}
+
+	// '==' could have filled the map up in the meantime
+	if (this->used == this->capacity) {
+		map_make_room(this);
+		found = map_probe(this, vm, &lookup, &slot);
+			or_raise_sepv(found);
+		if (found == SEPV_TRUE) {
+			this->entries[slot_entry(this->slots[slot])].value = value;
+			return value;
+		}
+	}
+
+	// new key
+	MapEntry *entry = &this->entries[this->used];
+	entry->key = key;
+	entry->value = value;
+	entry->hash = lookup.hash;
+	this->slots[slot] = slot_make(lookup.hash, this->used);
+	this->used++;
+	this->count++;
+	this->version++;
+	return value;
+}
+
+// Removes a key, returning the value that was stored or SEPV_NO_VALUE if there was none.
+SepV map_remove(SepMap *this, SepVM *vm, SepV key) {
+	MapKey lookup;
+	uint32_t slot;
+	SepV err = map_key(vm, key, &lookup);
+		or_raise_sepv(err);
+	SepV found = map_probe(this, vm, &lookup, &slot);
+		or_raise_sepv(found);
+	if (found == SEPV_FALSE)
+		return SEPV_NO_VALUE;
+
+	// leave a hole in the entries - it will be squeezed out later
+	uint32_t index = slot_entry(this->slots[slot]);
+	MapEntry *entry = &this->entries[index];
+	SepV value = entry->value;
+	entry->key = SEPV_NO_VALUE;
+	entry->value = SEPV_NOTHING;
+	map_free_slot(this, slot);
+	this->count--;
+	this->version++;
+
+	// holes at the end can be reused right away
+	while (this->used && (this->entries[this->used - 1].key == SEPV_NO_VALUE))
+		this->used--;
+
+	return value;
+}
+
+// Removes all keys.
+void map_clear(SepMap *this) {
+	if (this->capacity)
+		memset(this->slots, 0, map_slot_count(this) * sizeof(uint64_t));
+	this->count = this->used = 0;
+	this->version++;
+}
+
+// Gets the number of keys in the map.
+uint32_t map_count(SepMap *this) {
+	return this->count;
+}
+
+// ===============================================================
+//  Iteration
+// ===============================================================
+
+// Starts a new iteration over a map.
+SepMapIterator map_iterate_over(SepMap *this) {
+	SepMapIterator iterator = {this, 0};
+	return iterator;
+}
+
+// Returns true if we have iterated over all the entries.
+bool mapit_end(SepMapIterator *this) {
+	// skip the holes left by removed keys
+	SepMap *map = this->map;
+	while ((this->position < map->used) && (map->entries[this->position].key == SEPV_NO_VALUE))
+		this->position++;
+	return this->position >= map->used;
+}
+
+// Returns the current entry under the iterator and advances the iterator itself.
+MapEntry *mapit_next(SepMapIterator *this) {
+	return &this->map->entries[this->position++];
+}
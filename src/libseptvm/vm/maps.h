@@ -0,0 +1,126 @@
+#ifndef _SEP_MAPS_H
+#define _SEP_MAPS_H
+
+/*****************************************************************
+ **
+ ** vm/maps.h
+ **
+ ** Hash maps keyed by arbitrary September values, used to
+ ** implement both the Map and the Set classes.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "types.h"
+#include "objects.h"
+
+struct SepVM;
+
+// ===============================================================
+//  Maps
+// ===============================================================
+
+/**
+ * Keys are compared the same way '==' compares them for the built-in
+ * types - integers, floats and specials by value (with 1 and 1.0 being
+ * the same key), strings and big integers by their contents. Other
+ * objects are compared by identity, unless they implement the hashing
+ * protocol: a 'hash' method returning an integer, and '==' consistent
+ * with it. Looking up such keys calls back into September code.
+ *
+ * The entries are stored densely, in insertion order, which is also
+ * the order of iteration. The hash table itself is a separate array
+ * of slots using linear probing, each holding the index of an entry
+ * together with its hash. Removal shifts the following slots back
+ * instead of leaving tombstones, and leaves a hole in the entries
+ * that is squeezed out the next time the map grows.
+ */
+typedef struct MapEntry {
+	// the key, or SEPV_NO_VALUE if the entry was removed
+	SepV key;
+	// the value (always SEPV_NOTHING in sets)
+	SepV value;
+	// the hash of the key
+	uint32_t hash;
+} MapEntry;
+
+/**
+ * Like arrays, maps are an extension of September objects.
+ */
+typedef struct SepMap {
+	// the SepObj base struct
+	SepObj base;
+	// the entries in insertion order - followed by the slots of the
+	// hash table, all in a single allocation
+	MapEntry *entries;
+	// the hash table - each slot is (hash << 32) | (entry index + 1),
+	// with 0 marking empty slots
+	uint64_t *slots;
+	// the number of keys in the map
+	uint32_t count;
+	// the number of entries used up, including the holes left by removals
+	uint32_t used;
+	// the number of entries there is room for - the hash table has
+	// twice as many slots
+	uint32_t capacity;
+	// bumped whenever keys are added or removed, so that lookups calling
+	// into September code can notice that the map changed under them
+	uint32_t version;
+} SepMap;
+
+#define obj_is_map(obj) (((SepObj*)(obj))->traits.representation == REPRESENTATION_MAP)
+#define sepv_is_map(val) (sepv_is_obj(val) && obj_is_map(sepv_to_obj(val)))
+#define sepv_to_map(val) ((SepMap*)(sepv_to_obj(val)))
+
+/**
+ * All operations that look keys up can call into September code when
+ * keys implement the hashing protocol, so they take a VM and return
+ * SepVs that can be exceptions.
+ */
+
+// Creates a new, empty map with a given prototype (Map, Set or a subclass).
+SepMap *map_create(SepV prototypes);
+// Gets the value stored under a key, or SEPV_NO_VALUE if there is none.
+SepV map_get(SepMap *this, struct SepVM *vm, SepV key);
+// Stores a value under a key, replacing the old value if there is one. Returns the value.
+SepV map_put(SepMap *this, struct SepVM *vm, SepV key, SepV value);
+// Removes a key, returning the value that was stored or SEPV_NO_VALUE if there was none.
+SepV map_remove(SepMap *this, struct SepVM *vm, SepV key);
+// Removes all keys.
+void map_clear(SepMap *this);
+// Gets the number of keys in the map.
+uint32_t map_count(SepMap *this);
+
+// ===============================================================
+//  Iteration
+// ===============================================================
+
+/**
+ * Iterators visit the keys in insertion order. Changing the map while
+ * iterating over it is safe, but the iteration might then skip or
+ * repeat some keys.
+ */
+typedef struct SepMapIterator {
+	// the map we're iterating over
+	SepMap *map;
+	// the index of the next entry to visit
+	uint32_t position;
+} SepMapIterator;
+
+// Starts a new iteration over a map.
+SepMapIterator map_iterate_over(SepMap *this);
+// Returns true if we have iterated over all the entries.
+bool mapit_end(SepMapIterator *this);
+// Returns the current entry under the iterator and advances the iterator itself.
+MapEntry *mapit_next(SepMapIterator *this);
+
+/*****************************************************************/
+
+#endif
@@ -287,8 +287,9 @@ void *mem_allocate(size_t bytes) {
 	if (manager->total_allocated_bytes > manager->allocation_limit_before_next_gc)
 		gc_perform_full_gc();
 
-	// handle outsize allocations (bigger than chunk_size)
-	bool outsize = bytes > manager->chunk_size;
+	// handle outsize allocations (too big for even a fresh chunk, which loses
+	// one unit to the free list head and another to the block header)
+	bool outsize = bytes > manager->chunk_size - 2 * ALLOCATION_UNIT;
 	if (outsize) {
 		#ifdef SEP_GC_STRESS_TEST
 			gc_perform_full_gc();
@@ -87,6 +87,9 @@ void _cpool_resize(ConstantPool *this, uint32_t new_data_size) {
 		if (sepv_is_str(sepvs[index])) {
 			// move the shifted pointer inside the SepV by 'offset' bytes
 			sepvs[index] += (offset >> 3);
+			// the string's pointer to its own contents has to move too
+			SepString *string = sepv_to_str(sepvs[index]);
+			string->cstr = string->content;
 		}
 	}
 
@@ -178,11 +181,19 @@ SepV cpool_add_int(ConstantPool *this, SepInt integer) {
 	return sepvs[this->constant_count++] = int_to_sepv(integer);
 }
 
+// Adds a new float constant at the next index.
+SepV cpool_add_float(ConstantPool *this, SepFloat number) {
+	log("cpool", "Adding constant %d: %g", this->constant_count, number);
+
+	SepV *sepvs = (SepV*)this->data;
+	return sepvs[this->constant_count++] = float_to_sepv(number);
+}
+
 // Fetches a constant under a given 'index' from the pool.
 // Indices start from 1, since this is the format used in bytecode.
 SepV cpool_constant(ConstantPool *this, uint32_t index) {
 	if ((index < 1) || (index > this->max_constants))
-		return sepv_exception(exc.EInternal, sepstr_sprintf("Constant index %d out of bounds.", index));
+		return sepv_exceptionf(exc.EInternal, "Constant index %d out of bounds.", index);
 	return ((SepV*)this->data)[index-1];
 }
 
@@ -270,6 +281,7 @@ CodeBlock *bpool_start_block(BlockPool *this, int parameter_count) {
 	block->parameter_count = parameter_count;
 	block->instructions = (CodeUnit*)(this->position);
 	block->parameters = (FuncParam*)(this->position - parameters_size);
+	block->lines = NULL;
 
 	// remember it
 	this->current_block = block;
@@ -290,6 +302,26 @@ void bpool_write_code(BlockPool *this, CodeUnit code) {
 	this->position += sizeof(CodeUnit);
 }
 
+// Returns the position the next code unit will be written at, counted in code
+// units from the start of the current block.
+uint32_t bpool_code_position(BlockPool *this) {
+	assert(this->current_block);
+	return (CodeUnit*)this->position - this->current_block->instructions;
+}
+
+// Overwrites a code unit previously written to the current block.
+void bpool_patch_code(BlockPool *this, uint32_t position, CodeUnit code) {
+	assert(this->current_block);
+	this->current_block->instructions[position] = code;
+}
+
+// Attaches a line table (allocated from unmanaged memory) to the current
+// block, which takes ownership of it.
+void bpool_attach_lines(BlockPool *this, LineTable *lines) {
+	assert(this->current_block);
+	this->current_block->lines = lines;
+}
+
 // Terminates the current block and returns its index.
 uint32_t bpool_end_block(BlockPool *this) {
 	assert(this->current_block);
@@ -332,10 +364,36 @@ CodeBlock *bpool_block(BlockPool *this, uint32_t index) {
 	return this->block_index[index-1];
 }
 
+// Returns the source line the code at a given offset in a block comes from,
+// or 0 if there is no way to tell.
+uint32_t codeblock_line(CodeBlock *block, uint32_t offset) {
+	LineTable *table = block->lines;
+	if (!table || !table->count || (offset < table->entries[0].offset))
+		return 0;
+
+	// find the last entry starting at or before the offset
+	uint32_t low = 0, high = table->count;
+	while (high - low > 1) {
+		uint32_t middle = (low + high) / 2;
+		if (table->entries[middle].offset <= offset)
+			low = middle;
+		else
+			high = middle;
+	}
+	return table->entries[low].line;
+}
+
 // Frees a block pool.
 void bpool_free(BlockPool *this) {
 	if (!this) return;
 
+	// line tables are allocated separately
+	int i;
+	for (i = 0; this->block_index && (i < this->total_blocks); i++) {
+		if (this->block_index[i]->lines)
+			mem_unmanaged_free(this->block_index[i]->lines);
+	}
+
 	mem_unmanaged_free(this->memory);
 	mem_unmanaged_free(this);
 }
@@ -99,6 +99,8 @@ ConstantPool *cpool_create(uint32_t num_constants);
 SepV cpool_add_string(ConstantPool *this, const char *c_string);
 // Adds a new integer constant at the next index.
 SepV cpool_add_int(ConstantPool *this, SepInt index);
+// Adds a new float constant at the next index.
+SepV cpool_add_float(ConstantPool *this, SepFloat number);
 // Fetches a constant under a given 'index' from the pool.
 SepV cpool_constant(ConstantPool *this, uint32_t index);
 
@@ -142,6 +144,14 @@ CodeBlock *bpool_start_block(BlockPool *this, int parameter_count);
 // Writes a single operation or its argument to the current block's
 // instruction stream.
 void bpool_write_code(BlockPool *this, CodeUnit code);
+// Returns the position the next code unit will be written at, counted in code
+// units from the start of the current block.
+uint32_t bpool_code_position(BlockPool *this);
+// Overwrites a code unit previously written to the current block.
+void bpool_patch_code(BlockPool *this, uint32_t position, CodeUnit code);
+// Attaches a line table (allocated from unmanaged memory) to the current
+// block, which takes ownership of it.
+void bpool_attach_lines(BlockPool *this, LineTable *lines);
 // Terminates the current block and returns its index.
 uint32_t bpool_end_block(BlockPool *this);
 // Seals the pool - no more blocks can be added after this point.
@@ -17,6 +17,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "types.h"
 #include "mem.h"
@@ -141,108 +144,249 @@ SlotType st_prototype_list = {SF_NOTHING_SPECIAL, &prototypes_retrieve, &prototy
 //  Property maps - private implementation
 // ===============================================================
 
-void _props_resize(PropertyMap *this, int new_capacity);
+// The number of control bytes compared at once.
+#define PROPS_GROUP_SIZE 16
+// The control byte marking an unused position - all the others hold
+// 7-bit hash fragments, so they never have the top bit set.
+#define PROPS_EMPTY 0x80
+
+// The 7-bit fragment of a hash stored in the control bytes, and the
+// remaining bits used to select the group to start probing from.
+#define hash_fragment(hash) ((uint8_t)((hash) & 0x7F))
+#define hash_group(hash) ((hash) >> 7)
+
+// The hash table is the smallest power of 2 that keeps it at most 7/8 full
+// when all the entries are used up.
+static inline uint32_t _props_table_bits(uint32_t capacity) {
+	uint32_t needed = capacity + capacity / 7;
+	return (needed <= 1) ? 0 : (32 - __builtin_clz(needed - 1));
+}
+// Small tables are padded with empty control bytes to a full group.
+#define props_control_size(this) (((this)->table_bits < 4) ? PROPS_GROUP_SIZE : (1u << (this)->table_bits))
+
+// Control bytes follow the entries, and the indices follow the control bytes.
+#define props_control(this) ((uint8_t*)((this)->entries + (this)->capacity))
+#define props_indices(this) ((uint32_t*)(props_control(this) + props_control_size(this)))
+
+// Returns a bit mask with bit N set if the N-th byte of the group is
+// equal to 'byte'.
+static inline uint32_t _props_group_match(uint8_t *group, uint8_t byte) {
+#ifdef __SSE2__
+	__m128i control = _mm_loadu_si128((__m128i*)group);
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+	// no SIMD available - compare 8 bytes at a time inside a 64-bit word
+	const uint64_t LOW_BITS = 0x7F7F7F7F7F7F7F7FULL, HIGH_BITS = 0x8080808080808080ULL;
+	uint32_t mask = 0;
+	int half;
+	for (half = 0; half < 2; half++) {
+		uint64_t word;
+		memcpy(&word, group + half * 8, 8);
+		// bytes equal to 'byte' become zeroes, then get their top bit set
+		word ^= 0x0101010101010101ULL * byte;
+		uint64_t zeroes = ~(((word & LOW_BITS) + LOW_BITS) | word) & HIGH_BITS;
+		// gather the top bits of all bytes into the lowest byte
+		mask |= (uint32_t)(((zeroes >> 7) * 0x0102040810204080ULL) >> 56) << (half * 8);
+	}
+	return mask;
+#endif
+}
+
+// Returns a bit mask with bit N set if the N-th position in the group is
+// empty. PROPS_EMPTY is the only control byte with the top bit set, so
+// that's the only bit we have to look at.
+static inline uint32_t _props_group_empty(uint8_t *group) {
+#ifdef __SSE2__
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((__m128i*)group));
+#else
+	uint32_t mask = 0;
+	int half;
+	for (half = 0; half < 2; half++) {
+		uint64_t word;
+		memcpy(&word, group + half * 8, 8);
+		word &= 0x8080808080808080ULL;
+		mask |= (uint32_t)(((word >> 7) * 0x0102040810204080ULL) >> 56) << (half * 8);
+	}
+	return mask;
+#endif
+}
+
+/**
+ * Walks the probe sequence for a hash, calling 'matches' for each entry
+ * whose hash fragment is right. Returns the first entry that matches, or
+ * NULL if there is none - in which case the position the entry should
+ * be inserted at is stored in 'free_position' (if it's not NULL).
+ */
+static inline PropertyEntry *_props_probe(PropertyMap *this, uint32_t hash,
+		bool (*matches)(PropertyEntry *entry, const void *key, uint32_t length),
+		const void *key, uint32_t length, uint32_t *free_position) {
+	uint8_t *control = props_control(this);
+	uint32_t *indices = props_indices(this);
+
+	// groups are aligned, small tables have just one
+	uint32_t group_mask = ((1u << this->table_bits) - 1) / PROPS_GROUP_SIZE;
+	uint32_t group = hash_group(hash) & group_mask, step = 0;
+	while (true) {
+		uint8_t *group_control = control + group * PROPS_GROUP_SIZE;
+
+		// compare the keys only where the hash fragments match
+		uint32_t candidates = _props_group_match(group_control, hash_fragment(hash));
+		while (candidates) {
+			PropertyEntry *entry = &this->entries[indices[group * PROPS_GROUP_SIZE + __builtin_ctz(candidates)]];
+			if (matches(entry, key, length))
+				return entry;
+			candidates &= candidates - 1;
+		}
 
-PropertyEntry *_props_find_entry(PropertyMap *this, SepString *name,
-		PropertyEntry **previous) {
-	// find the correct first entry for the bucket
-	uint32_t index = sepstr_hash(name) % this->capacity;
-	PropertyEntry *entry = &this->entries[index];
+		// an empty position in the group means the entry isn't here - this
+		// is only checked after the keys, since hits never need it
+		uint32_t empty = _props_group_empty(group_control);
+		if (empty) {
+			if (free_position)
+				*free_position = group * PROPS_GROUP_SIZE + __builtin_ctz(empty);
+			return NULL;
+		}
 
-	// is this the right bucket (empty or containing the named prop?)
-	if ((!entry->name) || (!sepstr_cmp(entry->name, name))) {
-		*previous = NULL;
-		return entry;
+		// triangular probing visits every group eventually
+		group = (group + ++step) & group_mask;
 	}
+}
 
-	// look through the linked list
-	while (entry->next_entry) {
-		*previous = entry;
-		entry = &this->entries[entry->next_entry];
-		if (!sepstr_cmp(entry->name, name))
+// Matchers for _props_probe(), comparing names as SepStrings or C strings.
+// Both names have their hashes cached by the time they're compared as
+// SepStrings, so the hashes can tell different names apart right away.
+static inline bool _props_name_matches(PropertyEntry *entry, const void *name, uint32_t length) {
+	SepString *entry_name = entry->name, *other = (SepString*)name;
+	if (entry_name == other)
+		return true;
+	return (entry_name->hash == other->hash) && (entry_name->length == other->length)
+			&& !memcmp(entry_name->cstr, other->cstr, other->length);
+}
+static inline bool _props_cstr_matches(PropertyEntry *entry, const void *name, uint32_t length) {
+	return (entry->name->length == length) && (!memcmp(entry->name->cstr, name, length));
+}
+static inline bool _props_never_matches(PropertyEntry *entry, const void *name, uint32_t length) {
+	return false;
+}
+
+// Finds an entry in inline storage. The names are usually interned, so
+// a pass comparing just the pointers almost always finds the entry, and
+// the actual strings only have to be compared for misses.
+PropertyEntry *_props_find_inline(PropertyMap *this, SepString *name) {
+	PropertyEntry *entry, *end = this->entries + this->count;
+	for (entry = this->entries; entry < end; entry++)
+		if (entry->name == name)
 			return entry;
-	}
+	for (entry = this->entries; entry < end; entry++)
+		if ((entry->name->length == name->length) && sepstr_equals(entry->name, name))
+			return entry;
+	return NULL;
+}
 
-	// return an empty overflow entry
-	*previous = entry;
-	return &this->entries[this->overflow];
+// Finds the entry for a given property, or returns NULL if it isn't present.
+// For maps with a hash table, the position at which the property should be
+// inserted is also stored in 'free_position' (if it's not NULL).
+static inline PropertyEntry *_props_find_entry(PropertyMap *this, SepString *name, uint32_t *free_position) {
+	if (this->inline_storage)
+		return _props_find_inline(this, name);
+
+	// (this also guarantees the hash is cached for _props_name_matches())
+	uint32_t hash = name->hash ? name->hash : sepstr_hash(name);
+	return _props_probe(this, hash, &_props_name_matches, name, 0, free_position);
+}
+
+// Puts the entry with a given index into the hash table.
+static inline void _props_index_entry(PropertyMap *this, uint32_t position, uint32_t index) {
+	props_control(this)[position] = hash_fragment(sepstr_hash(this->entries[index].name));
+	props_indices(this)[position] = index;
+}
+
+// Allocates the table for a given capacity, with all the control bytes empty.
+void _props_allocate(PropertyMap *this, uint32_t capacity) {
+	uint32_t table_bits = _props_table_bits(capacity);
+	size_t entry_bytes = sizeof(PropertyEntry) * capacity;
+	size_t control_bytes = (table_bits < 4) ? PROPS_GROUP_SIZE : (1u << table_bits);
+	size_t index_bytes = sizeof(uint32_t) << table_bits;
+
+	PropertyEntry *entries = mem_allocate(entry_bytes + control_bytes + index_bytes);
+	this->capacity = capacity;
+	this->table_bits = table_bits;
+	this->inline_storage = false;
+	this->entries = entries;
+	memset(props_control(this), PROPS_EMPTY, control_bytes);
+}
+
+// Moves the whole property map to a new table with a given capacity.
+void _props_resize(PropertyMap *this, uint32_t new_capacity) {
+	// the entries keep their order, so they can be moved wholesale
+	PropertyEntry *old_entries = this->entries;
+	_props_allocate(this, new_capacity);
+	memcpy(this->entries, old_entries, sizeof(PropertyEntry) * this->count);
+
+	// only the hash table has to be rebuilt - the names are known to be
+	// unique, so there's no need to compare them
+	uint32_t index, position;
+	for (index = 0; index < this->count; index++) {
+		_props_probe(this, sepstr_hash(this->entries[index].name), &_props_never_matches, NULL, 0, &position);
+		_props_index_entry(this, position, index);
+	}
 }
 
 // Internal implementation for accepting a new property.
-Slot *_props_accept_prop_internal(void *map, SepString *name, Slot *slot, bool allow_resizing) {
+Slot *_props_accept_prop_internal(void *map, SepString *name, Slot *slot) {
 	PropertyMap *this = (PropertyMap*) map;
-	PropertyEntry *prev, *entry = _props_find_entry(this, name, &prev);
+	uint32_t free_position;
+	PropertyEntry *entry = _props_find_entry(this, name, &free_position);
 
 	// is it already here?
-	if (entry->name) {
+	if (entry) {
 		// yes, simply reassign the slot
 		entry->slot = *slot;
 		return &entry->slot;
-	} else {
-		// no, this is an empty entry to be filled
-		entry->name = name;
-		entry->next_entry = 0;
-		entry->slot = *slot;
+	}
 
-		// calculate the index from pointers
-		uint32_t index = entry - this->entries;
-
-		// link up with the previous entry in bucket if there is one
-		if (prev)
-			prev->next_entry = index;
-
-		// did we use up overflow space?
-		if (index == this->overflow) {
-			this->overflow++;
-
-			// is property map resize stress testing turned on?
-			#ifdef SEP_PROPMAP_STRESS_TEST
-				// simulate resize by resizing to the same size
-				if (allow_resizing)
-					_props_resize(this, this->capacity);
-			#endif
-
-			// did we run out of overflow space?
-			if (this->overflow == this->capacity * 2) {
-				// yes- we'd like to resize
-				if (allow_resizing) {
-					_props_resize(this, (int)(this->capacity * PROPERTY_MAP_GROWTH_FACTOR) + 1);
-				} else {
-					return NULL; // resizing disallowed
-				}
-			}
+	// a new property might shadow the results of cached lookups going
+	// through this object (and might move its slots around)
+	if (((SepObj*)this)->traits.cached_prototype)
+		(*lsvm_globals.property_cache_version)++;
+
+	if (this->inline_storage) {
+		// inline entries are appended with no further ado while they last
+		if (this->count < this->capacity) {
+			entry = &this->entries[this->count++];
+			entry->name = name;
+			entry->slot = *slot;
+			return &entry->slot;
 		}
 
-		// find the slot again, it might have moved due to resizing
-		return props_find_prop(this, name);
+		// out of room, move everything to a hash table - the name is not
+		// in the map yet, so it has to be protected from collection
+		gc_register(str_to_sepv(name));
+		_props_resize(this, (uint32_t)(this->capacity * PROPERTY_MAP_GROWTH_FACTOR) + 1);
+		_props_find_entry(this, name, &free_position);
 	}
-}
 
-// Resize the entire property map to a bigger size
-void _props_resize(PropertyMap *this, int new_capacity) {
-	// allocate a temporary map to handle the transfer
-	PropertyMap temp;
-	props_init(&temp, new_capacity);
-
-	// reinsert existing entries into the temporary table
-	// NO ALLOCATIONS are allowed during this process, as it could
-	// cause the 'temp.entries' table to be freed before its copied
-	// to 'this->entries'.
-	PropertyIterator it = props_iterate_over(this);
-	while (!propit_end(&it)) {
-		bool accepted = _props_accept_prop_internal(&temp, propit_name(&it), propit_slot(&it), false);
-		if (!accepted) {
-			// abort mission - we have to try an even bigger size
-			_props_resize(this, new_capacity * PROPERTY_MAP_GROWTH_FACTOR + 1);
-			return;
-		}
-		propit_next(&it);
+	// no - append the entry and hash it (there is always room for one more)
+	uint32_t index = this->count++;
+	entry = &this->entries[index];
+	entry->name = name;
+	entry->slot = *slot;
+	_props_index_entry(this, free_position, index);
+
+	// grow once full - only after the new entry is in, so that the name is
+	// reachable if the allocation triggers a collection
+	if (this->count == this->capacity) {
+		_props_resize(this, (uint32_t)(this->capacity * PROPERTY_MAP_GROWTH_FACTOR) + 1);
+	} else {
+		// is property map resize stress testing turned on?
+		#ifdef SEP_PROPMAP_STRESS_TEST
+			// simulate resize by resizing to the same size
+			_props_resize(this, this->capacity);
+		#endif
 	}
 
-	// copy data from temporary map to here, taking over the "entries" table
-	this->overflow = temp.overflow;
-	this->capacity = temp.capacity;
-	this->entries = temp.entries;
+	// the entries keep their indices when the map is resized
+	return &this->entries[index].slot;
 }
 
 // ===============================================================
@@ -253,27 +397,25 @@ void _props_resize(PropertyMap *this, int new_capacity) {
 void props_init(void *map, int initial_capacity) {
 	PropertyMap *this = (PropertyMap*) map;
 
-	// initial number of entries
-	this->capacity = initial_capacity;
-
-	// the number of entries are double the capacity
-	// first half is for the core table (first entry in each bucket)
-	// second half is for nodes in the linked list used for in-bucket
-	// collisions
-	size_t bytes = sizeof(PropertyEntry) * initial_capacity * 2;
-	this->entries = mem_allocate(bytes);
-
-	// the first overflow entry will be at the beginning of second half
-	this->overflow = initial_capacity;
+	// the table is allocated with all the control bytes marked as empty
+	this->count = 0;
+	_props_allocate(this, initial_capacity > 1 ? initial_capacity : 1);
+}
 
-	// zero the memory so that we can recognize each entry as empty
-	memset(this->entries, 0, bytes);
+// Initializes an empty property map using inline entries.
+void props_init_inline(void *map, PropertyEntry *storage, int capacity) {
+	PropertyMap *this = (PropertyMap*) map;
+	this->capacity = capacity;
+	this->table_bits = 0;
+	this->inline_storage = true;
+	this->count = 0;
+	this->entries = storage;
 }
 
 // Adds an existing slot to the map.
 Slot *props_accept_prop(void *map, SepString *name, Slot *slot) {
 	// delegate to the internal version
-	return _props_accept_prop_internal(map, name, slot, true);
+	return _props_accept_prop_internal(map, name, slot);
 }
 
 // Adds a new property to the map and returns the new slot stored
@@ -282,13 +424,13 @@ Slot *props_accept_prop(void *map, SepString *name, Slot *slot) {
 Slot *props_add_prop(void *map, SepString *name, SlotType *slot_type, SepV initial_value) {
 	Slot source_slot;
 	slot_init(&source_slot, slot_type, initial_value);
-	return _props_accept_prop_internal(map, name, &source_slot, true);
+	return _props_accept_prop_internal(map, name, &source_slot);
 }
 
 SepV props_get_prop(void *map, SepString *name) {
 	PropertyMap *this = (PropertyMap*) map;
-	PropertyEntry *prev, *entry = _props_find_entry(this, name, &prev);
-	if (entry->name) {
+	PropertyEntry *entry = _props_find_entry(this, name, NULL);
+	if (entry) {
 		SepV host = obj_to_sepv((SepObj*)this);
 		OriginInfo origin = {host, host, name};
 		return slot_retrieve(&entry->slot, &origin);
@@ -300,8 +442,8 @@ SepV props_get_prop(void *map, SepString *name) {
 // Finds the slot corresponding to a named property.
 Slot *props_find_prop(void *map, SepString *name) {
 	PropertyMap *this = (PropertyMap*) map;
-	PropertyEntry *prev, *entry = _props_find_entry(this, name, &prev);
-	if (entry->name)
+	PropertyEntry *entry = _props_find_entry(this, name, NULL);
+	if (entry)
 		return &entry->slot;
 	else
 		return NULL;
@@ -309,8 +451,8 @@ Slot *props_find_prop(void *map, SepString *name) {
 
 SepV props_set_prop(void *map, SepString *name, SepV value) {
 	PropertyMap *this = (PropertyMap*) map;
-	PropertyEntry *prev, *entry = _props_find_entry(this, name, &prev);
-	if (entry->name) {
+	PropertyEntry *entry = _props_find_entry(this, name, NULL);
+	if (entry) {
 		SepV host = obj_to_sepv((SepObj*)this);
 		OriginInfo origin = {host, host, name};
 		return slot_store(&entry->slot, &origin, value);
@@ -321,8 +463,7 @@ SepV props_set_prop(void *map, SepString *name, SepV value) {
 
 bool props_prop_exists(void *map, SepString *name) {
 	PropertyMap *this = (PropertyMap*) map;
-	PropertyEntry *prev, *entry = _props_find_entry(this, name, &prev);
-	return (bool) (entry->name);
+	return _props_find_entry(this, name, NULL) != NULL;
 }
 
 void props_add_field(void *map, const char *name, SepV value) {
@@ -333,26 +474,16 @@ void props_add_field(void *map, const char *name, SepV value) {
 
 // Finds the hash table entry based on a raw hash and key string. Low-level
 // functionality, mostly useful for the string cache.
-PropertyEntry *props_find_entry_raw(void *map, const char *name, uint32_t hash) {
+PropertyEntry *props_find_entry_raw(void *map, const char *name, uint32_t length, uint32_t hash) {
 	PropertyMap *this = (PropertyMap*)map;
-	// find the correct first entry for the bucket
-	uint32_t index = hash % this->capacity;
-	PropertyEntry *entry = &this->entries[index];
-
-	// is this the right bucket (empty or containing the named prop?)
-	if ((entry->name) && (!strcmp(entry->name->cstr, name))) {
-		return entry;
-	}
-
-	// look through the linked list
-	while (entry->next_entry) {
-		entry = &this->entries[entry->next_entry];
-		if (!strcmp(entry->name->cstr, name))
-			return entry;
+	if (this->inline_storage) {
+		PropertyEntry *entry, *end = this->entries + this->count;
+		for (entry = this->entries; entry < end; entry++)
+			if (_props_cstr_matches(entry, name, length))
+				return entry;
+		return NULL;
 	}
-
-	// nothing found
-	return NULL;
+	return _props_probe(this, hash, &_props_cstr_matches, name, length, NULL);
 }
 
 
@@ -363,21 +494,17 @@ PropertyEntry *props_find_entry_raw(void *map, const char *name, uint32_t hash)
 // Starts a new iteration over all the properties.
 PropertyIterator props_iterate_over(void *map) {
 	PropertyMap *this = (PropertyMap*) map;
-	PropertyIterator it = { this, this->entries - 1 };
-	propit_next(&it);
+	PropertyIterator it = { this, this->entries };
 	return it;
 }
 // Move to the next property.
 void propit_next(PropertyIterator *current) {
-	PropertyEntry *end = current->map->entries + (current->map->overflow);
 	current->entry++;
-	while ((current->entry < end) && (!current->entry->name))
-		current->entry++;
 }
 // Check if the iterator reached the end. If this is true,
 // no other iterator methods can be called.
 bool propit_end(PropertyIterator *current) {
-	return (current->entry - current->map->entries) >= (current->map->overflow);
+	return (current->entry - current->map->entries) >= (current->map->count);
 }
 // The name of the current property.
 SepString *propit_name(PropertyIterator *current) {
@@ -409,7 +536,8 @@ SepV propit_value(PropertyIterator *current) {
 SepObj *obj_create() {
 	static ObjectTraits DEFAULT_TRAITS = { REPRESENTATION_SIMPLE };
 
-	SepObj *obj = mem_allocate(sizeof(SepObj));
+	// the inline property entries are allocated together with the object
+	SepObj *obj = mem_allocate(sizeof(SepObj) + PROPS_INLINE_CAPACITY * sizeof(PropertyEntry));
 
 	// set up default values
 	obj->traits = DEFAULT_TRAITS;
@@ -419,14 +547,15 @@ SepObj *obj_create() {
 	// tripping over uninitialized pointers and going berserk on
 	// random memory
 	obj->data = NULL;
-	obj->props.entries = NULL;
+	obj->c3_order = NULL;
+	obj->c3_version = 0;
+
+	// initialize property map with the entries right after the object
+	props_init_inline((PropertyMap*) obj, (PropertyEntry*)(obj + 1), PROPS_INLINE_CAPACITY);
 
 	// register in as a GC root in the current frame to prevent accidental freeing
 	gc_register(obj_to_sepv(obj));
 
-	// initialize property map (possible allocation here, so perform as late as possible)
-	props_init((PropertyMap*) obj, 2);
-
 	return obj;
 }
 
@@ -442,6 +571,8 @@ SepObj *obj_create_with_proto(SepV proto) {
 void obj_set_prototypes(SepObj *this, SepV prototypes) {
 	this->prototypes = prototypes;
 	c3_invalidate_cache(obj_to_sepv(this));
+	if (this->traits.cached_prototype)
+		(*lsvm_globals.property_cache_version)++;
 }
 
 // Shortcut to quickly create a SepItem with a given object as r-value.
@@ -450,6 +581,23 @@ SepItem si_obj(void *object) {
 }
 
 
+// ===============================================================
+//  Global lookup cache
+// ===============================================================
+
+// Finds the only entry of the cache that can hold the given key.
+static inline LookupCacheEntry *_lookup_cache_entry(SepV prototype, SepString *property) {
+	uint64_t key = (prototype ^ ((uint64_t)(intptr_t)property << 16)) * 0x9E3779B97F4A7C15ULL;
+	return &lsvm_globals.lookup_cache->entries[(key >> 32) & (LOOKUP_CACHE_SIZE - 1)];
+}
+
+// The version the entries have to match to be valid. Both the property cache
+// version and the collection count only ever grow, so their sum changes
+// whenever any of them does.
+static inline uint64_t _lookup_cache_version() {
+	return *lsvm_globals.property_cache_version + lsvm_globals.lookup_cache->collections;
+}
+
 // ===============================================================
 //  Object-like behavior for all types
 // ===============================================================
@@ -468,6 +616,9 @@ SepV sepv_prototypes(SepV sepv) {
 	case SEPV_TYPE_INT:
 		return obj_to_sepv(rt.Integer);
 
+	case SEPV_TYPE_FLOAT:
+		return obj_to_sepv(rt.Float);
+
 	case SEPV_TYPE_STRING:
 		return obj_to_sepv(rt.String);
 
@@ -509,62 +660,85 @@ Slot *sepv_local_lookup(SepV sepv, SepString *property, SepV *owner_ptr) {
 	return NULL;
 }
 
-// Finds a property starting from a given object, taking prototypes
-// into consideration. Returns NULL if nothing found.
-// If the 'owner_ptr' is non-NULL, it will also write the actual
-// 'owner' of the slot (i.e. the prototype in which the property
-// was finally found) into the memory being pointed to.
-Slot *sepv_lookup(SepV sepv, SepString *property, SepV *owner_ptr, SepV *error) {
-	SepV err = SEPV_NO_VALUE;
+Slot *_sepv_lookup_internal(SepV sepv, SepString *property, SepV *owner_ptr, SepV *error, bool as_prototype);
 
-	// handle the LiteralScope in a special way
-	if (sepv == SEPV_LITERALS) {
-		// return the property name itself, wrapped in a fake slot
-		*owner_ptr = SEPV_NO_VALUE;
-		return slot_create(&st_field, str_to_sepv(property));
+// Finds a property in a single prototype and everything it inherits
+// from, consulting the global lookup cache first.
+Slot *_sepv_cached_lookup(SepV prototype, SepString *property, SepV *owner_ptr, SepV *error) {
+	uint64_t version = _lookup_cache_version();
+	LookupCacheEntry *entry = _lookup_cache_entry(prototype, property);
+	if ((entry->prototype == prototype) && (entry->property == property) && (entry->version == version)) {
+		if (owner_ptr)
+			*owner_ptr = entry->owner;
+		return entry->slot;
 	}
 
+	// a miss, do the full lookup and remember the result (the version
+	// is from before the lookup, so any changes it causes will make the
+	// entry stale)
+	SepV owner;
+	Slot *slot = _sepv_lookup_internal(prototype, property, &owner, error, true);
+	if (!slot)
+		return NULL;
+	entry->prototype = prototype;
+	entry->property = property;
+	entry->version = version;
+	entry->owner = owner;
+	entry->slot = slot;
+
+	if (owner_ptr)
+		*owner_ptr = owner;
+	return slot;
+}
+
+// Marks an object as searched during a cached lookup, so that it can
+// invalidate the cache once it changes.
+static inline void _mark_cached_prototype(SepV sepv) {
+	if (sepv_is_obj(sepv))
+		sepv_to_obj(sepv)->traits.cached_prototype = true;
+}
+
+// Implements the lookup procedure. When 'as_prototype' is set, the
+// object is searched as a part of a cached lookup.
+Slot *_sepv_lookup_internal(SepV sepv, SepString *property, SepV *owner_ptr, SepV *error, bool as_prototype) {
+	SepV err = SEPV_NO_VALUE;
+
 	// check locally first
+	if (as_prototype)
+		_mark_cached_prototype(sepv);
 	Slot *local_slot = sepv_local_lookup(sepv, property, owner_ptr);
 	if (local_slot)
 		return local_slot;
 
 	// check 'syntax' object next if we are an execution scope
-	ExecutionFrame *current_frame = vm_current_frame();
-	if (rt.syntax && current_frame && (current_frame->locals == sepv)) {
-		Slot *syntax_slot = sepv_local_lookup(obj_to_sepv(rt.syntax), property, owner_ptr);
-		if (syntax_slot)
-			return syntax_slot;
+	// (never true for prototypes, so this doesn't affect cached lookups)
+	if (!as_prototype) {
+		ExecutionFrame *current_frame = vm_current_frame();
+		if (rt.syntax && current_frame && (current_frame->locals == sepv)) {
+			Slot *syntax_slot = sepv_local_lookup(obj_to_sepv(rt.syntax), property, owner_ptr);
+			if (syntax_slot)
+				return syntax_slot;
+		}
 	}
-    
-    // do we have just a single prototype (allowing us to just recurse into it without C3?)
-    SepV prototype = sepv_prototypes(sepv);
-    if (prototype == SEPV_NOTHING)
-        return NULL;
-    if (!sepv_is_array(prototype))
-        return sepv_lookup(prototype, property, owner_ptr, error);
-    
-	// multiple prototypes, use the C3 lookup order
+
+	// do we have just a single prototype (allowing us to just look into it without C3?)
+	SepV prototype = sepv_prototypes(sepv);
+	if (prototype == SEPV_NOTHING)
+		return NULL;
+	if (!sepv_is_array(prototype))
+		return _sepv_cached_lookup(prototype, property, owner_ptr, error);
+
+	// multiple prototypes, use the C3 lookup order (the cached one is
+	// only used if no prototype lists changed since it was calculated)
 	SepArray *lookup_order = c3_order(sepv, &err);
 		or_fail_with(NULL);
-	int64_t c3_version = c3_cache_version(sepv);
 
 	// look into the objects in turn (skipping the first entry, which is just us again)
 	int current_index = 1, order_count = array_length(lookup_order);
 	for (;current_index < order_count; current_index++) {
 		SepV obj = array_get(lookup_order, current_index);
-
-		// check if the C3 order we are using is still valid (no later changes in the
-		// prototype lists of the objects on the C3 list)
-		int64_t obj_c3_version = c3_cache_version(obj);
-		if (obj_c3_version > c3_version) {
-			// our cached C3 order is stale, we should get a new one
-			c3_invalidate_cache(sepv);
-			lookup_order = c3_order(sepv, &err);
-				or_fail_with(NULL);
-			c3_version = c3_cache_version(sepv);
-			order_count = array_length(lookup_order);
-		}
+		if (as_prototype)
+			_mark_cached_prototype(obj);
 		Slot *slot = sepv_local_lookup(obj, property, owner_ptr);
 		if (slot)
 			return slot;
@@ -574,6 +748,22 @@ Slot *sepv_lookup(SepV sepv, SepString *property, SepV *owner_ptr, SepV *error)
 	return NULL;
 }
 
+// Finds a property starting from a given object, taking prototypes
+// into consideration. Returns NULL if nothing found.
+// If the 'owner_ptr' is non-NULL, it will also write the actual
+// 'owner' of the slot (i.e. the prototype in which the property
+// was finally found) into the memory being pointed to.
+Slot *sepv_lookup(SepV sepv, SepString *property, SepV *owner_ptr, SepV *error) {
+	// handle the LiteralScope in a special way
+	if (sepv == SEPV_LITERALS) {
+		// return the property name itself, wrapped in a fake slot
+		*owner_ptr = SEPV_NO_VALUE;
+		return slot_create(&st_field, str_to_sepv(property));
+	}
+
+	return _sepv_lookup_internal(sepv, property, owner_ptr, error, false);
+}
+
 // Gets the value of a property from an arbitrary SepV, using
 // proper lookup procedure.
 SepItem sepv_get_item(SepV sepv, SepString *property) {
@@ -594,9 +784,8 @@ SepItem sepv_get_item(SepV sepv, SepString *property) {
 			return item_artificial_lvalue(slot, value);
 		}
 	} else {
-		SepString *message = sepstr_sprintf("Property '%s' does not exist.",
-				property->cstr);
-		return si_exception(exc.EMissingProperty, message);
+		return si_exceptionf(exc.EMissingProperty, "Property '%.*s' does not exist.",
+				property->length, property->cstr);
 	}
 }
 
@@ -623,8 +812,8 @@ SepV sepv_lenient_get(SepV sepv, SepString *property) {
 SepV sepv_get(SepV sepv, SepString *property) {
 	SepV value = sepv_lenient_get(sepv, property);
 	if (value == SEPV_NO_VALUE) {
-		return sepv_exception(exc.EMissingProperty,
-				sepstr_sprintf("Property '%s' does not exist.", property->cstr));
+		return sepv_exceptionf(exc.EMissingProperty,
+				"Property '%.*s' does not exist.", property->length, property->cstr);
 	} else {
 		return value;
 	}
@@ -121,15 +121,30 @@ extern SlotType st_prototype_list;
 /**
  * Property maps group slots into a hashmap, which forms the basis
  * of September objects.
+ *
+ * The map is an open-addressing hash table in the "Swiss table" style.
+ * The entries themselves are packed densely in insertion order, while
+ * the hash table proper consists of two parallel arrays: control bytes
+ * and entry indices. Each control byte is either marked as empty, or holds
+ * the lowest 7 bits of the hash of the property stored in its position.
+ * Lookups compare a whole group of 16 control bytes against the hash
+ * fragment at once, so the names themselves are only compared when
+ * they are almost certain to match. Properties are never removed, so
+ * there is no need for tombstones.
+ *
+ * Most objects only ever hold a handful of properties, so maps can also
+ * start out with inline storage - entries placed directly after the
+ * object itself, without a hash table. These are searched linearly and
+ * the map is moved to a proper hash table once they run out.
  */
 
+// The number of properties stored inline in objects created with obj_create().
+#define PROPS_INLINE_CAPACITY 6
+
 /**
  * A single entry in the property hashmap.
  */
 typedef struct PropertyEntry {
-	// the index of the next entry in this bucket,
-	// or 0 if this is the last one
-	uint32_t		next_entry;
 	// the name of the property
 	SepString		*name;
 	// the slot for this property
@@ -137,12 +152,17 @@ typedef struct PropertyEntry {
 } PropertyEntry;
 
 typedef struct PropertyMap {
-	// the number of buckets in the hashmap
-	uint32_t capacity;
-	// the overflow pointer - points to the first free
-	// "overflow" entry for "second-in-bucket" elements
-	uint32_t overflow;
-	// the data table - always sized as double the capacity
+	// the number of entries the table has room for
+	uint32_t capacity : 26;
+	// the hash table has (1 << table_bits) positions
+	uint32_t table_bits : 5;
+	// is this map still using inline storage (and no hash table)?
+	uint32_t inline_storage : 1;
+	// the number of properties stored
+	uint32_t count;
+	// the data table - the entries are followed by the control bytes
+	// and the entry indices, all in a single allocation
+	// (unless the storage is inline - then this points inside the object)
 	PropertyEntry *entries;
 } PropertyMap;
 
@@ -155,6 +175,11 @@ typedef struct PropertyMap {
 // Initializes an empty property map, with some initial 'capacity'.
 void props_init(void *this,
 		int initial_capacity);
+// Initializes an empty property map using 'capacity' inline entries
+// that live inside the object itself (possibly none). No memory is
+// allocated until the inline entries run out.
+void props_init_inline(void *this,
+		PropertyEntry *storage, int capacity);
 
 // Adds a new property to the map and returns the new slot stored
 // inside the map. Should be preferred to props_accept_prop since
@@ -178,9 +203,9 @@ bool props_prop_exists(void *this, SepString *name);
 void props_add_field(void *this, const char *name,
 		SepV value);
 
-// Finds the hash table entry based on a raw hash and key string. Low-level
+// Finds the hash table entry based on a raw hash, key string and its length. Low-level
 // functionality, mostly useful for the string cache.
-PropertyEntry *props_find_entry_raw(void *this, const char *name, uint32_t hash);
+PropertyEntry *props_find_entry_raw(void *this, const char *name, uint32_t length, uint32_t hash);
 
 // ===============================================================
 //  Property iteration
@@ -188,7 +213,7 @@ PropertyEntry *props_find_entry_raw(void *this, const char *name, uint32_t hash)
 
 /**
  * Property iterator allows iterating over all properties in a map.
- * As it is a hashmap, the order of iteration is basically random.
+ * The properties are always visited in the order they were added in.
  */
 typedef struct PropertyIterator {
 	// the map we are iterating over
@@ -218,16 +243,28 @@ SepV propit_value(PropertyIterator *current);
 /**
  * Each object carries a 'traits', which is a bit-struct with various
  * metadata about the object. Currently, the most important bit is
- * the internal representation (SepObj or SepArray).
+ * the internal representation (SepObj, SepArray, SepBigInt or SepMap).
  */
 enum ObjectRepresentation {
 	// object is represented by a SepObj
 	REPRESENTATION_SIMPLE = 0,
 	// object is represented by a SepArray
-	REPRESENTATION_ARRAY = 1
+	REPRESENTATION_ARRAY = 1,
+	// object is represented by a SepBigInt
+	REPRESENTATION_BIGINT = 2,
+	// object is represented by a SepMap
+	REPRESENTATION_MAP = 3
 };
 typedef struct ObjectTraits {
-	unsigned int representation : 1;
+	unsigned int representation : 2;
+	// has the object been searched as a prototype during a cached lookup?
+	// if so, changing its properties or prototypes has to invalidate the
+	// global lookup cache
+	unsigned int cached_prototype : 1;
+	// is the auxillary data a native iterator? - see iterators.h
+	unsigned int native_iterator : 1;
+	// is the auxillary data the details of an exception? - see exceptions.h
+	unsigned int exception_details : 1;
 } ObjectTraits;
 
 /**
@@ -248,6 +285,11 @@ typedef struct SepObj {
 	// a set of flags describing the object
 	ObjectTraits traits;
 
+	// the cached C3 resolution order (or NULL if there is none yet), and
+	// the property cache version it was calculated in - see c3.h
+	struct SepArray *c3_order;
+	uint64_t c3_version;
+
 	// a space for arbitrary additional data used by the C side
 	// if this pointer is non-null, it must be:
 	// a) allocated from managed memory
@@ -270,6 +312,37 @@ SepItem si_obj(void *object);
 //  Property lookup for all types
 // ===============================================================
 
+/**
+ * Lookups that go through a single prototype are remembered in a
+ * direct-mapped cache, keyed on the prototype and the property name
+ * (both by identity). The entries are only valid as long as the
+ * property cache version doesn't change - it is bumped whenever an
+ * object searched during a cached lookup gets a new property or new
+ * prototypes. Garbage collections also invalidate the whole cache, as
+ * the memory of the keys could be reused by other objects afterwards.
+ */
+
+// The number of entries in the cache, has to be a power of two.
+#define LOOKUP_CACHE_SIZE 2048
+
+typedef struct LookupCacheEntry {
+	// the key - the prototype and the property name
+	SepV prototype;
+	SepString *property;
+	// the version of the cache the entry was created in
+	uint64_t version;
+	// the result of the lookup
+	SepV owner;
+	Slot *slot;
+} LookupCacheEntry;
+
+typedef struct LookupCache {
+	// the number of garbage collections performed so far
+	uint64_t collections;
+	// the entries themselves
+	LookupCacheEntry entries[LOOKUP_CACHE_SIZE];
+} LookupCache;
+
 // Finds the prototype list (or single prototype) for a given SepV,
 // handling both rich objects and primitives.
 SepV sepv_prototypes(SepV sepv);
@@ -279,6 +352,8 @@ SepV sepv_prototypes(SepV sepv);
 // If 'owner_ptr' is non-NULL, we will also write the actual
 // 'owner' of the slot (i.e. the prototype in which the property
 // was finally found) through this pointer.
+// Lookups through single prototypes are remembered in a global
+// cache, so repeated lookups of the same property are cheap.
 Slot *sepv_lookup(SepV object, SepString *property, SepV *owner_ptr, SepV *error);
 // Gets the value of a property from an arbitrary SepV, using
 // proper lookup procedure, and returning a stack item (slot + its value).
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
 
 #include "opcodes.h"
 #include "gc.h"
@@ -23,6 +24,7 @@
 #include "arrays.h"
 #include "exceptions.h"
 #include "functions.h"
+#include "iterators.h"
 #include "vm.h"
 
 #include "../vm/runtime.h"
@@ -69,7 +71,7 @@ void push_const_impl(ExecutionFrame *frame) {
 		case PRT_FUNCTION: {
 			CodeBlock *block = frame_block(frame, ref_index);
 			if (block == NULL) {
-				value = sepv_exception(exc.EInternal, sepstr_sprintf("Code block %d is out of bounds.", ref_index));
+				value = sepv_exceptionf(exc.EInternal, "Code block %d is out of bounds.", ref_index);
 			} else {
 				SepFunc *func = (SepFunc*)ifunc_create(block, frame->locals);
 				value = func_to_sepv(func);
@@ -87,22 +89,10 @@ void push_const_impl(ExecutionFrame *frame) {
 		stack_push_rvalue(frame->data, value);
 }
 
-void lazy_call_impl(ExecutionFrame *frame) {
-	// get reference to the function being called
-	SepStack *stack = frame->data;
-	SepFunc *func = sepv_call_target(stack_pop_value(stack));
-	if (!func) {
-		frame_raise(frame, sepv_exception(exc.EWrongType, sepstr_new("The object to be called is not a function or a callable.")));
-		return;
-	}
-
-	// use the VM's BytecodeArgs object to avoid allocation
-	BytecodeArgs bcargs;
-	ArgumentSource *args = (ArgumentSource*)(&bcargs);
-	bytecodeargs_init(&bcargs, frame);
-
-	log0("opcodes", "lazy <? args>");
-
+// Sets up the next frame to run 'func' with arguments from the given source.
+// The call starts once the current instruction finishes, and its result ends
+// up on the data stack.
+static void frame_start_call(ExecutionFrame *frame, SepFunc *func, ArgumentSource *args) {
 	// initialize a new frame for the function being called
 	vm_initialize_frame(frame->vm, frame->next_frame, func);
 
@@ -126,6 +116,33 @@ void lazy_call_impl(ExecutionFrame *frame) {
 	frame->called_another_frame = true;
 }
 
+// Same as frame_start_call(), but with arguments that were already evaluated.
+static void frame_start_call_with_values(ExecutionFrame *frame, SepFunc *func, argcount_t count, ...) {
+	va_list values;
+	va_start(values, count);
+	VAArgs args;
+	vaargs_init(&args, count, values);
+	frame_start_call(frame, func, (ArgumentSource*)&args);
+	va_end(values);
+}
+
+void lazy_call_impl(ExecutionFrame *frame) {
+	// get reference to the function being called
+	SepStack *stack = frame->data;
+	SepFunc *func = sepv_call_target(stack_pop_value(stack));
+	if (!func) {
+		frame_raise(frame, sepv_exception(exc.EWrongType, sepstr_new("The object to be called is not a function or a callable.")));
+		return;
+	}
+
+	// use the VM's BytecodeArgs object to avoid allocation
+	BytecodeArgs bcargs;
+	bytecodeargs_init(&bcargs, frame);
+
+	log0("opcodes", "lazy <? args>");
+	frame_start_call(frame, func, (ArgumentSource*)&bcargs);
+}
+
 void push_locals_impl(ExecutionFrame *frame) {
 	log0("opcodes", "pushlocals");
 	stack_push_rvalue(frame->data, frame->locals);
@@ -158,18 +175,24 @@ void fetch_prop_impl(ExecutionFrame *frame) {
 void store_impl(ExecutionFrame *frame) {
 	log0("opcodes", "store");
 
-	// get the value
+	// get the value and the slot to set stuff in - both stay on the stack
+	// until the store is done, since storing into a map can call September
+	// code (and trigger a GC) while the key is only referenced from there
 	SepV value = stack_pop_value(frame->data);
-	// get the slot to set stuff in
-	SepItem item = stack_pop_item(frame->data);
+	SepItem item = stack_top_item(frame->data);
+	stack_push_rvalue(frame->data, value);
 	if (!item_is_lvalue(item)) {
+		stack_pop_item(frame->data);
+		stack_pop_item(frame->data);
 		frame_raise(frame,
 				sepv_exception(exc.ECannotAssign, sepstr_for("Attempted assignment to an r-value.")));
 		return;
 	}
 
-	// store the value in the slot specified
-	SepV result = slot_store(item_slot(&item), &item.origin, value);
+	// store the value in the place specified
+	SepV result = item_store(&item, value);
+	stack_pop_item(frame->data);
+	stack_pop_item(frame->data);
 
 	// return the value to the stack (as an rvalue)
 	stack_push_rvalue(frame->data, result);
@@ -222,6 +245,260 @@ void pop_impl(ExecutionFrame *frame) {
 		frame_raise(frame, frame->return_value.value);
 }
 
+// ===============================================================
+//  Flow control
+// ===============================================================
+
+// Reads a jump offset and returns the place it points to.
+static CodeUnit *read_jump_target(ExecutionFrame *frame) {
+	// offsets are relative to the position of the offset itself
+	CodeUnit *origin = frame->instruction_ptr;
+	CodeUnit offset = frame_read(frame);
+	return origin + offset;
+}
+
+void jump_impl(ExecutionFrame *frame) {
+	CodeUnit *target = read_jump_target(frame);
+	log0("opcodes", "jump");
+	frame->instruction_ptr = target;
+}
+
+void jump_unless_impl(ExecutionFrame *frame) {
+	CodeUnit *target = read_jump_target(frame);
+	SepV condition = stack_pop_value(frame->data);
+	log0("opcodes", "jumpunless");
+	if (condition != SEPV_TRUE)
+		frame->instruction_ptr = target;
+}
+
+void guard_syntax_impl(ExecutionFrame *frame) {
+	// the name of the syntax built-in and the code to use if it was replaced
+	CodeUnit reference = frame_read(frame);
+	SepString *name = sepv_to_str(frame_constant(frame, decode_reference_index(reference)));
+	CodeUnit *fallback = read_jump_target(frame);
+	log("opcodes", "guard %s", name->cstr);
+
+	// the value the name resolved to is on the stack
+	Slot *original = props_find_prop(rt.inline_syntax, name);
+	if (original && (stack_top_value(frame->data) == original->value)) {
+		// still the built-in, we can run the compiled version
+		stack_pop_item(frame->data);
+	} else {
+		// customized - call whatever it is now the usual way
+		frame->instruction_ptr = fallback;
+	}
+}
+
+void push_nothing_impl(ExecutionFrame *frame) {
+	log0("opcodes", "pushnothing");
+	stack_push_rvalue(frame->data, SEPV_NOTHING);
+}
+
+// Drops everything the current iteration of a loop left behind on the data
+// stack and in the frame's GC roots - 'break' and 'continue' can jump out of
+// the middle of an expression.
+static void loop_drop_leftovers(ExecutionFrame *frame, InlineLoop *loop) {
+	stack_truncate(frame->data, loop->stack_depth);
+	ga_truncate(&frame->gc_roots, loop->gc_roots_mark);
+	frame->handler_depth = loop->handler_depth;
+}
+
+// Starts a new loop inside the frame, giving it a new scope with 'break' and
+// 'continue' in it. The loop continues each iteration from the instruction
+// right after the one starting it, which is always a LOOP_NEXT.
+static InlineLoop *loop_start(ExecutionFrame *frame, CodeUnit *exit) {
+	if (frame->loop_depth >= VM_INLINE_LOOP_DEPTH) {
+		frame_raise(frame, sepv_exception(exc.EInternal, sepstr_for("Too many loops nested inside one function.")));
+		return NULL;
+	}
+
+	InlineLoop *loop = &frame->loops[frame->loop_depth++];
+	loop->next = frame->instruction_ptr;
+	loop->exit = exit;
+	loop->outer_scope = frame->locals;
+	loop->variable = NULL;
+	loop->iterator = SEPV_NOTHING;
+	loop->iteration.next = SEPV_NOTHING;
+
+	SepObj *body_scope = obj_create_with_proto(frame->locals);
+	obj_add_prototype(body_scope, obj_to_sepv(rt.LoopBody));
+	frame->locals = obj_to_sepv(body_scope);
+
+	loop->stack_depth = stack_depth(frame->data);
+	loop->gc_roots_mark = ga_length(&frame->gc_roots);
+	loop->handler_depth = frame->handler_depth;
+	return loop;
+}
+
+void loop_start_impl(ExecutionFrame *frame) {
+	CodeUnit *exit = read_jump_target(frame);
+	log0("opcodes", "loopstart");
+	loop_start(frame, exit);
+}
+
+void for_start_impl(ExecutionFrame *frame) {
+	CodeUnit reference = frame_read(frame);
+	SepString *variable = sepv_to_str(frame_constant(frame, decode_reference_index(reference)));
+	CodeUnit *exit = read_jump_target(frame);
+	log("opcodes", "forstart %s", variable->cstr);
+
+	// get an iterator for the collection, which stays on the stack until we have it
+	SepV collection = stack_top_value(frame->data);
+	SepV iterator = call_method(frame->vm, collection, "iterator", 0);
+	stack_pop_item(frame->data);
+	if (sepv_is_exception(iterator)) {
+		frame_raise(frame, iterator);
+		return;
+	}
+	if (sepv_is_signal(iterator))
+		return;
+
+	InlineLoop *loop = loop_start(frame, exit);
+	if (!loop)
+		return;
+	loop->variable = variable;
+	loop->iterator = iterator;
+	SepV started = iteration_start(&loop->iteration, frame->vm, iterator);
+	if (sepv_is_exception(started)) {
+		frame_raise(frame, started);
+		return;
+	}
+	props_add_prop(sepv_to_obj(frame->locals), variable, &st_field, SEPV_NOTHING);
+	loop->gc_roots_mark = ga_length(&frame->gc_roots);
+}
+
+void loop_next_impl(ExecutionFrame *frame) {
+	log0("opcodes", "loopnext");
+	InlineLoop *loop = &frame->loops[frame->loop_depth - 1];
+	loop_drop_leftovers(frame, loop);
+
+	// for..in loops move on to the next element here
+	if (loop->variable) {
+		SepV element = iteration_next(&loop->iteration);
+		if (element == SEPV_NO_VALUE) {
+			frame->instruction_ptr = loop->exit;
+		} else if (sepv_is_exception(element)) {
+			frame_raise(frame, element);
+		} else if (sepv_is_signal(element)) {
+			// 'break' or 'continue' inside a callback pulling the element -
+			// the loop has already been sent where it should go
+			return;
+		} else {
+			props_set_prop(sepv_to_obj(frame->locals), loop->variable, element);
+		}
+	}
+}
+
+void loop_end_impl(ExecutionFrame *frame) {
+	log0("opcodes", "loopend");
+	InlineLoop *loop = &frame->loops[frame->loop_depth - 1];
+	loop_drop_leftovers(frame, loop);
+	frame->locals = loop->outer_scope;
+	frame->loop_depth--;
+
+	// loops have no value
+	stack_push_rvalue(frame->data, SEPV_NOTHING);
+}
+
+// ===============================================================
+//  Exception handling
+// ===============================================================
+
+void try_start_impl(ExecutionFrame *frame) {
+	CodeUnit *catch_clauses = read_jump_target(frame);
+	log0("opcodes", "trystart");
+	if (frame->handler_depth >= VM_HANDLER_DEPTH) {
+		frame_raise(frame, sepv_exception(exc.EInternal, sepstr_for("Too many try statements nested inside one function.")));
+		return;
+	}
+
+	// all it takes is remembering where we are
+	ExceptionHandler *handler = &frame->handlers[frame->handler_depth++];
+	handler->handler = catch_clauses;
+	handler->scope = frame->locals;
+	handler->stack_depth = stack_depth(frame->data);
+	handler->gc_roots_mark = ga_length(&frame->gc_roots);
+	handler->loop_depth = frame->loop_depth;
+}
+
+void try_end_impl(ExecutionFrame *frame) {
+	log0("opcodes", "tryend");
+	frame->handler_depth--;
+}
+
+void catch_match_impl(ExecutionFrame *frame) {
+	CodeUnit *next_clause = read_jump_target(frame);
+	log0("opcodes", "catchmatch");
+
+	// the caught exception is right below the type of this clause
+	SepV type = stack_pop_value(frame->data);
+	SepV exception = stack_top_value(frame->data);
+	if (sepv_is_instance(exception, type)) {
+		// caught - the exception isn't needed anymore
+		stack_pop_item(frame->data);
+	} else {
+		frame->instruction_ptr = next_clause;
+	}
+}
+
+void rethrow_impl(ExecutionFrame *frame) {
+	log0("opcodes", "rethrow");
+	// none of the clauses matched, the exception goes on
+	frame_raise(frame, stack_pop_value(frame->data));
+}
+
+// ===============================================================
+//  Element access
+// ===============================================================
+
+void index_impl(ExecutionFrame *frame) {
+	SepStack *stack = frame->data;
+
+	// the name of the indexing method
+	CodeUnit reference = frame_read(frame);
+	SepString *name = sepv_to_str(frame_constant(frame, decode_reference_index(reference)));
+	log0("opcodes", "index");
+
+	// the host and the already evaluated index are on the stack - they stay
+	// there until we're done to keep them safe from the GC
+	SepV index = stack_pop_value(stack);
+	SepV host = stack_top_value(stack);
+	stack_push_rvalue(stack, index);
+
+	// an array that still uses the original "[]" can be read from directly
+	SepV err = SEPV_NO_VALUE;
+	Slot *method = sepv_lookup(host, name, NULL, &err);
+	Slot *original = props_find_prop(rt.inline_syntax, name);
+	if (method && original && (method->value == original->value) && sepv_is_array(host) && sepv_is_int(index)) {
+		SepArray *array = sepv_to_array(host);
+		SepInt position = sepv_to_int(index);
+		if (position < 0)
+			position += array_length(array);
+		if ((position >= 0) && (position < array_length(array))) {
+			SepV value = array_get(array, (uint32_t)position);
+			stack_pop_item(stack);
+			stack_pop_item(stack);
+			stack_push_item(stack, item_index_lvalue(host, (uint32_t)position, value));
+			return;
+		}
+	}
+
+	// anything else calls "[]" the usual way, which also takes care of reporting
+	// indices that are out of bounds
+	SepV method_v = sepv_get(host, name);
+	if (sepv_is_exception(method_v)) {
+		frame_raise(frame, method_v);
+	} else {
+		SepFunc *func = sepv_call_target(method_v);
+		if (func)
+			frame_start_call_with_values(frame, func, 1, index);
+		else
+			frame_raise(frame, sepv_exception(exc.EWrongType, sepstr_new("The object to be called is not a function or a callable.")));
+	}
+	stack_pop_item(stack);
+	stack_pop_item(stack);
+}
+
 // ===============================================================
 //  Instruction lookup table
 // ===============================================================
@@ -233,5 +510,9 @@ InstructionLogic instruction_lut[OP_MAX] = {
 	NULL, &push_const_impl, NULL, NULL,
 	&lazy_call_impl, NULL, NULL, NULL,
 	&push_locals_impl, &fetch_prop_impl, &pop_impl,
-	&store_impl, &create_field_impl
+	&store_impl, &create_field_impl, NULL, NULL, NULL,
+	&jump_impl, &jump_unless_impl, &guard_syntax_impl, &push_nothing_impl,
+	&loop_start_impl, &for_start_impl, &loop_next_impl, &loop_end_impl,
+	&try_start_impl, &try_end_impl, &catch_match_impl, &rethrow_impl,
+	&index_impl
 };
@@ -96,6 +96,27 @@ enum OpCodes {
 	OP_STORE         = 0xB,
 	OP_CREATE_PROPERTY  = 0xC,
 
+	// flow control - used to compile 'if', 'while' and 'for' directly
+	// into the function instead of calling the syntax built-ins
+	OP_JUMP          = 0x10,
+	OP_JUMP_UNLESS   = 0x11,
+	OP_GUARD_SYNTAX  = 0x12,
+	OP_PUSH_NOTHING  = 0x13,
+	OP_LOOP_START    = 0x14,
+	OP_FOR_START     = 0x15,
+	OP_LOOP_NEXT     = 0x16,
+	OP_LOOP_END      = 0x17,
+
+	// exception handling - used for 'try..catch' compiled the same way
+	OP_TRY_START     = 0x18,
+	OP_TRY_END       = 0x19,
+	OP_CATCH_MATCH   = 0x1A,
+	OP_RETHROW       = 0x1B,
+
+	// element access - used to read array elements directly instead of
+	// calling "[]" on the array
+	OP_INDEX         = 0x1C,
+
 	// maximum value
 	OP_MAX
 };
@@ -19,7 +19,7 @@
 //  Extracting runtime objects
 // ===============================================================
 
-RuntimeObjects rt = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+RuntimeObjects rt = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
 BuiltinExceptions exc = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
 
 #define store(into, property_name) do { into->property_name = prop_as_obj(globals_v, #property_name, &err); or_raise_sepv(err) } while(0)
@@ -57,8 +57,11 @@ SepV initialize_runtime_references(RuntimeObjects *rt, BuiltinExceptions *exc, S
 
 	// other primitives and built-ins
 	store(rt, Array);
+	store(rt, Map);
+	store(rt, Set);
 	store(rt, Bool);
 	store(rt, Integer);
+	store(rt, Float);
 	store(rt, NothingType);
 	store(rt, String);
 	store(rt, Function);
@@ -67,6 +70,12 @@ SepV initialize_runtime_references(RuntimeObjects *rt, BuiltinExceptions *exc, S
 	rt->Cls = prop_as_obj(globals_v, "Class", &err);
 		or_raise_sepv(err);
 
+	// flow control
+	rt->inline_syntax = prop_as_obj(globals_v, "<inlineSyntax>", &err);
+		or_raise_sepv(err);
+	rt->LoopBody = prop_as_obj(obj_to_sepv(rt->inline_syntax), "<loopBody>", &err);
+		or_raise_sepv(err);
+
 	return SEPV_NOTHING;
 }
 #undef store
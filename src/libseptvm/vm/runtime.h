@@ -30,7 +30,10 @@ typedef struct RuntimeObjects {
 	// the primitive classes
 	SepObj *Object;
 	SepObj *Array;
+	SepObj *Map;
+	SepObj *Set;
 	SepObj *Integer;
+	SepObj *Float;
 	SepObj *String;
 	SepObj *Bool;
 	SepObj *Function;
@@ -39,6 +42,12 @@ typedef struct RuntimeObjects {
 
 	// the class object
 	SepObj *Cls;
+
+	// the original flow control built-ins (and the original Array "[]"),
+	// which compiled code checks against before running its own version of them
+	SepObj *inline_syntax;
+	// gives loop bodies their 'break' and 'continue'
+	SepObj *LoopBody;
 } RuntimeObjects;
 
 typedef struct BuiltinExceptions {
@@ -14,6 +14,7 @@
 
 #include <stdlib.h>
 
+#include "mem.h"
 #include "exceptions.h"
 #include "stack.h"
 
@@ -24,77 +25,119 @@
 //  Stack implementation
 // ===============================================================
 
+// The number of entries (and origins) a new stack has room for.
+#define STACK_INITIAL_CAPACITY 64
+
 // Creates a new, empty data stack.
 SepStack *stack_create() {
 	SepStack *stack = (SepStack*)mem_unmanaged_allocate(sizeof(SepStack));
-	ga_init(&stack->array, 8, sizeof(SepItem), &allocator_unmanaged);
+	stack->entries = mem_unmanaged_allocate(STACK_INITIAL_CAPACITY * sizeof(StackEntry));
+	stack->top = stack->entries;
+	stack->end = stack->entries + STACK_INITIAL_CAPACITY;
+	stack->origins = mem_unmanaged_allocate(STACK_INITIAL_CAPACITY * sizeof(StackOrigin));
+	stack->origins_top = stack->origins;
+	stack->origins_end = stack->origins + STACK_INITIAL_CAPACITY;
+	stack->arglist_index = 0;
 	return stack;
 }
 
 // Frees the stack and all the contents.
 void stack_free(SepStack *this) {
+	mem_unmanaged_free(this->entries);
+	mem_unmanaged_free(this->origins);
 	mem_unmanaged_free(this);
 }
 
+// Makes room for more entries, after the stack filled up.
+void stack_grow(SepStack *this) {
+	uint32_t depth = this->top - this->entries;
+	uint32_t capacity = (this->end - this->entries) * 2;
+	this->entries = mem_unmanaged_realloc(this->entries, capacity * sizeof(StackEntry));
+	this->top = this->entries + depth;
+	this->end = this->entries + capacity;
+}
+
+// Makes room for more origins, after the origin table filled up.
+static void stack_grow_origins(SepStack *this) {
+	uint32_t count = this->origins_top - this->origins;
+	uint32_t capacity = (this->origins_end - this->origins) * 2;
+	this->origins = mem_unmanaged_realloc(this->origins, capacity * sizeof(StackOrigin));
+	this->origins_top = this->origins + count;
+	this->origins_end = this->origins + capacity;
+}
+
+// Creates the exception reported when popping from an empty stack.
+SepV stack_underflow() {
+	return sepv_exception(exc.EInternal, sepstr_for("Internal error: stack underflow."));
+}
+
+// Puts a stack entry back together into a full item.
+static SepItem stack_entry_to_item(SepStack *this, StackEntry *entry) {
+	if (entry->type == SIT_RVALUE)
+		return item_rvalue(entry->value);
+
+	StackOrigin *origin = &this->origins[entry->origin];
+	SepItem item = {entry->type, origin->slot, origin->origin, entry->value};
+	return item;
+}
+
 // == stack operation
 
-// Checks if the stack is empty.
-bool stack_empty(SepStack *this) {
-	return ga_length(&this->array) == 0;
+// Drops items from the top of the stack until only 'depth' are left.
+void stack_truncate(SepStack *this, uint32_t depth) {
+	log0("stack", "Truncated.");
+	if (depth >= stack_depth(this))
+		return;
+	this->top = this->entries + depth;
+	this->origins_top = this->origins + this->top->origin;
 }
 
 // Pushes a new SepItem (slot + value) on the stack.
 void stack_push_item(SepStack *this, SepItem item) {
 	log0("stack", "Pushed.");
-	ga_push(&this->array, &item);
+	if (item.type == SIT_RVALUE) {
+		stack_push_rvalue(this, item.value);
+		return;
+	}
+
+	if (this->top == this->end)
+		stack_grow(this);
+	if (this->origins_top == this->origins_end)
+		stack_grow_origins(this);
+
+	StackEntry *entry = this->top++;
+	entry->value = item.value;
+	entry->origin = this->origins_top - this->origins;
+	entry->type = item.type;
+
+	StackOrigin *origin = this->origins_top++;
+	origin->slot = item.slot;
+	origin->origin = item.origin;
 }
 
 // Pops an item from the stack, with exception on empty stack.
 SepItem stack_pop_item(SepStack *this) {
-	SepItem *ptr = ga_pop(&this->array);
-	if (!ptr) {
-		SepV exception = sepv_exception(exc.EInternal, sepstr_for("Internal error: stack underflow."));
-		return item_rvalue(exception);
-	}
+	if (this->top == this->entries)
+		return item_rvalue(stack_underflow());
 	log0("stack", "Popped.");
-	return *ptr;
+	StackEntry *entry = --this->top;
+	this->origins_top = this->origins + entry->origin;
+	return stack_entry_to_item(this, entry);
 }
 
 // Returns the top item from the stack, with exception on empty stack.
 SepItem stack_top_item(SepStack *this) {
-	uint32_t length = ga_length(&this->array);
-	if (!length) {
-		SepV exception = sepv_exception(exc.EInternal, sepstr_for("Internal error: stack underflow."));
-		return item_rvalue(exception);
-	}
-	return *(SepItem*)ga_get(&this->array, length-1);
+	if (this->top == this->entries)
+		return item_rvalue(stack_underflow());
+	return stack_entry_to_item(this, this->top - 1);
 }
 
 // Replaces the top item on the stack with another item.
 SepV stack_replace_top(SepStack *this, SepItem new_item) {
-	uint32_t length = ga_length(&this->array);
-	if (!length) {
-		return sepv_exception(exc.EInternal, sepstr_for("Internal error: stack underflow."));
-	}
-	ga_set(&this->array, length-1, &new_item);
+	if (this->top == this->entries)
+		return stack_underflow();
+	StackEntry *entry = --this->top;
+	this->origins_top = this->origins + entry->origin;
+	stack_push_item(this, new_item);
 	return SEPV_NOTHING;
 }
-
-// === shortcuts
-
-// Pushes an rvalue (value without a slot) on the stack.
-void stack_push_rvalue(SepStack *this, SepV value) {
-	stack_push_item(this, item_rvalue(value));
-}
-
-// Pops just the value from the top of the stack.
-SepV stack_pop_value(SepStack *this) {
-	SepItem item = stack_pop_item(this);
-	return item.value;
-}
-
-// Returns the value from the top item on the stack.
-SepV stack_top_value(SepStack *this) {
-	SepItem item = stack_top_item(this);
-	return item.value;
-}
@@ -18,15 +18,43 @@
 
 #include <stdbool.h>
 #include "types.h"
-#include "../common/garray.h"
 
 // ===============================================================
 //  The data stack
 // ===============================================================
 
+/**
+ * A single entry on the data stack. Most of what goes through the stack
+ * are r-values, so the entries only keep the value and the item type -
+ * the slot and origin of l-values live in a separate table (see below).
+ */
+typedef struct StackEntry {
+	// the value itself
+	SepV value;
+	// the index in the origin table this entry's origin is stored at (for
+	// l-values), or would be stored at (for r-values)
+	uint32_t origin;
+	// the SepItemType of the item
+	uint8_t type;
+} StackEntry;
+
+/**
+ * Everything an l-value item has beyond its value. These are kept in
+ * a table that grows and shrinks along with the stack, with one entry for
+ * every l-value on the stack, in the same order.
+ */
+typedef struct StackOrigin {
+	// the slot the value came from
+	struct Slot *slot;
+	// additional information used by property and index l-values
+	OriginInfo origin;
+} StackOrigin;
+
 typedef struct SepStack {
-	// the underlying generic array
-	GenericArray array;
+	// the entries, with 'top' pointing one past the topmost one
+	StackEntry *entries, *top, *end;
+	// the origins of the l-values on the stack, laid out the same way
+	StackOrigin *origins, *origins_top, *origins_end;
 
 	// index of the next argument to be added to the argument list
 	int32_t arglist_index;
@@ -41,8 +69,8 @@ void stack_free(SepStack *this);
 
 // == stack operation
 
-// Checks if the stack is empty.
-bool stack_empty(SepStack *this);
+// Drops items from the top of the stack until only 'depth' are left.
+void stack_truncate(SepStack *this, uint32_t depth);
 // Pushes a new SepItem (slot + value) on the stack.
 void stack_push_item(SepStack *this, SepItem item);
 // Pops an item from the stack, with exception on empty stack.
@@ -52,14 +80,50 @@ SepItem stack_top_item(SepStack *this);
 // Replaces the top item on the stack with another item. Returns exception on failure (empty stack).
 SepV stack_replace_top(SepStack *this, SepItem new_item);
 
-// === shortcuts
+// == internals used by the inline operations
+
+// Makes room for more entries, after the stack filled up.
+void stack_grow(SepStack *this);
+// Creates the exception reported when popping from an empty stack.
+SepV stack_underflow();
+
+// == inline operations
+
+// Checks if the stack is empty.
+static inline bool stack_empty(SepStack *this) {
+	return this->top == this->entries;
+}
+
+// Returns the number of items on the stack.
+static inline uint32_t stack_depth(SepStack *this) {
+	return this->top - this->entries;
+}
 
 // Pushes an rvalue (value without a slot) on the stack.
-void stack_push_rvalue(SepStack *this, SepV value);
+static inline void stack_push_rvalue(SepStack *this, SepV value) {
+	if (this->top == this->end)
+		stack_grow(this);
+	StackEntry *entry = this->top++;
+	entry->value = value;
+	entry->origin = this->origins_top - this->origins;
+	entry->type = SIT_RVALUE;
+}
+
 // Pops just the value from the top of the stack.
-SepV stack_pop_value(SepStack *this);
+static inline SepV stack_pop_value(SepStack *this) {
+	if (this->top == this->entries)
+		return stack_underflow();
+	StackEntry *entry = --this->top;
+	this->origins_top = this->origins + entry->origin;
+	return entry->value;
+}
+
 // Returns the value from the top item on the stack.
-SepV stack_top_value(SepStack *this);
+static inline SepV stack_top_value(SepStack *this) {
+	if (this->top == this->entries)
+		return stack_underflow();
+	return this->top[-1].value;
+}
 
 /*****************************************************************/
 
@@ -12,6 +12,7 @@
 //  Includes
 // ===============================================================
 
+#include <assert.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -31,15 +32,82 @@
 //  Hashing implementation
 // ===============================================================
 
-// The current string hash implementation, Bernstein's DJB2 hash.
-uint32_t cstring_hash(const char *c_string) {
-	uint32_t hash = 5381;
-	uint8_t *str = (uint8_t*)c_string;
-	uint8_t c;
-	while ((c = *str++))
-		hash = ((hash << 5) + hash) ^ c;
+// The current string hash implementation is based on wyhash (by Wang Yi),
+// which consumes the string a machine word at a time and distributes short
+// identifiers well.
+
+// Constants used by the hash.
+static const uint64_t HASH_SECRET[4] = {
+	0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+	0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+};
+
+// Multiplies two 64-bit numbers, storing the low and high halves of the
+// 128-bit result back into them.
+static inline void _hash_multiply(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t product = (__uint128_t)*a * *b;
+	*a = (uint64_t)product;
+	*b = (uint64_t)(product >> 64);
+#else
+	uint64_t a_hi = *a >> 32, a_lo = (uint32_t)*a, b_hi = *b >> 32, b_lo = (uint32_t)*b;
+	uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo, lh = a_lo * b_hi, ll = a_lo * b_lo;
+	uint64_t middle = (ll >> 32) + (uint32_t)hl + lh;
+	*a = (middle << 32) | (uint32_t)ll;
+	*b = hh + (hl >> 32) + (middle >> 32);
+#endif
+}
+
+// Multiplies two 64-bit numbers, and folds the 128-bit result into 64 bits.
+static inline uint64_t _hash_mix(uint64_t a, uint64_t b) {
+	_hash_multiply(&a, &b);
+	return a ^ b;
+}
+
+// Unaligned reads of 8, 4 and 1-3 bytes.
+static inline uint64_t _hash_read8(const uint8_t *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint64_t _hash_read4(const uint8_t *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static inline uint64_t _hash_read3(const uint8_t *p, uint32_t k) {
+	return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint32_t cstring_hash(const char *chars, uint32_t length) {
+	const uint8_t *p = (const uint8_t*)chars;
+	uint64_t seed = _hash_mix(HASH_SECRET[0], HASH_SECRET[1]);
+	uint64_t a, b;
+
+	if (length <= 16) {
+		// short strings (most identifiers) are read in two overlapping parts
+		if (length >= 4) {
+			uint32_t shift = (length >> 3) << 2;
+			a = (_hash_read4(p) << 32) | _hash_read4(p + shift);
+			b = (_hash_read4(p + length - 4) << 32) | _hash_read4(p + length - 4 - shift);
+		} else if (length > 0) {
+			a = _hash_read3(p, length);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		// longer ones are consumed 16 bytes at a time
+		uint32_t remaining = length;
+		while (remaining > 16) {
+			seed = _hash_mix(_hash_read8(p) ^ HASH_SECRET[1], _hash_read8(p + 8) ^ seed);
+			p += 16;
+			remaining -= 16;
+		}
+		a = _hash_read8(p + remaining - 16);
+		b = _hash_read8(p + remaining - 8);
+	}
 
-	return hash;
+	a ^= HASH_SECRET[1];
+	b ^= seed;
+	_hash_multiply(&a, &b);
+	uint64_t hash = _hash_mix(a ^ HASH_SECRET[0] ^ length, b ^ HASH_SECRET[1]);
+
+	// 0 is reserved for "not calculated yet"
+	uint32_t folded = (uint32_t)hash ^ (uint32_t)(hash >> 32);
+	return folded ? folded : 1;
 }
 
 // ===============================================================
@@ -48,9 +116,10 @@ uint32_t cstring_hash(const char *c_string) {
 
 SepString *sepstr_for(const char *c_string) {
 	// look in the cache and return interned string if something's there
-	uint32_t hash = cstring_hash(c_string);
+	uint32_t length = strlen(c_string);
+	uint32_t hash = cstring_hash(c_string, length);
 	if (lsvm_globals.string_cache) {
-		PropertyEntry *entry = props_find_entry_raw(lsvm_globals.string_cache, c_string, hash);
+		PropertyEntry *entry = props_find_entry_raw(lsvm_globals.string_cache, c_string, length, hash);
 		if (entry) {
 			log("strcache", "Returning cached string: '%s'", c_string);
 			return entry->name;
@@ -93,26 +162,32 @@ SepString *sepstr_new(const char *c_string) {
 // mostly for functions that want to initialize the string contents themselves
 // and then return it.
 SepString *sepstr_with_length(SepInt length) {
-	size_t size = length + 1;
-	char *buffer = mem_unmanaged_allocate(size);
+	SepString *string = sepstr_allocate(length);
+	memset(string->cstr, 32, length);
 
-	memset(buffer, 32, size);
-	buffer[length] = '\0';
-	SepString *string = sepstr_new(buffer);
+	// register it to avoid accidentally GC'ing it away
+	gc_register(str_to_sepv(string));
 
-	mem_unmanaged_free(buffer);
 	return string;
 }
 
 SepString *sepstr_sprintf(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	SepString *new_sepstr = sepstr_vsprintf(format, args);
+	va_end(args);
+	return new_sepstr;
+}
+
+SepString *sepstr_vsprintf(const char *format, va_list args) {
 	int buffer_size = 80;
 	char *buffer = mem_unmanaged_allocate(buffer_size);
 	bool fit = true;
 
-	va_list args;
+	va_list attempt_args;
 	do {
-		va_start(args, format);
-		int chars_written = vsnprintf(buffer, buffer_size, format, args);
+		va_copy(attempt_args, args);
+		int chars_written = vsnprintf(buffer, buffer_size, format, attempt_args);
 		fit = chars_written < buffer_size;
 		if (fit) {
 			buffer[chars_written] = '\0';
@@ -120,7 +195,7 @@ SepString *sepstr_sprintf(const char *format, ...) {
 			buffer_size *= 2;
 			buffer = mem_unmanaged_realloc(buffer, buffer_size);
 		}
-		va_end(args);
+		va_end(attempt_args);
 	} while (!fit);
 
 	SepString *new_sepstr = sepstr_new(buffer);
@@ -135,10 +210,88 @@ SepString *sepstr_allocate(uint32_t length) {
 	SepString *string = mem_allocate(size);
 	string->length = length;
 	string->hash = 0;
+	string->cstr = string->content;
+	string->parent = NULL;
+	string->content[length] = '\0';
 
 	return string;
 }
 
+// Creates a new, GC-registered string holding a copy of the characters given.
+SepString *_sepstr_copy_of(const char *chars, uint32_t length) {
+	SepString *copy = sepstr_allocate(length);
+	memcpy(copy->cstr, chars, length);
+	gc_register(str_to_sepv(copy));
+	return copy;
+}
+
+// Slices shorter than this are copied instead - the copy takes less memory
+// than a slice, and does not keep a possibly much longer parent alive.
+#define SEPSTR_MIN_SLICE_LENGTH 16
+
+// Returns a substring of a given string. Longer substrings are slices that share
+// the characters with the original, shorter ones are simply copied.
+SepString *sepstr_slice(SepString *this, uint32_t start, uint32_t length) {
+	assert(start + length <= this->length);
+
+	// trivial cases
+	if ((start == 0) && (length == this->length))
+		return this;
+	if (length == 0)
+		return sepstr_for("");
+	if (length == 1)
+		return sepstr_for_char(this->cstr[start]);
+
+	// short substrings are better off copied
+	if (length < SEPSTR_MIN_SLICE_LENGTH)
+		return _sepstr_copy_of(this->cstr + start, length);
+
+	// slices always point to the string that actually holds the characters,
+	// so that slices of slices do not form chains
+	SepString *owner = this->parent ? this->parent : this;
+	SepString *slice = mem_allocate(sizeof(SepString));
+	slice->length = length;
+	slice->hash = 0;
+	slice->cstr = this->cstr + start;
+	slice->parent = owner;
+
+	// register it to avoid accidentally GC'ing it away
+	gc_register(str_to_sepv(slice));
+
+	return slice;
+}
+
+// Returns the interned one-character string for a given character.
+SepString *sepstr_for_char(char character) {
+	return lsvm_globals.character_strings[(uint8_t)character];
+}
+
+// Returns a NUL-terminated version of a string - the string itself if it's not
+// a slice, or a fresh copy if it is.
+SepString *sepstr_flatten(SepString *this) {
+	if (!this->parent)
+		return this;
+	return _sepstr_copy_of(this->cstr, this->length);
+}
+
+// Creates the table of interned one-character strings used by sepstr_for_char().
+// Has to be called after the string cache is created, as the cache is what
+// keeps the strings from being collected.
+void sepstr_initialize_char_table() {
+	SepString **table = mem_unmanaged_allocate(256 * sizeof(SepString*));
+
+	// September strings never contain NUL, so there is no string for it
+	table[0] = NULL;
+	char c_string[2] = {'\0', '\0'};
+	int character;
+	for (character = 1; character < 256; character++) {
+		c_string[0] = (char)character;
+		table[character] = sepstr_for(c_string);
+	}
+
+	lsvm_globals.character_strings = table;
+}
+
 
 SepV sepv_string(char *c_string) {
 	return str_to_sepv(sepstr_for(c_string));
@@ -151,7 +304,9 @@ SepItem si_string(char *c_string) {
 void sepstr_init(SepString *this, const char *c_string) {
 	this->length = strlen(c_string);
 	this->hash = 0x0;
-	strcpy(this->cstr, c_string);
+	this->cstr = this->content;
+	this->parent = NULL;
+	memcpy(this->content, c_string, this->length + 1);
 }
 
 size_t sepstr_allocation_size(const char *c_string) {
@@ -164,13 +319,36 @@ uint32_t sepstr_hash(SepString *this) {
 		return this->hash;
 
 	// hash, remember and return
-	return (this->hash = cstring_hash(this->cstr));
+	return (this->hash = cstring_hash(this->cstr, this->length));
 }
 
 int sepstr_cmp(SepString *this, SepString *other) {
 	// same instance (common with constants/interned)?
 	if (this == other)
 		return 0;
-	else
-		return strcmp(this->cstr, other->cstr);
+
+	// compare the common part, then the lengths (slices are not NUL-terminated)
+	uint32_t common = (this->length < other->length) ? this->length : other->length;
+	int result = memcmp(this->cstr, other->cstr, common);
+	if (result)
+		return result;
+	return (this->length > other->length) - (this->length < other->length);
+}
+
+bool sepstr_equals(SepString *this, SepString *other) {
+	// same instance (common with constants/interned)?
+	if (this == other)
+		return true;
+
+	// cheap early rejection, using hashes only if both are already known
+	if (this->length != other->length)
+		return false;
+	if (this->hash && other->hash && (this->hash != other->hash))
+		return false;
+
+	return !memcmp(this->cstr, other->cstr, this->length);
+}
+
+bool sepstr_is_slice(SepString *this) {
+	return this->parent != NULL;
 }
@@ -17,6 +17,7 @@
 // ===============================================================
 
 #include <stdbool.h>
+#include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -26,15 +27,23 @@
 
 /**
  * The strings type caches the length and the hashcode of the string -
- * otherwise, it's just a C string.
+ * otherwise, it's just a C string. Strings can also be slices of other
+ * strings - in that case, they share the characters of their parent instead
+ * of holding a copy, and their 'cstr' is *not* NUL-terminated. Code that
+ * can receive arbitrary strings should always respect 'length'.
  */
 typedef struct SepString {
 	// the length of the string
 	uint32_t length;
 	// the hash, or just 0 if it's not cached yet
 	uint32_t hash;
-	// the actual C string
-	char cstr[0];
+	// the characters of the string - points to 'content' for normal strings,
+	// and somewhere inside the parent string for slices
+	char *cstr;
+	// for slices, the string that actually holds the characters, NULL otherwise
+	struct SepString *parent;
+	// the actual C string (not present in slices)
+	char content[0];
 } SepString;
 
 // Returns a SepString based on a C string. This will be a new or cached instance.
@@ -48,9 +57,19 @@ SepString *sepstr_new(const char *c_string);
 SepString *sepstr_with_length(SepInt length);
 // Returns a new SepString obtained by running sprintf with the arguments provided.
 SepString *sepstr_sprintf(const char *format, ...);
+// Same as above, taking the arguments as a va_list.
+SepString *sepstr_vsprintf(const char *format, va_list args);
 // Allocates a new SepString* with a given maximum length, but uninitialized contents.
 // Useful for built-ins that dynamically generate strings.
 SepString *sepstr_allocate(uint32_t length);
+// Returns a substring of a given string. Longer substrings are slices that share
+// the characters with the original, shorter ones are simply copied.
+SepString *sepstr_slice(SepString *this, uint32_t start, uint32_t length);
+// Returns the interned one-character string for a given character.
+SepString *sepstr_for_char(char character);
+// Returns a NUL-terminated version of a string - the string itself if it's not
+// a slice, or a fresh copy if it is.
+SepString *sepstr_flatten(SepString *this);
 
 // Returns a new string, wrapped in a SepV.
 SepV sepv_string(char *c_string);
@@ -66,6 +85,14 @@ void sepstr_init(SepString *this, const char *c_string);
 uint32_t sepstr_hash(SepString *this);
 // Compares two strings, with the return value like for strcmp (-/0/+).
 int sepstr_cmp(SepString *this, SepString *other);
+// Checks two strings for equality. Faster than sepstr_cmp(), as it can reject
+// strings with different lengths or hashes without looking at the contents.
+bool sepstr_equals(SepString *this, SepString *other);
+// Checks whether a string is a slice sharing characters with another string.
+bool sepstr_is_slice(SepString *this);
+
+// Creates the table of interned one-character strings used by sepstr_for_char().
+void sepstr_initialize_char_table();
 
 
 /*****************************************************************/
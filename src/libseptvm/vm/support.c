@@ -20,8 +20,10 @@
 #include "../vm/types.h"
 #include "../vm/functions.h"
 #include "../vm/arrays.h"
+#include "../vm/bigints.h"
 #include "../vm/runtime.h"
 #include "../vm/support.h"
+#include "../libmain.h"
 
 // ===============================================================
 //  Safe parameter access
@@ -43,6 +45,10 @@ SepInt cast_as_int(SepV value, SepV *error) {
 	return cast_as_named_int("Value", value, error);
 }
 
+SepFloat cast_as_float(SepV value, SepV *error) {
+	return cast_as_named_float("Value", value, error);
+}
+
 SepString *cast_as_named_str(char *name, SepV value, SepV *error) {
 	if (sepv_is_exception(value))
 		fail(NULL, value);
@@ -79,6 +85,16 @@ SepInt cast_as_named_int(char *name, SepV value, SepV *error) {
 		return sepv_to_int(value);
 }
 
+SepFloat cast_as_named_float(char *name, SepV value, SepV *error) {
+	if (sepv_is_exception(value))
+		fail(0.0, value);
+	if (sepv_is_float(value))
+		return sepv_to_float(value);
+	if (sepv_is_integer(value))
+		return bigint_to_float(value);
+	fail(0.0, exception(exc.EWrongType, "%s is supposed to be a number.", name));
+}
+
 // ===============================================================
 //  Operating on properties
 // ===============================================================
@@ -188,10 +204,7 @@ SepV call_method(SepVM *vm, SepV host, char *name, int argument_count, ...) {
 // Checks whether the given value is an ENoMoreElements exception (useful in iteration).
 bool sepv_is_no_more_elements(SepVM *vm, SepV value) {
 	if (!sepv_is_exception(value)) return false;
-	SepV enomoreelements_v = obj_to_sepv(exc.ENoMoreElements);
-	SepV is_no_more_elements_v = call_method(vm, value, "is",
-			1, enomoreelements_v);
-	return is_no_more_elements_v == SEPV_TRUE;
+	return sepv_is_instance(value, obj_to_sepv(exc.ENoMoreElements));
 }
 
 
@@ -199,6 +212,39 @@ bool sepv_is_no_more_elements(SepVM *vm, SepV value) {
 //  Classes and prototypes
 // ===============================================================
 
+// Creates the 'display' of a class - an array of the class and all its
+// superclasses, starting with the root of the hierarchy. A class at depth N
+// is at index N in the displays of all its subclasses, so checking whether
+// one class inherits from another takes a single comparison.
+SepArray *make_class_display(SepObj *cls) {
+	// gather the class and its superclasses
+	SepArray *display = array_create(4);
+	SepV ancestor = obj_to_sepv(cls);
+	while (ancestor != SEPV_NOTHING && ancestor != SEPV_NO_VALUE && !sepv_is_exception(ancestor)) {
+		array_push(display, ancestor);
+		ancestor = sepv_lenient_get(ancestor, lsvm_globals.superclass_property);
+	}
+
+	// reverse them to put the root first
+	uint32_t front = 0, back = array_length(display) - 1;
+	for (; front < back; front++, back--) {
+		SepV swapped = array_get(display, front);
+		array_set(display, front, array_get(display, back));
+		array_set(display, back, swapped);
+	}
+	return display;
+}
+
+// Finds the display of a class, if it has one.
+SepArray *class_display(SepV cls) {
+	if (!sepv_is_obj(cls))
+		return NULL;
+	Slot *slot = props_find_prop(sepv_to_obj(cls), lsvm_globals.ancestors_property);
+	if (!slot || !sepv_is_array(slot->value))
+		return NULL;
+	return sepv_to_array(slot->value);
+}
+
 // Creates a new class with the given name and parent class.
 // The Class object must be already available in the runtime.
 SepObj *make_class(char *name, SepObj *parent) {
@@ -213,6 +259,7 @@ SepObj *make_class(char *name, SepObj *parent) {
 	obj_add_field(cls, "<name>", str_to_sepv(sepstr_for(name)));
 	obj_add_field(cls, "<class>", obj_to_sepv(cls));
 	obj_add_field(cls, "<superclass>", parent_v);
+	obj_add_field(cls, "<ancestors>", obj_to_sepv(make_class_display(cls)));
 
 	// copy properties from the Class master object
 	SepV call_v = property(obj_to_sepv(rt.Cls), "<call>");
@@ -222,6 +269,34 @@ SepObj *make_class(char *name, SepObj *parent) {
 	return cls;
 }
 
+// Checks whether an object belongs to a class, directly or through one of
+// the subclasses. This is the test behind Object.is().
+bool sepv_is_instance(SepV object, SepV desired_class) {
+	SepV actual_class = sepv_lenient_get(object, lsvm_globals.class_property);
+	if (actual_class == SEPV_NO_VALUE || sepv_is_exception(actual_class))
+		return false;
+	if (actual_class == desired_class)
+		return true;
+
+	// classes created by make_class() can be compared using their displays
+	SepArray *actual_display = class_display(actual_class);
+	SepArray *desired_display = class_display(desired_class);
+	if (actual_display && desired_display) {
+		uint32_t depth = array_length(desired_display) - 1;
+		return (depth < array_length(actual_display)) &&
+				(array_get(actual_display, depth) == desired_class);
+	}
+
+	// otherwise, walk the chain of superclasses
+	while (true) {
+		actual_class = sepv_lenient_get(actual_class, lsvm_globals.superclass_property);
+		if (actual_class == SEPV_NO_VALUE || actual_class == SEPV_NOTHING || sepv_is_exception(actual_class))
+			return false;
+		if (actual_class == desired_class)
+			return true;
+	}
+}
+
 // Checks whether a given object has another among its prototypes (or grand-prototypes).
 bool has_prototype(SepV object, SepV requested) {
 	SepV proto = sepv_prototypes(object);
@@ -234,7 +309,7 @@ bool has_prototype(SepV object, SepV requested) {
 			return true;
 		// recurse
 		if (proto != object)
-			return has_prototype(proto, object);
+			return has_prototype(proto, requested);
 	}
 
 	if (sepv_is_array(proto)) {
@@ -26,10 +26,11 @@
 // ===============================================================
 
 // Macros for use in functions returning exceptions directly through a SepItem or SepV
-#define or_raise(subcall_result) if (sepv_is_exception(subcall_result)) { return item_rvalue(subcall_result); }
-#define or_raise_sepv(subcall_result) if (sepv_is_exception(subcall_result)) { return subcall_result; }
-#define raise(exc_type, ...) return si_exception(exc_type, sepstr_sprintf(__VA_ARGS__));
-#define raise_sepv(exc_type, ...) return sepv_exception(exc_type, sepstr_sprintf(__VA_ARGS__));
+// - 'break' and 'continue' signals coming out of subcalls are passed on just the same
+#define or_raise(subcall_result) if (sepv_is_exception(subcall_result) || sepv_is_signal(subcall_result)) { return item_rvalue(subcall_result); }
+#define or_raise_sepv(subcall_result) if (sepv_is_exception(subcall_result) || sepv_is_signal(subcall_result)) { return subcall_result; }
+#define raise(exc_type, ...) return si_exceptionf(exc_type, __VA_ARGS__);
+#define raise_sepv(exc_type, ...) return sepv_exceptionf(exc_type, __VA_ARGS__);
 
 // Macros for use in functions that return exception through a SepV *error output parameter
 #define or_fail() ; if (sepv_is_exception(err)) { *error = err; return; };
@@ -51,6 +52,7 @@
 #define target_as_obj(scope, err_ptr) _target_as(scope, obj, err_ptr)
 #define target_as_func(scope, err_ptr) _target_as(scope, func, err_ptr)
 #define target_as_int(scope, err_ptr) _target_as(scope, int, err_ptr)
+#define target_as_float(scope, err_ptr) _target_as(scope, float, err_ptr)
 #define _target_as(scope, desired_type, err_ptr) cast_as_named_##desired_type("Target object", target(scope), err_ptr)
 
 #define param(scope, param_name) (props_get_prop(scope, sepstr_for(param_name)))
@@ -58,6 +60,7 @@
 #define param_as_obj(scope, param_name, err_ptr) _param_as(scope, param_name, obj, err_ptr)
 #define param_as_func(scope, param_name, err_ptr) _param_as(scope, param_name, func, err_ptr)
 #define param_as_int(scope, param_name, err_ptr) _param_as(scope, param_name, int, err_ptr)
+#define param_as_float(scope, param_name, err_ptr) _param_as(scope, param_name, float, err_ptr)
 
 #define _param_as(scope, param_name, desired_type, err_ptr) cast_as_named_##desired_type("Parameter '" param_name "'", param(scope, param_name), err_ptr)
 
@@ -69,11 +72,14 @@ SepString *cast_as_str(SepV value, SepV *error);
 SepObj *cast_as_obj(SepV value, SepV *error);
 SepFunc *cast_as_func(SepV value, SepV *error);
 SepInt cast_as_int(SepV value, SepV *error);
+// Accepts both floats and integers, converting the latter.
+SepFloat cast_as_float(SepV value, SepV *error);
 
 SepString *cast_as_named_str(char *name, SepV value, SepV *error);
 SepObj *cast_as_named_obj(char *name, SepV value, SepV *error);
 SepFunc *cast_as_named_func(char *name, SepV value, SepV *error);
 SepInt cast_as_named_int(char *name, SepV value, SepV *error);
+SepFloat cast_as_named_float(char *name, SepV value, SepV *error);
 
 // ===============================================================
 //  Classes
@@ -105,6 +111,9 @@ bool property_exists(SepV host, char *name);
 
 // Checks whether a given object has another among its prototypes (or grand-prototypes).
 bool has_prototype(SepV object, SepV prototype);
+// Checks whether an object belongs to a class, directly or through one of
+// the subclasses. Works without calling any September code.
+bool sepv_is_instance(SepV object, SepV desired_class);
 
 // Calls a method from a SepV and returns the return value. Any problems
 // (the method not being there, the property not being callable) are
@@ -136,7 +145,7 @@ void obj_add_escape(SepObj *obj, char *name, ExecutionFrame *return_to_frame, Se
 //  Exceptions
 // ===============================================================
 
-#define exception(type, ...) sepv_exception(type, sepstr_sprintf(__VA_ARGS__))
+#define exception(type, ...) sepv_exceptionf(type, __VA_ARGS__)
 
 // ===============================================================
 //  Escape functions
@@ -21,6 +21,9 @@
 #include "mem.h"
 #include "types.h"
 #include "objects.h"
+#include "arrays.h"
+#include "maps.h"
+#include "vm.h"
 
 // ===============================================================
 //  L-values and R-values
@@ -44,6 +47,18 @@ SepItem item_artificial_lvalue(Slot *slot, SepV value) {
 	return item;
 }
 
+// Creates a new index l-value stack item, representing an element of an array.
+SepItem item_index_lvalue(SepV array, uint32_t index, SepV value) {
+	SepItem item = {SIT_INDEX_LVALUE, NULL, {array, int_to_sepv(index), NULL}, value};
+	return item;
+}
+
+// Creates a new index l-value stack item, representing the value stored under a key in a map.
+SepItem item_key_lvalue(SepV map, SepV key, SepV value) {
+	SepItem item = {SIT_INDEX_LVALUE, NULL, {map, key, NULL}, value};
+	return item;
+}
+
 // Retrieves the slot reference stored within the item. This is the only safe way to access it, as sometimes
 // the pointer inside the struct itself might be stale and need a fix-up operation.
 Slot* item_slot(SepItem *item) {
@@ -51,7 +66,7 @@ Slot* item_slot(SepItem *item) {
 		// let's see if the slot still falls inside the property map of the owner
 		SepObj *owner_obj = sepv_to_obj(item->origin.owner);
 		void *start = owner_obj->props.entries;
-		void *end = start + owner_obj->props.capacity * 2;
+		void *end = owner_obj->props.entries + owner_obj->props.count;
 		void *slot = item->slot;
 		if ((slot < start) || (slot >= end)) {
 			// out of bounds - recalculate pointer using property information
@@ -64,6 +79,19 @@ Slot* item_slot(SepItem *item) {
 	return item->slot;
 }
 
+// Stores a new value in the place an l-value item came from, returning the
+// value stored or an exception.
+SepV item_store(SepItem *item, SepV value) {
+	if (item->type == SIT_INDEX_LVALUE) {
+		// no slot - the container and index are stored in the item itself
+		if (sepv_is_map(item->origin.source))
+			return map_put(sepv_to_map(item->origin.source), vm_current(), item->origin.owner, value);
+		SepArray *array = sepv_to_array(item->origin.source);
+		return array_set(array, sepv_to_int(item->origin.owner), value);
+	}
+	return slot_store(item_slot(item), &item->origin, value);
+}
+
 // ===============================================================
 //  Booleans
 // ===============================================================
@@ -83,3 +111,11 @@ SepItem si_bool(bool truth) {
 SepItem si_int(SepInt integer) {
 	return item_rvalue(int_to_sepv(integer));
 }
+
+// ===============================================================
+//  Floats
+// ===============================================================
+
+SepItem si_float(SepFloat number) {
+	return item_rvalue(float_to_sepv(number));
+}
@@ -47,7 +47,12 @@ typedef enum SepItemType {
 	// specific rules about assignment. For example, array indexing
 	// (a[2]) returns a special l-value that directs stores back
 	// into the array element.
-	SIT_ARTIFICIAL_LVALUE = 2
+	SIT_ARTIFICIAL_LVALUE = 2,
+	// Index l-values represent an element of an array or a map. The
+	// container and the index (or key) are stored directly in the item
+	// (in origin.source and origin.owner, respectively), so no slot has
+	// to be allocated.
+	SIT_INDEX_LVALUE = 3
 } SepItemType;
 
 /**
@@ -89,10 +94,17 @@ SepItem item_rvalue(SepV value);
 SepItem item_property_lvalue(SepV slot_owner, SepV accessed_through, struct SepString *property_name, struct Slot *slot, SepV value);
 // Creates a new artificial l-value stack item - the slot has to be a standalone managed object.
 SepItem item_artificial_lvalue(struct Slot *slot, SepV value);
+// Creates a new index l-value stack item, representing an element of an array.
+SepItem item_index_lvalue(SepV array, uint32_t index, SepV value);
+// Creates a new index l-value stack item, representing the value stored under a key in a map.
+SepItem item_key_lvalue(SepV map, SepV key, SepV value);
 
 // Retrieves the slot reference stored within the item. This is the only safe way to access it, as sometimes
 // the pointer inside the struct itself might be stale and need a fix-up operation.
 struct Slot* item_slot(SepItem *item);
+// Stores a new value in the place an l-value item came from, returning the
+// value stored or an exception.
+SepV item_store(SepItem *item, SepV value);
 
 // Checks if an item is an l-value and can be assigned to.
 #define item_is_lvalue(item) (item.type != SIT_RVALUE)
@@ -109,8 +121,8 @@ struct Slot* item_slot(SepItem *item);
 // integers: 61-bit signed integers
 #define SEPV_TYPE_INT     (0ull << 61)
 
-// floats: truncated IEEE 64-bit double precision floats
-// (3 least significant digits lost)
+// floats: unboxed IEEE 64-bit double precision floats, with the
+// exponent range narrowed to 8 bits (see 'Floats' below)
 #define SEPV_TYPE_FLOAT   (1ull << 61)
 
 // strings: shifted pointer to a SepStr
@@ -154,13 +166,11 @@ struct Slot* item_slot(SepItem *item);
 // a special object that possesses all possible properties, and
 // the value of each property is simply its name
 #define SEPV_LITERALS (SEPV_TYPE_SPECIAL | 0x04)
-// a special marker pushed on the stack to mark the place to which
-// the data stack has to be cleared in case of an exception being
-// thrown
-#define SEPV_UNWIND_MARKER (SEPV_TYPE_SPECIAL | 0x05)
-// return value used by the "break" function to signify breaking
-// out of the loop
+// return values used by "break" and "continue" to signal the loop
+// whose body they finished - native code passes them on like exceptions,
+// and they are never visible to September code
 #define SEPV_BREAK (SEPV_TYPE_SPECIAL | 0x06)
+#define SEPV_CONTINUE (SEPV_TYPE_SPECIAL | 0x08)
 // an internal special value used to signify "no SEPV was passed in"
 // different than SEPV_NOTHING, as Nothing is a real object that
 // can be passed to a function (unlike SEPV_NO_VALUE).
@@ -183,6 +193,34 @@ typedef int64_t SepInt;
 
 SepItem si_int(SepInt integer);
 
+// ===============================================================
+//  Floats
+// ===============================================================
+
+typedef double SepFloat;
+
+/**
+ * Floats are stored directly inside the SepV, without any allocation.
+ * A double has 64 bits and we only have 61, so the 3 bits are taken
+ * out of the exponent - the mantissa is kept whole and every float
+ * with a (binary) exponent between -126 and 128 is stored losslessly.
+ * This covers magnitudes from roughly 1e-38 to 1e38.
+ *
+ * The 61 bits of the value are laid out as follows:
+ *   [60..53] exponent, rebased so that 2^-127 is 0
+ *   [52..1]  mantissa, as in the IEEE double
+ *   [0]      sign
+ * With this layout, encoding and decoding are a few shifts and an add.
+ * Both zeroes are special-cased (the bit patterns for 2^-127 are used
+ * for them), anything smaller than the range is flushed to zero.
+ * Infinities, NaNs and numbers too big for the range cannot be stored,
+ * and the operations producing them raise ENumericOverflow instead.
+ */
+#define SEPV_FLOAT_EXPONENT_BIAS (896ull << 52)
+#define SEPV_FLOAT_MAX_EXPONENT 1151
+
+SepItem si_float(SepFloat number);
+
 // ===============================================================
 //  Type conversions and type tests
 // ===============================================================
@@ -204,6 +242,39 @@ SepItem si_int(SepInt integer);
 #define sepv_to_int(v) ((((int64_t)v) << 3) >> 3)
 #define int_to_sepv(v) ((SepV)((SepInt)v) & (~SEPV_TYPE_MASK))
 
+// Floats
+#define sepv_is_float(v) sepv_is(v, SEPV_TYPE_FLOAT)
+
+typedef union { SepFloat number; uint64_t bits; } _SepFloatBits;
+
+// Checks whether a float can be stored in a SepV - false for infinities,
+// NaNs and numbers with an exponent too large.
+static inline bool float_fits_sepv(SepFloat number) {
+	_SepFloatBits f = {number};
+	return ((f.bits >> 52) & 0x7ff) <= SEPV_FLOAT_MAX_EXPONENT;
+}
+
+// Converts a float to a SepV. Numbers too small for the exponent range are
+// flushed to zero, numbers too big have to be rejected with float_fits_sepv().
+static inline SepV float_to_sepv(SepFloat number) {
+	_SepFloatBits f = {number};
+	uint64_t sign = f.bits >> 63;
+	uint64_t magnitude = f.bits & ~(1ull << 63);
+	if (magnitude <= SEPV_FLOAT_EXPONENT_BIAS)
+		return SEPV_TYPE_FLOAT | sign;
+	return SEPV_TYPE_FLOAT | ((magnitude - SEPV_FLOAT_EXPONENT_BIAS) << 1) | sign;
+}
+
+static inline SepFloat sepv_to_float(SepV value) {
+	uint64_t payload = value & SEPV_VALUE_MASK;
+	_SepFloatBits f;
+	if (payload <= 1)
+		f.bits = payload << 63;
+	else
+		f.bits = ((payload >> 1) + SEPV_FLOAT_EXPONENT_BIAS) | (payload << 63);
+	return f.number;
+}
+
 // Strings
 #define sepv_is_str(v)  sepv_is(v, SEPV_TYPE_STRING)
 #define sepv_to_str(v)  sepv_to_typed_pointer(v,struct SepString)
@@ -227,6 +298,13 @@ SepItem si_int(SepInt integer);
 // Exceptions
 #define sepv_is_exception(v) sepv_is(v, SEPV_TYPE_EXCEPTION)
 
+// Checks for the signals 'break' and 'continue' finish frames with on their
+// way to the loop. Native code has to stop and pass them on, the same way
+// it does with exceptions.
+static inline bool sepv_is_signal(SepV value) {
+	return (value == SEPV_BREAK) || (value == SEPV_CONTINUE);
+}
+
 #define exception_to_obj_sepv(val) (((val) & (~SEPV_TYPE_MASK)) | SEPV_TYPE_OBJECT)
 #define obj_sepv_to_exception(obj) (((val) & (~SEPV_TYPE_MASK)) | SEPV_TYPE_EXCEPTION)
 #define obj_to_exception(obj) (SEPV_TYPE_EXCEPTION | (((intptr_t)obj) >> 3))
@@ -93,6 +93,38 @@ SepVM *vm_create(SepModule *module) {
 	return vm;
 }
 
+// Looks for an exception handler in the frames belonging to the current run
+// of the VM, innermost first. If one is found, everything above it is dropped
+// and execution continues from its catch clauses.
+static bool vm_catch(SepVM *this, int starting_depth, SepV exception) {
+	int depth;
+	for (depth = this->frame_depth; depth >= starting_depth; depth--) {
+		ExecutionFrame *frame = &this->frames[depth];
+		if (!frame->handler_depth)
+			continue;
+
+		// found one - it's used up once it catches something
+		ExceptionHandler *handler = &frame->handlers[--frame->handler_depth];
+		log("vm", "(%d) Exception caught by a handler in frame (%d).", this->frame_depth, depth);
+
+		// drop all the frames above it and whatever they left on the stack
+		this->frame_depth = depth;
+		stack_truncate(this->data, handler->stack_depth);
+		ga_truncate(&frame->gc_roots, handler->gc_roots_mark);
+		frame->loop_depth = handler->loop_depth;
+		frame->locals = handler->scope;
+
+		// continue from the catch clauses, with the exception on the stack
+		frame->instruction_ptr = handler->handler;
+		frame->finished = false;
+		frame->called_another_frame = false;
+		frame->return_value = item_rvalue(SEPV_NOTHING);
+		stack_push_rvalue(this->data, exception);
+		return true;
+	}
+	return false;
+}
+
 SepItem vm_run(SepVM *this) {
 	// sanity check - one VM allowed per thread
 	SepVM *previously_running = lsvm_globals.set_vm_for_current_thread(this);
@@ -105,9 +137,8 @@ SepItem vm_run(SepVM *this) {
 	// we stop execution and return the last return value
 	int starting_depth = this->frame_depth;
 
-	// mark our place on the stack so that we can unwind it properly
-	// when exception is thrown
-	stack_push_rvalue(this->data, SEPV_UNWIND_MARKER);
+	// everything the frames in this run leave on the stack goes above this
+	this->frames[starting_depth].stack_base = stack_depth(this->data);
 
 	// repeat until we have a return value ready
 	// (a break handles this from inside the body)
@@ -127,8 +158,8 @@ SepItem vm_run(SepVM *this) {
 			// move down the stack
 			// the call operation itself has already filled in the next frame
 			this->frame_depth++;
-			// put an unwind marker on the stack
-			stack_push_rvalue(this->data, SEPV_UNWIND_MARKER);
+			// its part of the data stack starts here
+			this->frames[this->frame_depth].stack_base = stack_depth(this->data);
 
 			log("vm", "(%d) New execution frame created (interpreted call).", this->frame_depth);
 		}
@@ -137,23 +168,18 @@ SepItem vm_run(SepVM *this) {
 		if (current_frame->finished) {
 			// with an exception?
 			if (sepv_is_exception(current_frame->return_value.value)) {
+				// can one of the frames in this run handle it?
+				if (vm_catch(this, starting_depth, current_frame->return_value.value))
+					continue;
+
 				log("vm", "(%d) Execution frame finished with exception.", this->frame_depth);
 				log("vm", "Unwinding to level (%d).", starting_depth);
 
-				int frames_to_unwind = this->frame_depth - starting_depth + 1;
-
-				// drop all the frames from this VM run
+				// drop all the frames from this VM run, along with whatever
+				// they left on the stack
+				stack_truncate(this->data, this->frames[starting_depth].stack_base);
 				this->frame_depth = starting_depth - 1;
 
-				// clear data from the stack
-				while (frames_to_unwind > 0) {
-					SepItem stack_item = stack_pop_item(this->data);
-					if (sepv_is_exception(stack_item.value))
-						return stack_item;
-					if (stack_item.value == SEPV_UNWIND_MARKER)
-						frames_to_unwind--;
-				}
-
 				// and pass the exception to the authorities
 				goto cleanup_and_return;
 			}
@@ -161,18 +187,10 @@ SepItem vm_run(SepVM *this) {
 			// nope, just a normal return
 			log("vm", "(%d) Execution frame finished normally.", this->frame_depth);
 
-			// pop the frame
+			// pop the frame, along with anything a 'break' or 'return' left
+			// on the stack
+			stack_truncate(this->data, current_frame->stack_base);
 			this->frame_depth--;
-			// unwind the stack (usually it will be just the unwind marker, but in
-			// case of a 'break' or 'return' it might be more items)
-			SepItem stack_item = stack_pop_item(this->data);
-			while (stack_item.value != SEPV_UNWIND_MARKER) {
-				if (sepv_is_exception(stack_item.value)) {
-					// something went horribly wrong
-					return stack_item;
-				}
-				stack_item = stack_pop_item(this->data);
-			}
 
 			// push the return value on the data stack for its parent
 			if (this->frame_depth >= starting_depth) {
@@ -199,11 +217,16 @@ void vm_initialize_root_frame(SepVM *this, SepModule *module) {
 	// setup the frame
 	frame->vm = this;
 	frame->data = this->data;
+	frame->stack_base = stack_depth(this->data);
 	frame->return_value = item_rvalue(SEPV_NOTHING);
 	frame->finished = false;
 	frame->called_another_frame = false;
+	frame->runs_loop_body = false;
+	frame->loop_depth = 0;
+	frame->handler_depth = 0;
 	frame->module = module;
 	frame->instruction_ptr = NULL;
+	frame->block = NULL;
 	frame->prev_frame = NULL;
 	frame->next_frame = &this->frames[1];
 
@@ -271,9 +294,13 @@ void vm_initialize_frame(SepVM *this, ExecutionFrame *frame, SepFunc *func) {
 	frame->vm = this;
 	frame->function = func;
 	frame->data = this->data;
+	frame->stack_base = stack_depth(this->data);
 	frame->return_value = item_rvalue(SEPV_NOTHING);
 	frame->finished = false;
 	frame->called_another_frame = false;
+	frame->runs_loop_body = false;
+	frame->loop_depth = 0;
+	frame->handler_depth = 0;
 	frame->locals = SEPV_NOTHING; // for now
 
 	// frames are contiguous in memory, so the next frame is right after
@@ -283,6 +310,7 @@ void vm_initialize_frame(SepVM *this, ExecutionFrame *frame, SepFunc *func) {
 	// we don't know the right values, but the function will initialize
 	// those fields on its own if it cares about them
 	frame->instruction_ptr = NULL;
+	frame->block = NULL;
 	frame->module = NULL;
 
 	// empty the additional GC root table
@@ -328,24 +356,27 @@ void vm_queue_gc_roots(GarbageCollection *gc) {
 		return;
 
 	// queue all items from the data stack
-	GenericArrayIterator sit = ga_iterate_over(&vm->data->array);
-	while (!gait_end(&sit)) {
-		SepItem stack_item = *((SepItem*)gait_current(&sit));
-
+	SepStack *stack = vm->data;
+	StackEntry *entry;
+	for (entry = stack->entries; entry < stack->top; entry++) {
 		// the value gets added regardless of slot type
-		gc_add_to_queue(gc, stack_item.value);
+		gc_add_to_queue(gc, entry->value);
 
 		// l-values hold additional references
-		if (stack_item.type == SIT_ARTIFICIAL_LVALUE) {
-			gc_add_to_queue(gc, slot_to_sepv(stack_item.slot));
-		} else if (stack_item.type == SIT_PROPERTY_LVALUE) {
-			gc_add_to_queue(gc, stack_item.origin.owner);
-			gc_add_to_queue(gc, stack_item.origin.source);
-			gc_add_to_queue(gc, str_to_sepv(stack_item.origin.property));
+		if (entry->type == SIT_RVALUE)
+			continue;
+		StackOrigin *origin = &stack->origins[entry->origin];
+		if (entry->type == SIT_ARTIFICIAL_LVALUE) {
+			gc_add_to_queue(gc, slot_to_sepv(origin->slot));
+		} else if (entry->type == SIT_PROPERTY_LVALUE) {
+			gc_add_to_queue(gc, origin->origin.owner);
+			gc_add_to_queue(gc, origin->origin.source);
+			gc_add_to_queue(gc, str_to_sepv(origin->origin.property));
+		} else if (entry->type == SIT_INDEX_LVALUE) {
+			// the owner is the index or the map key
+			gc_add_to_queue(gc, origin->origin.source);
+			gc_add_to_queue(gc, origin->origin.owner);
 		}
-
-		// next!
-		gait_advance(&sit);
 	}
 
 	// queue everything accessible from the execution frames
@@ -356,6 +387,17 @@ void vm_queue_gc_roots(GarbageCollection *gc) {
 		gc_add_to_queue(gc, frame->locals);
 		gc_add_to_queue(gc, frame->return_value.value);
 
+		// loops running inside the frame
+		int l;
+		for (l = 0; l < frame->loop_depth; l++) {
+			InlineLoop *loop = &frame->loops[l];
+			gc_add_to_queue(gc, loop->outer_scope);
+			gc_add_to_queue(gc, loop->iterator);
+			gc_add_to_queue(gc, loop->iteration.next);
+		}
+		for (l = 0; l < frame->handler_depth; l++)
+			gc_add_to_queue(gc, frame->handlers[l].scope);
+
 		// additional GC roots - objects allocated by this frame
 		GenericArrayIterator rit = ga_iterate_over(&frame->gc_roots);
 		while (!gait_end(&rit)) {
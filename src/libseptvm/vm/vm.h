@@ -21,6 +21,7 @@
 #include "arrays.h"
 #include "stack.h"
 #include "module.h"
+#include "iterators.h"
 
 // ===============================================================
 //  Pre-defining structs
@@ -38,11 +39,60 @@ struct ArgumentSource;
 
 // the maximum call depth allowed - the number of execution frames per VM
 #define VM_FRAME_COUNT 1024
+// the maximum number of loops compiled into one function that can be nested
+// inside each other (the compiler falls back to calling 'while'/'for' deeper)
+#define VM_INLINE_LOOP_DEPTH 8
+// the maximum number of try..catch statements compiled into one function that
+// can be nested inside each other
+#define VM_HANDLER_DEPTH 8
 
 // ===============================================================
 //  Execution frame
 // ===============================================================
 
+/**
+ * A loop compiled directly into a function's code (instead of being run by
+ * the 'while' or 'for' built-in). The body runs in the same frame, in its own
+ * scope, and 'break'/'continue' just move the instruction pointer.
+ */
+typedef struct InlineLoop {
+	// where 'continue' and 'break' continue execution from
+	CodeUnit *next;
+	CodeUnit *exit;
+	// the scope the loop was started in, restored when it ends
+	SepV outer_scope;
+	// the depth of the data stack when the loop started
+	uint32_t stack_depth;
+	// the number of GC roots the frame had when the loop started
+	uint32_t gc_roots_mark;
+	// the number of exception handlers active when the loop started
+	uint8_t handler_depth;
+	// for..in loops only - the loop variable and the iteration over the collection
+	SepString *variable;
+	SepV iterator;
+	SepIteration iteration;
+} InlineLoop;
+
+/**
+ * An exception handler registered by a try..catch compiled into a function.
+ * Nothing happens to it unless an exception is actually thrown - then the
+ * VM finds the innermost handler, drops everything that was pushed after it
+ * was registered, and continues from the catch clauses with the exception on
+ * the stack.
+ */
+typedef struct ExceptionHandler {
+	// where the catch clauses start
+	CodeUnit *handler;
+	// the scope the try statement was in
+	SepV scope;
+	// the depth of the data stack when the handler was registered
+	uint32_t stack_depth;
+	// the number of GC roots the frame had at that point
+	uint32_t gc_roots_mark;
+	// the number of inline loops running at that point
+	uint8_t loop_depth;
+} ExceptionHandler;
+
 typedef struct ExecutionFrame {
 	// the VM responsible for this frame
 	struct SepVM *vm;
@@ -50,6 +100,8 @@ typedef struct ExecutionFrame {
 	SepModule *module;
 	// function for this frame
 	SepFunc *function;
+	// the code block being executed (NULL for built-ins)
+	CodeBlock *block;
 	// instruction pointer
 	CodeUnit *instruction_ptr;
 	// the data stack accessed by VM operations
@@ -62,6 +114,18 @@ typedef struct ExecutionFrame {
 	bool finished;
 	// execution called into another frame?
 	bool called_another_frame;
+	// set by loops while their body is running in the next frame - 'break'
+	// and 'continue' finish all frames up to that body
+	bool runs_loop_body;
+	// the depth of the data stack when the frame started running - whatever
+	// is above it belongs to the frame and goes away when the frame finishes
+	uint32_t stack_base;
+	// loops currently running in this frame's own code, innermost last
+	InlineLoop loops[VM_INLINE_LOOP_DEPTH];
+	uint8_t loop_depth;
+	// exception handlers registered by the frame's code, innermost last
+	ExceptionHandler handlers[VM_HANDLER_DEPTH];
+	uint8_t handler_depth;
 
 	// an array of objects allocated in this frame
 	// all objects allocated within a frame have to be kept until
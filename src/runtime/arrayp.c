@@ -13,124 +13,407 @@
 //  Includes
 // ===============================================================
 
+#include <string.h>
 #include "common.h"
+#include "../libseptvm/common/sorting.h"
 
 // ===============================================================
-//  Iteration
+//  Numeric kernels
 // ===============================================================
 
-// Creates a new iterator for a given array.
-SepItem array_iterator(SepObj *scope, ExecutionFrame *frame) {
-	SepArray *this = sepv_to_array(target(scope));
+/**
+ * The low-level loops behind the numeric methods, working directly on
+ * the storage of packed arrays. There is a portable scalar version of
+ * each, and on x86 also an AVX2 version - the best set the CPU supports
+ * is picked when the prototype is created. Float sums use four
+ * interleaved accumulators in both versions, so the results don't depend
+ * on which set was picked.
+ */
 
-	SepV iterator_proto_v = property(obj_to_sepv(this), "<ArrayIterator>");
-	SepObj *iterator_obj = obj_create_with_proto(iterator_proto_v);
+typedef enum ArithOp { ARITH_PLUS, ARITH_MINUS, ARITH_TIMES } ArithOp;
+typedef enum CompareOp { COMPARE_LESS, COMPARE_GREATER, COMPARE_EQUAL } CompareOp;
 
-	// add a reference to the array to prevent it from being GC'd while we iterate
-	obj_add_field(iterator_obj, "<array>", obj_to_sepv(this));
+typedef struct ArrayKernels {
+	// sums integers, split into the sums of their upper and lower 32 bits -
+	// INT_BIAS is added to each element first to make it non-negative
+	void (*sum_ints)(const int64_t *a, size_t n, uint64_t *high, uint64_t *low);
+	// finds the smallest and largest integer (n > 0)
+	void (*minmax_ints)(const int64_t *a, size_t n, int64_t *min, int64_t *max);
+	// combines integers elementwise ('b' points to a single value if b_scalar is set),
+	// returns false if any of the results doesn't fit in a SepV
+	bool (*arith_ints)(int64_t *out, const int64_t *a, const int64_t *b, bool b_scalar, size_t n, ArithOp op);
+	// compares integers elementwise, storing True or False for each
+	void (*compare_ints)(SepV *out, const int64_t *a, const int64_t *b, bool b_scalar, size_t n, CompareOp op);
+	// sums floats
+	double (*sum_floats)(const double *a, size_t n);
+	// calculates the dot product of two float vectors
+	double (*dot_floats)(const double *a, const double *b, size_t n);
+	// finds the smallest and largest float (n > 0)
+	void (*minmax_floats)(const double *a, size_t n, double *min, double *max);
+	// combines floats elementwise
+	void (*arith_floats)(double *out, const double *a, const double *b, bool b_scalar, size_t n, ArithOp op);
+	// compares floats elementwise, storing True or False for each
+	void (*compare_floats)(SepV *out, const double *a, const double *b, bool b_scalar, size_t n, CompareOp op);
+} ArrayKernels;
 
-	// create the C iterator and store as auxillary data
-	iterator_obj->data = mem_allocate(sizeof(SepArrayIterator));
-	*((SepArrayIterator*)iterator_obj->data) = array_iterate_over(this);
+// the kernels chosen for the current CPU
+ArrayKernels array_kernels;
 
-	// return the iterator object
-	return si_obj(iterator_obj);
+// added to integers to make them non-negative, see sum_ints
+#define INT_BIAS (1ull << 60)
+
+// === scalar versions
+
+void sum_ints_scalar(const int64_t *a, size_t n, uint64_t *high, uint64_t *low) {
+	uint64_t h = 0, l = 0;
+	size_t i;
+	for (i = 0; i < n; i++) {
+		uint64_t biased = (uint64_t)a[i] + INT_BIAS;
+		h += biased >> 32;
+		l += biased & 0xffffffffull;
+	}
+	*high = h;
+	*low = l;
 }
 
-// Actual iteration over the array
-SepItem arrayiterator_next(SepObj *scope, ExecutionFrame *frame) {
-	SepV err = SEPV_NOTHING;
+void minmax_ints_scalar(const int64_t *a, size_t n, int64_t *min, int64_t *max) {
+	int64_t lo = a[0], hi = a[0];
+	size_t i;
+	for (i = 1; i < n; i++) {
+		lo = (a[i] < lo) ? a[i] : lo;
+		hi = (a[i] > hi) ? a[i] : hi;
+	}
+	*min = lo;
+	*max = hi;
+}
 
-	// extract the iterator from the object
-	SepObj *target = target_as_obj(scope, &err);
-		or_raise(err);
-	SepArrayIterator *iterator = target->data;
+bool arith_ints_scalar(int64_t *out, const int64_t *a, const int64_t *b, bool b_scalar, size_t n, ArithOp op) {
+	uint64_t out_of_range = 0;
+	size_t i;
+	for (i = 0; i < n; i++) {
+		int64_t x = a[i], y = b_scalar ? b[0] : b[i], r;
+		switch(op) {
+			case ARITH_PLUS: r = x + y; break;
+			case ARITH_MINUS: r = x - y; break;
+			default:
+				if (__builtin_mul_overflow(x, y, &r))
+					return false;
+		}
+		// (r + 2^60) is below 2^61 exactly when r fits
+		out_of_range |= ((uint64_t)r + INT_BIAS) >> 61;
+		out[i] = r;
+	}
+	return !out_of_range;
+}
 
-	// end of iteration?
-	if (arrayit_end(iterator))
-		return si_exception(exc.ENoMoreElements, sepstr_for("No more elements."));
+// Evaluates a comparison between two numbers of any type.
+#define COMPARE(op, x, y) (((op) == COMPARE_LESS) ? ((x) < (y)) : (((op) == COMPARE_GREATER) ? ((x) > (y)) : ((x) == (y))))
 
-	// nope, return element
-	SepV element = arrayit_next(iterator);
-	return item_rvalue(element);
+void compare_ints_scalar(SepV *out, const int64_t *a, const int64_t *b, bool b_scalar, size_t n, CompareOp op) {
+	size_t i;
+	for (i = 0; i < n; i++)
+		out[i] = SEPV_FALSE + COMPARE(op, a[i], b_scalar ? b[0] : b[i]);
 }
 
-SepItem array_fromiterator(SepObj *scope, ExecutionFrame *frame) {
-	SepV iterator = param(scope, "iterator");
-	SepArray *array = array_create(1);
-	while (true) {
-		SepV element = call_method(frame->vm, iterator, "next", 0);
-		if (sepv_is_no_more_elements(frame->vm, element))
-			return si_obj(array);
-		or_raise(element);
-		array_push(array, element);
+double sum_floats_scalar(const double *a, size_t n) {
+	double lanes[4] = {0.0, 0.0, 0.0, 0.0};
+	size_t i;
+	for (i = 0; i < n; i++)
+		lanes[i & 3] += a[i];
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+double dot_floats_scalar(const double *a, const double *b, size_t n) {
+	double lanes[4] = {0.0, 0.0, 0.0, 0.0};
+	size_t i;
+	for (i = 0; i < n; i++) {
+		double product = a[i] * b[i];
+		lanes[i & 3] += product;
 	}
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
 }
 
-// ===============================================================
-//  Array index slots
-// ===============================================================
+void minmax_floats_scalar(const double *a, size_t n, double *min, double *max) {
+	double lo = a[0], hi = a[0];
+	size_t i;
+	for (i = 1; i < n; i++) {
+		lo = (a[i] < lo) ? a[i] : lo;
+		hi = (a[i] > hi) ? a[i] : hi;
+	}
+	*min = lo;
+	*max = hi;
+}
 
-/**
- * This type of slot represents one element of the array. The special slot
- * has to be used to allow writing to array indices.
+void arith_floats_scalar(double *out, const double *a, const double *b, bool b_scalar, size_t n, ArithOp op) {
+	size_t i;
+	for (i = 0; i < n; i++) {
+		double x = a[i], y = b_scalar ? b[0] : b[i];
+		out[i] = (op == ARITH_PLUS) ? (x + y) : ((op == ARITH_MINUS) ? (x - y) : (x * y));
+	}
+}
+
+void compare_floats_scalar(SepV *out, const double *a, const double *b, bool b_scalar, size_t n, CompareOp op) {
+	size_t i;
+	for (i = 0; i < n; i++)
+		out[i] = SEPV_FALSE + COMPARE(op, a[i], b_scalar ? b[0] : b[i]);
+}
+
+ArrayKernels SCALAR_ARRAY_KERNELS = {
+	&sum_ints_scalar, &minmax_ints_scalar, &arith_ints_scalar, &compare_ints_scalar,
+	&sum_floats_scalar, &dot_floats_scalar, &minmax_floats_scalar, &arith_floats_scalar, &compare_floats_scalar
+};
+
+// === vectorized versions
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEP_ARRAY_SIMD
+#include <immintrin.h>
+
+/*
+ * The AVX2 versions work on 4 elements at a time and leave the rest to
+ * their scalar counterparts. Comparison results are turned into booleans
+ * by subtracting the all-ones lane masks from SEPV_FALSE, relying on
+ * SEPV_TRUE being SEPV_FALSE + 1. Integer multiplication has no 64-bit
+ * AVX2 instruction, so it always goes through the scalar version.
  */
-typedef struct ArrayIndexSlot {
-	// the standard stuff every slot has
-	Slot base;
-	// the array from which this value came from
-	SepArray *array;
-	// the index from which it came
-	uint32_t index;
-} ArrayIndexSlot;
 
-// Retrieve a value from an array index.
-SepV _array_index_slot_retrieve(Slot *slot, OriginInfo *origin) {
-	ArrayIndexSlot *this = (ArrayIndexSlot*)slot;
-	return array_get(this->array, this->index);
+// Loads 4 elements of the 'b' operand, which might be a scalar.
+#define LOAD_B_INTS(b, b_scalar, i) ((b_scalar) ? _mm256_set1_epi64x(b[0]) : _mm256_loadu_si256((const __m256i*)((b) + (i))))
+#define LOAD_B_FLOATS(b, b_scalar, i) ((b_scalar) ? _mm256_set1_pd(b[0]) : _mm256_loadu_pd((b) + (i)))
+
+__attribute__((__target__("avx2")))
+void sum_ints_avx2(const int64_t *a, size_t n, uint64_t *high, uint64_t *low) {
+	const __m256i bias = _mm256_set1_epi64x(INT_BIAS), low_mask = _mm256_set1_epi64x(0xffffffffll);
+	__m256i h = _mm256_setzero_si256(), l = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i biased = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(a + i)), bias);
+		h = _mm256_add_epi64(h, _mm256_srli_epi64(biased, 32));
+		l = _mm256_add_epi64(l, _mm256_and_si256(biased, low_mask));
+	}
+
+	uint64_t hs[4], ls[4];
+	_mm256_storeu_si256((__m256i*)hs, h);
+	_mm256_storeu_si256((__m256i*)ls, l);
+	sum_ints_scalar(a + i, n - i, high, low);
+	*high += hs[0] + hs[1] + hs[2] + hs[3];
+	*low += ls[0] + ls[1] + ls[2] + ls[3];
 }
 
-// Set a value inside an array element.
-SepV _array_index_slot_store(Slot *slot, OriginInfo *origin, SepV new_value) {
-	ArrayIndexSlot *this = (ArrayIndexSlot*)slot;
-	return array_set(this->array, this->index, new_value);
+__attribute__((__target__("avx2")))
+void minmax_ints_avx2(const int64_t *a, size_t n, int64_t *min, int64_t *max) {
+	if (n < 4) {
+		minmax_ints_scalar(a, n, min, max);
+		return;
+	}
+
+	__m256i lo = _mm256_loadu_si256((const __m256i*)a), hi = lo;
+	size_t i = 4;
+	for (; i + 4 <= n; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+		lo = _mm256_blendv_epi8(lo, v, _mm256_cmpgt_epi64(lo, v));
+		hi = _mm256_blendv_epi8(hi, v, _mm256_cmpgt_epi64(v, hi));
+	}
+
+	int64_t los[4], his[4], rest_min, rest_max;
+	_mm256_storeu_si256((__m256i*)los, lo);
+	_mm256_storeu_si256((__m256i*)his, hi);
+	minmax_ints_scalar(los, 4, min, &rest_max);
+	minmax_ints_scalar(his, 4, &rest_min, max);
+	if (i < n) {
+		minmax_ints_scalar(a + i, n - i, &rest_min, &rest_max);
+		*min = (rest_min < *min) ? rest_min : *min;
+		*max = (rest_max > *max) ? rest_max : *max;
+	}
+}
+
+__attribute__((__target__("avx2")))
+bool arith_ints_avx2(int64_t *out, const int64_t *a, const int64_t *b, bool b_scalar, size_t n, ArithOp op) {
+	if (op == ARITH_TIMES)
+		return arith_ints_scalar(out, a, b, b_scalar, n, op);
+
+	const __m256i bias = _mm256_set1_epi64x(INT_BIAS);
+	__m256i out_of_range = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i)), y = LOAD_B_INTS(b, b_scalar, i);
+		__m256i r = (op == ARITH_PLUS) ? _mm256_add_epi64(x, y) : _mm256_sub_epi64(x, y);
+		out_of_range = _mm256_or_si256(out_of_range, _mm256_srli_epi64(_mm256_add_epi64(r, bias), 61));
+		_mm256_storeu_si256((__m256i*)(out + i), r);
+	}
+
+	bool fits = _mm256_testz_si256(out_of_range, out_of_range);
+	return arith_ints_scalar(out + i, a + i, b_scalar ? b : b + i, b_scalar, n - i, op) && fits;
+}
+
+__attribute__((__target__("avx2")))
+void compare_ints_avx2(SepV *out, const int64_t *a, const int64_t *b, bool b_scalar, size_t n, CompareOp op) {
+	const __m256i false_v = _mm256_set1_epi64x(SEPV_FALSE);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i)), y = LOAD_B_INTS(b, b_scalar, i), mask;
+		switch(op) {
+			case COMPARE_LESS: mask = _mm256_cmpgt_epi64(y, x); break;
+			case COMPARE_GREATER: mask = _mm256_cmpgt_epi64(x, y); break;
+			default: mask = _mm256_cmpeq_epi64(x, y);
+		}
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_sub_epi64(false_v, mask));
+	}
+	compare_ints_scalar(out + i, a + i, b_scalar ? b : b + i, b_scalar, n - i, op);
+}
+
+__attribute__((__target__("avx2")))
+double sum_floats_avx2(const double *a, size_t n) {
+	__m256d acc = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = _mm256_add_pd(acc, _mm256_loadu_pd(a + i));
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, acc);
+	for (; i < n; i++)
+		lanes[i & 3] += a[i];
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((__target__("avx2")))
+double dot_floats_avx2(const double *a, const double *b, size_t n) {
+	__m256d acc = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, acc);
+	for (; i < n; i++) {
+		double product = a[i] * b[i];
+		lanes[i & 3] += product;
+	}
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
 }
 
-// Queue dependent objects during GC.
-void _array_index_slot_mark_and_queue(Slot *slot, GarbageCollection *gc) {
-	ArrayIndexSlot *this = (ArrayIndexSlot*)slot;
-	gc_add_to_queue(gc, obj_to_sepv(this->array));
+__attribute__((__target__("avx2")))
+void minmax_floats_avx2(const double *a, size_t n, double *min, double *max) {
+	if (n < 4) {
+		minmax_floats_scalar(a, n, min, max);
+		return;
+	}
+
+	__m256d lo = _mm256_loadu_pd(a), hi = lo;
+	size_t i = 4;
+	for (; i + 4 <= n; i += 4) {
+		__m256d v = _mm256_loadu_pd(a + i);
+		lo = _mm256_min_pd(lo, v);
+		hi = _mm256_max_pd(hi, v);
+	}
+
+	double los[4], his[4], rest_min, rest_max;
+	_mm256_storeu_pd(los, lo);
+	_mm256_storeu_pd(his, hi);
+	minmax_floats_scalar(los, 4, min, &rest_max);
+	minmax_floats_scalar(his, 4, &rest_min, max);
+	if (i < n) {
+		minmax_floats_scalar(a + i, n - i, &rest_min, &rest_max);
+		*min = (rest_min < *min) ? rest_min : *min;
+		*max = (rest_max > *max) ? rest_max : *max;
+	}
+}
+
+__attribute__((__target__("avx2")))
+void arith_floats_avx2(double *out, const double *a, const double *b, bool b_scalar, size_t n, ArithOp op) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(a + i), y = LOAD_B_FLOATS(b, b_scalar, i), r;
+		switch(op) {
+			case ARITH_PLUS: r = _mm256_add_pd(x, y); break;
+			case ARITH_MINUS: r = _mm256_sub_pd(x, y); break;
+			default: r = _mm256_mul_pd(x, y);
+		}
+		_mm256_storeu_pd(out + i, r);
+	}
+	arith_floats_scalar(out + i, a + i, b_scalar ? b : b + i, b_scalar, n - i, op);
+}
+
+__attribute__((__target__("avx2")))
+void compare_floats_avx2(SepV *out, const double *a, const double *b, bool b_scalar, size_t n, CompareOp op) {
+	const __m256i false_v = _mm256_set1_epi64x(SEPV_FALSE);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(a + i), y = LOAD_B_FLOATS(b, b_scalar, i), mask;
+		switch(op) {
+			case COMPARE_LESS: mask = _mm256_cmp_pd(x, y, _CMP_LT_OQ); break;
+			case COMPARE_GREATER: mask = _mm256_cmp_pd(x, y, _CMP_GT_OQ); break;
+			default: mask = _mm256_cmp_pd(x, y, _CMP_EQ_OQ);
+		}
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_sub_epi64(false_v, _mm256_castpd_si256(mask)));
+	}
+	compare_floats_scalar(out + i, a + i, b_scalar ? b : b + i, b_scalar, n - i, op);
 }
 
-// The v-table for the array index slot.
-SlotType array_index_slot_vt = {
-	SF_NOTHING_SPECIAL,
-	&_array_index_slot_retrieve,
-	&_array_index_slot_store,
-	&_array_index_slot_mark_and_queue
+ArrayKernels AVX2_ARRAY_KERNELS = {
+	&sum_ints_avx2, &minmax_ints_avx2, &arith_ints_avx2, &compare_ints_avx2,
+	&sum_floats_avx2, &dot_floats_avx2, &minmax_floats_avx2, &arith_floats_avx2, &compare_floats_avx2
 };
 
-// Creates a new "array index" slot capable of writing values to the array.
-ArrayIndexSlot *array_index_slot_create(SepArray *array, uint32_t index) {
-	ArrayIndexSlot *slot = mem_allocate(sizeof(ArrayIndexSlot));
-	slot->base.vt = &array_index_slot_vt;
-	slot->array = array;
-	slot->index = index;
-	return slot;
+#endif
+
+// Picks the best kernels for the CPU we're running on.
+void array_kernels_initialize() {
+	array_kernels = SCALAR_ARRAY_KERNELS;
+#ifdef SEP_ARRAY_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		array_kernels = AVX2_ARRAY_KERNELS;
+#endif
 }
 
 // ===============================================================
-//  Indexing/slicing
+//  Iteration
 // ===============================================================
 
-SepItem array_at(SepObj *scope, ExecutionFrame *frame) {
-	SepArray *this = sepv_to_array(target(scope));
-	SepV index_v = param(scope, "index");
-	if (!sepv_is_int(index_v))
-		raise(exc.EWrongType, "Only integer indices are supported at this point.");
+// Native iteration - the length is checked on every step, so that
+// arrays can safely change while being iterated over.
+bool arrayiterator_next(SepIterator *this, SepV *element) {
+	SepArray *array = sepv_to_array(this->source);
+	if (this->position >= array_length(array))
+		return false;
+	*element = array_get(array, this->position++);
+	return true;
+}
 
+IteratorVT array_iterator_vt = {
+	&arrayiterator_next, NULL
+};
+
+// Creates a new iterator for a given array.
+SepItem array_iterator(SepObj *scope, ExecutionFrame *frame) {
+	SepV this = target(scope);
+	SepV iterator_proto_v = property(this, "<ArrayIterator>");
+	return si_obj(iterator_create(iterator_proto_v, &array_iterator_vt, this));
+}
+
+SepItem array_fromiterator(SepObj *scope, ExecutionFrame *frame) {
+	SepIteration iteration;
+	SepV started = iteration_start(&iteration, frame->vm, param(scope, "iterator"));
+		or_raise(started);
+
+	SepArray *array = array_create(1);
+	while (true) {
+		SepV element = iteration_next(&iteration);
+		if (element == SEPV_NO_VALUE)
+			return si_obj(array);
+		or_raise(element);
+		array_push(array, element);
+	}
+}
+
+// ===============================================================
+//  Indexing/slicing
+// ===============================================================
+
+// Returns the element at a given index as an l-value, so that it can be assigned to.
+static SepItem array_element(SepArray *this, SepInt index_i) {
 	// determine the actual index
-	SepInt index_i = sepv_to_int(index_v);
 	uint32_t index;
 	if (index_i < 0) {
 		index = array_length(this) + index_i;
@@ -138,13 +421,98 @@ SepItem array_at(SepObj *scope, ExecutionFrame *frame) {
 		index = index_i;
 	}
 
-	// create the slot used for assignment to array indices
+	// fetch the element
 	SepV value = array_get(this, index);
 		or_raise(value);
-	Slot *slot = (Slot*)array_index_slot_create(this, index);
 
-	// return an l-value so assigning to indices works
-	return item_artificial_lvalue(slot, value);
+	// return an l-value so assigning to indices works - the array and
+	// index are kept inside the item, so nothing has to be allocated
+	return item_index_lvalue(obj_to_sepv(this), index, value);
+}
+
+SepItem array_at(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV index_v = param(scope, "index");
+	if (!sepv_is_int(index_v))
+		raise(exc.EWrongType, "Only integer indices are supported at this point.");
+	return array_element(this, sepv_to_int(index_v));
+}
+
+// The same as Sequence."[]", without the calls it makes for integer indices.
+// Compiled code reads elements without calling this at all when it can.
+SepItem array_index(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV index = param(scope, "index");
+
+	// 'end' can be used in the index to refer to the last element
+	if (sepv_is_lazy(index)) {
+		SepFunc *index_f = sepv_to_func(index);
+		SepObj *extensions = obj_create();
+		obj_add_field(extensions, "end", int_to_sepv(-1));
+		SepObj *extended_scope = obj_create_with_proto(index_f->vt->get_declaration_scope(index_f));
+		obj_add_prototype(extended_scope, obj_to_sepv(extensions));
+		index = vm_resolve_in(frame->vm, index, obj_to_sepv(extended_scope));
+			or_raise(index);
+	}
+
+	if (sepv_is_int(index)) {
+		SepInt index_i = sepv_to_int(index);
+		if (index_i < 0)
+			index_i += array_length(this);
+		return array_element(this, index_i);
+	}
+
+	// anything else is a sequence of indices, and gets us a view
+	SepV normalized = call_method(frame->vm, obj_to_sepv(this), "normalizeIndexSequence", 1, index);
+		or_raise(normalized);
+	SepV view = call_method(frame->vm, obj_to_sepv(this), "view", 1, normalized);
+		or_raise(view);
+	return item_rvalue(view);
+}
+
+// Defined alongside the Range methods - checks whether an index sequence
+// is a Range, and extracts the [start, end) pair it covers if it is.
+bool index_range(SepV indices, SepInt *start, SepInt *end);
+
+SepItem array_view(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepArray *this = sepv_to_array(target(scope));
+	SepV indices = param(scope, "indices");
+	SepInt length = array_length(this);
+
+	// contiguous ranges are copied in one go
+	SepInt start, end;
+	if (index_range(indices, &start, &end)) {
+		start = (start < 0) ? 0 : ((start > length) ? length : start);
+		end = (end < start) ? start : ((end > length) ? length : end);
+
+		SepArray *slice = array_create(end - start);
+		if (end > start) {
+			slice->kind = this->kind;
+			array_grow(slice, end - start);
+			memcpy(slice->array.start, ga_get(&this->array, start), (end - start) * sizeof(SepV));
+		}
+		return si_obj(slice);
+	}
+
+	// any other sequence of indices is gathered element by element
+	SepArray *gathered = array_create(1);
+	SepV iterator = call_method(frame->vm, indices, "iterator", 0);
+		or_raise(iterator);
+	SepIteration iteration;
+	SepV started = iteration_start(&iteration, frame->vm, iterator);
+		or_raise(started);
+	while (true) {
+		SepV index_v = iteration_next(&iteration);
+		if (index_v == SEPV_NO_VALUE)
+			return si_obj(gathered);
+		or_raise(index_v);
+		SepInt index = cast_as_named_int("Index", index_v, &err);
+			or_raise(err);
+		SepV element = array_get(this, index);
+			or_raise(element);
+		array_push(gathered, element);
+	}
 }
 
 // ===============================================================
@@ -156,14 +524,746 @@ SepItem array_len(SepObj *scope, ExecutionFrame *frame) {
 	return si_int(array_length(this));
 }
 
+// ===============================================================
+//  Sorting
+// ===============================================================
+
+/**
+ * State shared by all comparisons in a single sort.
+ */
+typedef struct SortContext {
+	// the VM used for calling back into September code
+	SepVM *vm;
+	// the comparator provided, or SEPV_NO_VALUE to use '<'
+	SepV comparator;
+	// the first exception raised (or loop signal returned) by a comparison, if any
+	SepV error;
+} SortContext;
+
+// Stops a sort once a comparison has failed.
+#define sort_stopped(context) ((context)->error != SEPV_NOTHING)
+
+// Orders packed integers and floats.
+#define less_number(context, a, b) ((a) < (b))
+// Orders strings, without calling into the VM.
+#define less_string(context, a, b) (sepstr_cmp(sepv_to_str(a), sepv_to_str(b)) < 0)
+
+// Orders any values, using the comparator or the '<' operator.
+static bool less_vm(SortContext *context, SepV a, SepV b) {
+	if (context->error != SEPV_NOTHING)
+		return false;
+
+	if (context->comparator == SEPV_NO_VALUE) {
+		SepV less_than = call_method(context->vm, a, "<", 1, b);
+		if (sepv_is_exception(less_than) || sepv_is_signal(less_than))
+			context->error = less_than;
+		return less_than == SEPV_TRUE;
+	}
+
+	SepV comparison = vm_invoke(context->vm, context->comparator, 2, a, b).value;
+	if (sepv_is_exception(comparison) || sepv_is_signal(comparison)) {
+		context->error = comparison;
+		return false;
+	}
+	if (sepv_is_int(comparison))
+		return sepv_to_int(comparison) < 0;
+	if (sepv_is_float(comparison))
+		return sepv_to_float(comparison) < 0.0;
+	context->error = sepv_exception(exc.EWrongType, sepstr_for("Comparators are supposed to return numbers."));
+	return false;
+}
+
+DEFINE_INTROSORT(sort_ints, int64_t, less_number, SortContext, sort_stopped)
+DEFINE_INTROSORT(sort_floats, double, less_number, SortContext, sort_stopped)
+DEFINE_INTROSORT(sort_strings, SepV, less_string, SortContext, sort_stopped)
+DEFINE_INTROSORT(sort_values, SepV, less_vm, SortContext, sort_stopped)
+
+// Checks if all elements of an array are strings.
+bool array_all_strings(SepArray *this) {
+	SepV *element = this->array.start, *end = this->array.end;
+	for (; element < end; element++)
+		if (!sepv_is_str(*element))
+			return false;
+	return true;
+}
+
+// Sorts an array in place. If 'private' is set, the array is not visible to
+// September code, which allows sorting it directly even with callbacks.
+SepV array_sort_in_place(SepArray *this, SepVM *vm, SepV comparator, bool private) {
+	SortContext context = {vm, comparator, SEPV_NOTHING};
+	size_t length = array_length(this);
+
+	// fast paths - no calls to the VM needed
+	if (comparator == SEPV_NO_VALUE) {
+		if (this->kind == ARRAY_PACKED_INT) {
+			sort_ints(array_ints(this), length, &context);
+			return SEPV_NOTHING;
+		} else if (this->kind == ARRAY_PACKED_FLOAT) {
+			sort_floats(array_floats(this), length, &context);
+			return SEPV_NOTHING;
+		} else if (array_all_strings(this)) {
+			sort_strings(this->array.start, length, &context);
+			return SEPV_NOTHING;
+		}
+	}
+
+	// the callbacks could modify the array while we're sorting it, so
+	// unless nobody else can see it, the work happens on a copy
+	SepArray *sorted = private ? this : array_copy(this);
+	array_generalize(sorted);
+	sort_values(sorted->array.start, length, &context);
+	or_raise_sepv(context.error);
+	if (sorted != this) {
+		ga_clear(&this->array);
+		array_push_all(this, sorted);
+	}
+	return SEPV_NOTHING;
+}
+
+SepItem array_sort(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV err = array_sort_in_place(this, frame->vm, param(scope, "comparator"), false);
+		or_raise(err);
+	return si_obj(this);
+}
+
+SepItem array_sorted(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *copy = array_copy(sepv_to_array(target(scope)));
+	SepV err = array_sort_in_place(copy, frame->vm, param(scope, "comparator"), true);
+		or_raise(err);
+	return si_obj(copy);
+}
+
+// ===============================================================
+//  List processing
+// ===============================================================
+
+SepItem array_concat(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepArray *others = sepv_to_array(param(scope, "others"));
+
+	SepArray *result = array_copy(this);
+	SepArrayIterator it = array_iterate_over(others);
+	while (!arrayit_end(&it)) {
+		SepV other = arrayit_next(&it);
+		if (!sepv_is_array(other))
+			raise(exc.EWrongType, "Only arrays can be concatenated with arrays.");
+		array_push_all(result, sepv_to_array(other));
+	}
+	return si_obj(result);
+}
+
+SepItem array_extend(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV other = param(scope, "other");
+	if (!sepv_is_array(other))
+		raise(exc.EWrongType, "Arrays can only be extended with other arrays.");
+	array_push_all(this, sepv_to_array(other));
+	return si_obj(this);
+}
+
+SepItem array_reverse(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+
+	// all kinds use 8-byte cells, so this works for any of them
+	uint64_t *front = this->array.start, *back = (uint64_t*)this->array.end - 1;
+	for (; front < back; front++, back--)
+		SORT_SWAP(uint64_t, *front, *back);
+	return si_obj(this);
+}
+
+SepItem array_index_of_value(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV value = param(scope, "value");
+
+	// packed arrays can only hold numbers of their own type, and those
+	// are equal exactly when they're identical
+	if ((this->kind == ARRAY_PACKED_INT) && !sepv_is_float(value))
+		return si_int(array_index_of(this, value));
+	if ((this->kind == ARRAY_PACKED_FLOAT) && !sepv_is_int(value))
+		return si_int(array_index_of(this, value));
+
+	// everything else has to be checked with '=='
+	SepArrayIterator it = array_iterate_over(this);
+	SepInt index = 0;
+	while (!arrayit_end(&it)) {
+		SepV element = arrayit_next(&it);
+		if (element == value)
+			return si_int(index);
+		if (sepv_is_str(element) && sepv_is_str(value)) {
+			if (sepstr_equals(sepv_to_str(element), sepv_to_str(value)))
+				return si_int(index);
+		} else {
+			SepV equal = call_method(frame->vm, element, "==", 1, value);
+				or_raise(equal);
+			if (equal == SEPV_TRUE)
+				return si_int(index);
+		}
+		index++;
+	}
+	return si_int(-1);
+}
+
+SepItem array_map(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV mapping = param(scope, "mapping");
+
+	uint32_t index, length = array_length(this);
+	SepArray *result = array_create(length);
+	for (index = 0; index < length; index++) {
+		// the array might have been shortened by the mapping itself
+		SepV element = array_get(this, index);
+			or_raise(element);
+		SepV mapped = vm_invoke(frame->vm, mapping, 1, element).value;
+			or_raise(mapped);
+		array_push(result, mapped);
+	}
+	return si_obj(result);
+}
+
+SepItem array_filter(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV filter = param(scope, "filter");
+
+	uint32_t index, length = array_length(this);
+	SepArray *result = array_create(length);
+	for (index = 0; index < length; index++) {
+		SepV element = array_get(this, index);
+			or_raise(element);
+		SepV accepted = vm_invoke(frame->vm, filter, 1, element).value;
+			or_raise(accepted);
+		if (accepted == SEPV_TRUE)
+			array_push(result, element);
+	}
+	return si_obj(result);
+}
+
+SepItem array_reduce(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV reducer = param(scope, "reducer");
+	SepV accumulated = param(scope, "initial");
+
+	uint32_t index = 0, length = array_length(this);
+	if (accumulated == SEPV_NO_VALUE) {
+		if (length == 0)
+			raise(exc.EWrongIndex, "An empty array can't be reduced without an initial value.");
+		accumulated = array_get(this, index++);
+	}
+
+	for (; index < length; index++) {
+		SepV element = array_get(this, index);
+			or_raise(element);
+		accumulated = vm_invoke(frame->vm, reducer, 2, accumulated, element).value;
+			or_raise(accumulated);
+	}
+	return item_rvalue(accumulated);
+}
+
+// ===============================================================
+//  Numeric methods
+// ===============================================================
+
+/**
+ * An operand of the numeric methods - either an array, or a single number.
+ * Operands the kernels can't handle (generic arrays, big integers, anything
+ * non-numeric) have the ARRAY_GENERIC kind and go through the slow paths,
+ * which simply call the right operator for each element.
+ */
+typedef struct NumericOperand {
+	// the operand itself
+	SepV value;
+	// the kind of the elements - ARRAY_GENERIC if the kernels can't be used
+	ArrayKind kind;
+	// true for single numbers
+	bool scalar;
+	// number of elements
+	uint32_t length;
+	// the elements - for single numbers, points at 'number' below
+	void *data;
+	// storage for single numbers
+	union { int64_t i; double f; } number;
+	// true if 'data' was converted to floats and has to be freed
+	bool converted;
+} NumericOperand;
+
+void operand_init(NumericOperand *this, SepV value) {
+	this->value = value;
+	this->converted = false;
+	if (sepv_is_array(value)) {
+		SepArray *array = sepv_to_array(value);
+		this->kind = array->kind;
+		this->scalar = false;
+		this->length = array_length(array);
+		this->data = array->array.start;
+		return;
+	}
+
+	this->scalar = true;
+	this->length = 1;
+	this->data = &this->number;
+	if (sepv_is_int(value)) {
+		this->kind = ARRAY_PACKED_INT;
+		this->number.i = sepv_to_int(value);
+	} else if (sepv_is_float(value)) {
+		this->kind = ARRAY_PACKED_FLOAT;
+		this->number.f = sepv_to_float(value);
+	} else {
+		this->kind = ARRAY_GENERIC;
+	}
+}
+
+// Converts an integer operand to floats, for use with the float kernels.
+void operand_to_floats(NumericOperand *this) {
+	if (this->kind != ARRAY_PACKED_INT)
+		return;
+
+	uint32_t i;
+	if (this->scalar) {
+		this->number.f = (double)this->number.i;
+	} else {
+		const int64_t *ints = this->data;
+		double *floats = mem_unmanaged_allocate(this->length * sizeof(double));
+		for (i = 0; i < this->length; i++)
+			floats[i] = (double)ints[i];
+		this->data = floats;
+		this->converted = true;
+	}
+	this->kind = ARRAY_PACKED_FLOAT;
+}
+
+void operand_free(NumericOperand *this) {
+	if (this->converted)
+		mem_unmanaged_free(this->data);
+}
+
+// Gets the element of an operand used at a given index in elementwise operations.
+SepV operand_element(NumericOperand *this, uint32_t index) {
+	return this->scalar ? this->value : array_get(sepv_to_array(this->value), index);
+}
+
+// Creates an array of a given kind and length, to be filled in by a kernel.
+SepArray *array_create_filled_by_kernel(ArrayKind kind, uint32_t length) {
+	SepArray *result = array_create(length);
+	result->kind = kind;
+	array_grow(result, length);
+	return result;
+}
+
+// Makes sure a float calculated by the kernels can be stored in a SepV.
+SepV verify_float_results(double *results, uint32_t count) {
+	uint32_t i;
+	bool fits = true;
+	for (i = 0; i < count; i++)
+		fits &= float_fits_sepv(results[i]);
+	if (!fits)
+		raise_sepv(exc.ENumericOverflow, "The result can't be represented as a float.");
+	return SEPV_NOTHING;
+}
+
+// Prepares the operands of an elementwise operation.
+SepV elementwise_operands(SepObj *scope, NumericOperand *a, NumericOperand *b) {
+	operand_init(a, target(scope));
+	operand_init(b, param(scope, "other"));
+	if (!b->scalar && (b->length != a->length))
+		raise_sepv(exc.EWrongArguments, "Arrays of different lengths (%d and %d) can't be combined elementwise.", a->length, b->length);
+	return SEPV_NOTHING;
+}
+
+SepItem array_arith(SepObj *scope, ExecutionFrame *frame, ArithOp op, char *operator) {
+	NumericOperand a, b;
+	SepV err = elementwise_operands(scope, &a, &b);
+		or_raise(err);
+	uint32_t i, length = a.length;
+
+	// fast paths - both operands are packed
+	if ((a.kind == ARRAY_PACKED_INT) && (b.kind == ARRAY_PACKED_INT)) {
+		SepArray *result = array_create_filled_by_kernel(ARRAY_PACKED_INT, length);
+		if (array_kernels.arith_ints(array_ints(result), a.data, b.data, b.scalar, length, op))
+			return si_obj(result);
+		// some results need big integers, the slow path will take care of that
+	} else if ((a.kind != ARRAY_GENERIC) && (b.kind != ARRAY_GENERIC)) {
+		SepArray *result = array_create_filled_by_kernel(ARRAY_PACKED_FLOAT, length);
+		operand_to_floats(&a);
+		operand_to_floats(&b);
+		array_kernels.arith_floats(array_floats(result), a.data, b.data, b.scalar, length, op);
+		operand_free(&a);
+		operand_free(&b);
+		err = verify_float_results(array_floats(result), length);
+			or_raise(err);
+		return si_obj(result);
+	}
+
+	// slow path - use the operators
+	SepArray *result = array_create(length);
+	for (i = 0; i < length; i++) {
+		SepV value = call_method(frame->vm, operand_element(&a, i), operator, 1, operand_element(&b, i));
+			or_raise(value);
+		array_push(result, value);
+	}
+	return si_obj(result);
+}
+
+SepItem array_compare(SepObj *scope, ExecutionFrame *frame, CompareOp op, char *operator) {
+	NumericOperand a, b;
+	SepV err = elementwise_operands(scope, &a, &b);
+		or_raise(err);
+	uint32_t i, length = a.length;
+
+	// fast paths - both operands are packed
+	if ((a.kind == ARRAY_PACKED_INT) && (b.kind == ARRAY_PACKED_INT)) {
+		SepArray *result = array_create_filled_by_kernel(ARRAY_GENERIC, length);
+		array_kernels.compare_ints(result->array.start, a.data, b.data, b.scalar, length, op);
+		return si_obj(result);
+	} else if ((a.kind != ARRAY_GENERIC) && (b.kind != ARRAY_GENERIC)) {
+		SepArray *result = array_create_filled_by_kernel(ARRAY_GENERIC, length);
+		operand_to_floats(&a);
+		operand_to_floats(&b);
+		array_kernels.compare_floats(result->array.start, a.data, b.data, b.scalar, length, op);
+		operand_free(&a);
+		operand_free(&b);
+		return si_obj(result);
+	}
+
+	// slow path - use the operators
+	SepArray *result = array_create(length);
+	for (i = 0; i < length; i++) {
+		SepV value = call_method(frame->vm, operand_element(&a, i), operator, 1, operand_element(&b, i));
+			or_raise(value);
+		array_push(result, value);
+	}
+	return si_obj(result);
+}
+
+SepItem array_plus(SepObj *scope, ExecutionFrame *frame) {
+	return array_arith(scope, frame, ARITH_PLUS, "+");
+}
+
+SepItem array_minus(SepObj *scope, ExecutionFrame *frame) {
+	return array_arith(scope, frame, ARITH_MINUS, "-");
+}
+
+SepItem array_times(SepObj *scope, ExecutionFrame *frame) {
+	return array_arith(scope, frame, ARITH_TIMES, "*");
+}
+
+SepItem array_less_than(SepObj *scope, ExecutionFrame *frame) {
+	return array_compare(scope, frame, COMPARE_LESS, "<");
+}
+
+SepItem array_greater_than(SepObj *scope, ExecutionFrame *frame) {
+	return array_compare(scope, frame, COMPARE_GREATER, ">");
+}
+
+SepItem array_equal_to(SepObj *scope, ExecutionFrame *frame) {
+	return array_compare(scope, frame, COMPARE_EQUAL, "==");
+}
+
+SepItem array_sum(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	uint32_t length = array_length(this);
+
+	if (this->kind == ARRAY_PACKED_INT) {
+		uint64_t high, low;
+		array_kernels.sum_ints(array_ints(this), length, &high, &low);
+		__int128 total = ((__int128)high << 32) + low - (__int128)length * INT_BIAS;
+		if (int_fits_sepv(total))
+			return si_int((SepInt)total);
+		// the sum needs a big integer, the slow path will take care of that
+	} else if (this->kind == ARRAY_PACKED_FLOAT) {
+		double total = array_kernels.sum_floats(array_floats(this), length);
+		SepV err = verify_float_results(&total, 1);
+			or_raise(err);
+		return si_float(total);
+	}
+
+	// slow path - use the operators
+	SepV total = int_to_sepv(0);
+	SepArrayIterator it = array_iterate_over(this);
+	while (!arrayit_end(&it)) {
+		total = call_method(frame->vm, total, "+", 1, arrayit_next(&it));
+			or_raise(total);
+	}
+	return item_rvalue(total);
+}
+
+SepItem array_extreme(SepObj *scope, ExecutionFrame *frame, bool maximum) {
+	SepArray *this = sepv_to_array(target(scope));
+	uint32_t length = array_length(this);
+	if (length == 0)
+		raise(exc.EWrongIndex, "An empty array has no %s.", maximum ? "maximum" : "minimum");
+
+	if (this->kind == ARRAY_PACKED_INT) {
+		int64_t min, max;
+		array_kernels.minmax_ints(array_ints(this), length, &min, &max);
+		return si_int(maximum ? max : min);
+	} else if (this->kind == ARRAY_PACKED_FLOAT) {
+		double min, max;
+		array_kernels.minmax_floats(array_floats(this), length, &min, &max);
+		return si_float(maximum ? max : min);
+	}
+
+	// slow path - use the operators
+	SepArrayIterator it = array_iterate_over(this);
+	SepV best = arrayit_next(&it);
+	while (!arrayit_end(&it)) {
+		SepV element = arrayit_next(&it);
+		SepV better = call_method(frame->vm, element, maximum ? ">" : "<", 1, best);
+			or_raise(better);
+		if (better == SEPV_TRUE)
+			best = element;
+	}
+	return item_rvalue(best);
+}
+
+SepItem array_min(SepObj *scope, ExecutionFrame *frame) {
+	return array_extreme(scope, frame, false);
+}
+
+SepItem array_max(SepObj *scope, ExecutionFrame *frame) {
+	return array_extreme(scope, frame, true);
+}
+
+SepItem array_dot(SepObj *scope, ExecutionFrame *frame) {
+	NumericOperand a, b;
+	SepV err = elementwise_operands(scope, &a, &b);
+		or_raise(err);
+	if (b.scalar)
+		raise(exc.EWrongType, "The dot product can only be calculated with another array.");
+	uint32_t i, length = a.length;
+
+	// fast paths - both operands are packed
+	if ((a.kind == ARRAY_PACKED_INT) && (b.kind == ARRAY_PACKED_INT)) {
+		// no 64-bit multiplication in AVX2, so this one is scalar
+		const int64_t *x = a.data, *y = b.data;
+		int64_t total = 0, product;
+		bool overflow = false;
+		for (i = 0; i < length; i++) {
+			overflow |= __builtin_mul_overflow(x[i], y[i], &product);
+			overflow |= __builtin_add_overflow(total, product, &total);
+		}
+		if (!overflow && int_fits_sepv(total))
+			return si_int(total);
+		// the result needs a big integer, the slow path will take care of that
+	} else if ((a.kind != ARRAY_GENERIC) && (b.kind != ARRAY_GENERIC)) {
+		operand_to_floats(&a);
+		operand_to_floats(&b);
+		double total = array_kernels.dot_floats(a.data, b.data, length);
+		operand_free(&a);
+		operand_free(&b);
+		err = verify_float_results(&total, 1);
+			or_raise(err);
+		return si_float(total);
+	}
+
+	// slow path - use the operators
+	SepV total = int_to_sepv(0);
+	for (i = 0; i < length; i++) {
+		SepV product = call_method(frame->vm, operand_element(&a, i), "*", 1, operand_element(&b, i));
+			or_raise(product);
+		total = call_method(frame->vm, total, "+", 1, product);
+			or_raise(total);
+	}
+	return item_rvalue(total);
+}
+
+// ===============================================================
+//  Parallel operations
+// ===============================================================
+
+/**
+ * Only native code ever runs on the worker threads. September functions
+ * can't - the VM only runs on its own thread, and the heap and the GC are
+ * shared by the whole process. So parallelSort() and parallelMap() split
+ * the work up only when it can be done without calling into the VM (packed
+ * numbers or strings in their natural order, builtin operators), and
+ * otherwise do exactly what sort() and map() would, on the calling thread.
+ */
+
+// arrays are split into parts of at least this many elements
+#define PARALLEL_MAP_GRAIN 16384
+// and never into more parts than this
+#define PARALLEL_MAP_MAX_PARTS 64
+
+DEFINE_MERGE(merge_ints, int64_t, less_number, SortContext)
+DEFINE_MERGE(merge_floats, double, less_number, SortContext)
+DEFINE_MERGE(merge_strings, SepV, less_string, SortContext)
+
+// Adapts a typed sort and merge to the signatures parallel_sort() expects.
+#define DEFINE_PARALLEL_SORT_ADAPTERS(sort, merge) \
+	static void sort##_chunk(void *elements, size_t count, void *context) { \
+		sort(elements, count, context); \
+	} \
+	static void merge##_runs(void *out, const void *a, size_t na, const void *b, size_t nb, void *context) { \
+		merge(out, a, na, b, nb, context); \
+	}
+
+DEFINE_PARALLEL_SORT_ADAPTERS(sort_ints, merge_ints)
+DEFINE_PARALLEL_SORT_ADAPTERS(sort_floats, merge_floats)
+DEFINE_PARALLEL_SORT_ADAPTERS(sort_strings, merge_strings)
+
+SepItem array_parallel_sort(SepObj *scope, ExecutionFrame *frame) {
+	SepArray *this = sepv_to_array(target(scope));
+	SepV comparator = param(scope, "comparator");
+	SortContext context = {frame->vm, comparator, SEPV_NOTHING};
+	size_t length = array_length(this);
+
+	if (comparator == SEPV_NO_VALUE) {
+		if (this->kind == ARRAY_PACKED_INT) {
+			parallel_sort(array_ints(this), length, sizeof(int64_t), &sort_ints_chunk, &merge_ints_runs, &context);
+			return si_obj(this);
+		} else if (this->kind == ARRAY_PACKED_FLOAT) {
+			parallel_sort(array_floats(this), length, sizeof(double), &sort_floats_chunk, &merge_floats_runs, &context);
+			return si_obj(this);
+		} else if (array_all_strings(this)) {
+			parallel_sort(this->array.start, length, sizeof(SepV), &sort_strings_chunk, &merge_strings_runs, &context);
+			return si_obj(this);
+		}
+	}
+
+	// everything else needs the VM
+	SepV err = array_sort_in_place(this, frame->vm, comparator, false);
+		or_raise(err);
+	return si_obj(this);
+}
+
+/**
+ * The operators parallelMap() can run on the worker threads.
+ */
+typedef struct ParallelOperator {
+	char *name;
+	bool comparison;
+	int op;
+} ParallelOperator;
+
+static ParallelOperator parallel_operators[] = {
+	{"+", false, ARITH_PLUS}, {"-", false, ARITH_MINUS}, {"*", false, ARITH_TIMES},
+	{"<", true, COMPARE_LESS}, {">", true, COMPARE_GREATER}, {"==", true, COMPARE_EQUAL},
+	{NULL, false, 0}
+};
+
+/**
+ * A single elementwise kernel, with the arrays split into ranges for the
+ * worker threads.
+ */
+typedef struct ParallelKernel {
+	ParallelOperator *operator;
+	ArrayKind kind;
+	NumericOperand *a, *b;
+	void *out;
+	uint32_t length, parts;
+	// set for the parts whose integer results didn't fit
+	bool overflowed[PARALLEL_MAP_MAX_PARTS];
+} ParallelKernel;
+
+static void parallel_kernel_task(void *data, uint32_t part) {
+	ParallelKernel *this = data;
+	uint32_t start = (uint32_t)((uint64_t)this->length * part / this->parts);
+	uint32_t end = (uint32_t)((uint64_t)this->length * (part + 1) / this->parts);
+	uint32_t b_start = this->b->scalar ? 0 : start;
+	bool scalar = this->b->scalar;
+
+	if (this->kind == ARRAY_PACKED_INT) {
+		const int64_t *a = this->a->data, *b = this->b->data;
+		if (this->operator->comparison)
+			array_kernels.compare_ints((SepV*)this->out + start, a + start, b + b_start, scalar, end - start, this->operator->op);
+		else
+			this->overflowed[part] = !array_kernels.arith_ints((int64_t*)this->out + start, a + start, b + b_start, scalar, end - start, this->operator->op);
+	} else {
+		const double *a = this->a->data, *b = this->b->data;
+		if (this->operator->comparison)
+			array_kernels.compare_floats((SepV*)this->out + start, a + start, b + b_start, scalar, end - start, this->operator->op);
+		else
+			array_kernels.arith_floats((double*)this->out + start, a + start, b + b_start, scalar, end - start, this->operator->op);
+	}
+}
+
+// Runs a kernel over packed operands, returns false if some integer results didn't fit.
+bool parallel_kernel_run(ParallelKernel *this) {
+	uint32_t parts = this->length / PARALLEL_MAP_GRAIN + 1, threads = parallel_thread_count();
+	if (parts > threads) parts = threads;
+	if (parts > PARALLEL_MAP_MAX_PARTS) parts = PARALLEL_MAP_MAX_PARTS;
+	this->parts = parts;
+	memset(this->overflowed, 0, sizeof(this->overflowed));
+
+	parallel_for(parts, &parallel_kernel_task, this);
+
+	uint32_t part;
+	for (part = 0; part < parts; part++)
+		if (this->overflowed[part])
+			return false;
+	return true;
+}
+
+SepItem array_parallel_map(SepObj *scope, ExecutionFrame *frame) {
+	SepV mapping = param(scope, "mapping");
+	SepV other = param(scope, "other");
+
+	// functions have to run on this thread
+	if (!sepv_is_str(mapping)) {
+		if (other != SEPV_NO_VALUE)
+			raise(exc.EWrongArguments, "Only operators take a second operand.");
+		return array_map(scope, frame);
+	}
+
+	// find the operator
+	SepString *name = sepv_to_str(mapping);
+	ParallelOperator *operator;
+	for (operator = parallel_operators; operator->name; operator++)
+		if ((name->length == strlen(operator->name)) && !memcmp(name->cstr, operator->name, name->length))
+			break;
+	if (!operator->name)
+		raise(exc.EWrongArguments, "'%.*s' is not an operator that can be mapped in parallel.", name->length, name->cstr);
+	if (other == SEPV_NO_VALUE)
+		raise(exc.EWrongArguments, "Mapping with an operator requires the other operand.");
+
+	NumericOperand a, b;
+	SepV err = elementwise_operands(scope, &a, &b);
+		or_raise(err);
+	uint32_t length = a.length;
+
+	// only packed operands can be handled on the worker threads
+	if ((a.kind != ARRAY_GENERIC) && (b.kind != ARRAY_GENERIC)) {
+		ParallelKernel kernel = {operator, ARRAY_PACKED_INT, &a, &b, NULL, length};
+		if ((a.kind == ARRAY_PACKED_INT) && (b.kind == ARRAY_PACKED_INT)) {
+			SepArray *result = array_create_filled_by_kernel(operator->comparison ? ARRAY_GENERIC : ARRAY_PACKED_INT, length);
+			kernel.out = result->array.start;
+			if (parallel_kernel_run(&kernel))
+				return si_obj(result);
+			// some results need big integers, the slow path will take care of that
+		} else {
+			SepArray *result = array_create_filled_by_kernel(operator->comparison ? ARRAY_GENERIC : ARRAY_PACKED_FLOAT, length);
+			operand_to_floats(&a);
+			operand_to_floats(&b);
+			kernel.kind = ARRAY_PACKED_FLOAT;
+			kernel.out = result->array.start;
+			parallel_kernel_run(&kernel);
+			operand_free(&a);
+			operand_free(&b);
+			if (!operator->comparison) {
+				err = verify_float_results(array_floats(result), length);
+					or_raise(err);
+			}
+			return si_obj(result);
+		}
+	}
+
+	// slow path - the same as the sequential methods
+	if (operator->comparison)
+		return array_compare(scope, frame, operator->op, operator->name);
+	else
+		return array_arith(scope, frame, operator->op, operator->name);
+}
+
 // ===============================================================
 //  Putting the prototype together
 // ===============================================================
 
 SepObj *create_array_prototype() {
 	// create related prototypes
-	SepObj *ArrayIterator = make_class("ArrayIterator", NULL);
-	obj_add_builtin_method(ArrayIterator, "next", arrayiterator_next, 0);
+	SepObj *ArrayIterator = make_iterator_class("ArrayIterator");
+
+	// pick the best implementation of the numeric kernels
+	array_kernels_initialize();
 
 	// create Array prototype
 	SepObj *Array = make_class("Array", NULL);
@@ -172,6 +1272,35 @@ SepObj *create_array_prototype() {
 	obj_add_builtin_method(Array, "iterator", array_iterator, 0);
 	obj_add_builtin_method(Array, "length", array_len, 0);
 	obj_add_builtin_method(Array, "at", array_at, 1, "index");
+	obj_add_builtin_method(Array, "[]", array_index, 1, "?index");
+	obj_add_builtin_method(Array, "view", array_view, 1, "indices");
+
+	// list processing
+	obj_add_builtin_method(Array, "sort", array_sort, 1, "=comparator");
+	obj_add_builtin_method(Array, "sorted", array_sorted, 1, "=comparator");
+	obj_add_builtin_method(Array, "concat", array_concat, 1, "...others");
+	obj_add_builtin_method(Array, "extend", array_extend, 1, "other");
+	obj_add_builtin_method(Array, "reverse", array_reverse, 0);
+	obj_add_builtin_method(Array, "indexOf", array_index_of_value, 1, "value");
+	obj_add_builtin_method(Array, "map", array_map, 1, "mapping");
+	obj_add_builtin_method(Array, "filter", array_filter, 1, "filter");
+	obj_add_builtin_method(Array, "reduce", array_reduce, 2, "reducer", "=initial");
+
+	// numeric methods
+	obj_add_builtin_method(Array, "sum", array_sum, 0);
+	obj_add_builtin_method(Array, "min", array_min, 0);
+	obj_add_builtin_method(Array, "max", array_max, 0);
+	obj_add_builtin_method(Array, "dot", array_dot, 1, "other");
+	obj_add_builtin_method(Array, "plus", array_plus, 1, "other");
+	obj_add_builtin_method(Array, "minus", array_minus, 1, "other");
+	obj_add_builtin_method(Array, "times", array_times, 1, "other");
+	obj_add_builtin_method(Array, "lessThan", array_less_than, 1, "other");
+	obj_add_builtin_method(Array, "greaterThan", array_greater_than, 1, "other");
+	obj_add_builtin_method(Array, "equalTo", array_equal_to, 1, "other");
+
+	// parallel versions
+	obj_add_builtin_method(Array, "parallelSort", array_parallel_sort, 1, "=comparator");
+	obj_add_builtin_method(Array, "parallelMap", array_parallel_map, 2, "mapping", "=other");
 
 	return Array;
 }
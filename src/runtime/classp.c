@@ -25,7 +25,7 @@ SepItem class_new(SepObj *scope, ExecutionFrame *frame) {
 		or_raise(err);
 
 	// make class object using libseptvm functionality
-	SepObj *cls = make_class(class_name->cstr, rt.Object);
+	SepObj *cls = make_class(sepstr_flatten(class_name)->cstr, rt.Object);
 
 	// return the class
 	return si_obj(cls);
@@ -14,12 +14,45 @@
 
 #include "common.h"
 
+// ===============================================================
+//  Exception methods
+// ===============================================================
+
+// Returns the places the exception passed through on its way out as an array
+// of 'module:line' strings, the place it was thrown from coming first.
+SepItem exception_backtrace_method(SepObj *scope, ExecutionFrame *frame) {
+	Backtrace *backtrace = exception_backtrace(target(scope));
+	SepArray *result = array_create(backtrace ? backtrace->depth : 0);
+	uint32_t entry;
+	for (entry = 0; backtrace && (entry < backtrace->depth); entry++)
+		array_push(result, str_to_sepv(backtrace_describe(&backtrace->entries[entry])));
+	return si_obj(result);
+}
+
+// The message of exceptions created by the VM is only formatted when it's read.
+SepV exception_message_retrieve(Slot *slot, OriginInfo *origin) {
+	SepString *message = exception_message(origin->source);
+	return message ? str_to_sepv(message) : SEPV_NOTHING;
+}
+
+// Setting a message replaces it with a normal field on the exception itself.
+SepV exception_message_store(Slot *slot, OriginInfo *origin, SepV value) {
+	if (!sepv_is_obj(origin->source))
+		raise_sepv(exc.ECannotAssign, "Messages can only be set on exception objects.");
+	props_add_field(sepv_to_obj(origin->source), "message", value);
+	return value;
+}
+
+SlotType st_exception_message = {SF_NOTHING_SPECIAL, &exception_message_retrieve, &exception_message_store, NULL };
+
 // ===============================================================
 //  Creating built-in exception types
 // ===============================================================
 
 SepObj *obj_add_exception(SepObj *object, char *exception_name, SepObj *parent_type) {
 	SepObj *exception_class = make_class(exception_name, parent_type);
+	if (!parent_type)
+		obj_add_slot(exception_class, "message", &st_exception_message, SEPV_NOTHING);
 	obj_add_field(object, exception_name, obj_to_sepv(exception_class));
 	return exception_class;
 }
@@ -29,6 +62,7 @@ SepObj *create_builtin_exceptions() {
 
 	// base exception class for user exceptions
 	SepObj *Exception = obj_add_exception(exceptions, "Exception", NULL);
+	obj_add_builtin_method(Exception, "backtrace", exception_backtrace_method, 0);
 
 	// internal error type (does not belong to the 'Exception' hierarchy)
 	obj_add_exception(exceptions, "EInternal", NULL);
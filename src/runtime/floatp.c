@@ -0,0 +1,217 @@
+/*****************************************************************
+ **
+ ** runtime/floatp.c
+ **
+ ** Implementation of the Float prototype.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "common.h"
+
+// ===============================================================
+//  Helpers
+// ===============================================================
+
+SepV get_float_params(SepObj *scope, SepFloat *f1, SepFloat *f2) {
+	SepV err = SEPV_NOTHING;
+	*f1 = target_as_float(scope, &err);
+	*f2 = param_as_float(scope, "other", &err);
+	return err;
+}
+
+// Wraps the result of a float operation, raising an exception if the result
+// is outside the range of floats that can be stored.
+SepItem float_result(SepFloat result, SepFloat f1, char *operation, SepFloat f2) {
+	if (!float_fits_sepv(result))
+		raise(exc.ENumericOverflow, "The result of '%g' %s '%g' can't be represented as a float.", f1, operation, f2);
+	return si_float(result);
+}
+
+// ===============================================================
+//  Arithmetics
+// ===============================================================
+
+SepItem float_op_add(SepObj *scope, ExecutionFrame *frame) {
+	SepFloat a, b;
+	SepV err = get_float_params(scope, &a, &b);
+		or_raise(err);
+
+	return float_result(a + b, a, "+", b);
+}
+
+SepItem float_op_sub(SepObj *scope, ExecutionFrame *frame) {
+	SepFloat a, b;
+	SepV err = get_float_params(scope, &a, &b);
+		or_raise(err);
+
+	return float_result(a - b, a, "-", b);
+}
+
+SepItem float_op_mul(SepObj *scope, ExecutionFrame *frame) {
+	SepFloat a, b;
+	SepV err = get_float_params(scope, &a, &b);
+		or_raise(err);
+
+	return float_result(a * b, a, "*", b);
+}
+
+SepItem float_op_div(SepObj *scope, ExecutionFrame *frame) {
+	SepFloat a, b;
+	SepV err = get_float_params(scope, &a, &b);
+		or_raise(err);
+
+	return float_result(a / b, a, "/", b);
+}
+
+SepItem float_op_mod(SepObj *scope, ExecutionFrame *frame) {
+	SepFloat a, b;
+	SepV err = get_float_params(scope, &a, &b);
+		or_raise(err);
+
+	return float_result(fmod(a, b), a, "%", b);
+}
+
+SepItem float_op_negate(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepFloat number = target_as_float(scope, &err);
+		or_raise(err);
+
+	return si_float(-number);
+}
+
+// ===============================================================
+//  Relations
+// ===============================================================
+
+int compare_float_params(SepObj *scope, SepV *error) {
+	SepV err = SEPV_NOTHING;
+	SepFloat this = target_as_float(scope, &err);
+		or_fail_with(0);
+	SepFloat other = param_as_float(scope, "other", &err);
+		or_handle() {
+			err = SEPV_NOTHING;
+			SepObj *EUncomparable = prop_as_obj(obj_to_sepv(rt.globals), "EUncomparable", &err);
+				or_fail_with(0);
+			fail(0, exception(EUncomparable, "Float compared to a non-numeric value."));
+		}
+	return (this < other) ? -1 : ((this == other) ? 0 : 1);
+}
+
+SepItem float_op_eq(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepFloat this = target_as_float(scope, &err);
+		or_raise(err);
+	SepFloat other = param_as_float(scope, "other", &err);
+		or_handle() { return si_bool(false); }
+	return si_bool(this == other);
+}
+
+SepItem float_op_neq(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepFloat this = target_as_float(scope, &err);
+		or_raise(err);
+	SepFloat other = param_as_float(scope, "other", &err);
+		or_handle() { return si_bool(true); }
+	return si_bool(this != other);
+}
+
+SepItem float_op_lt(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	int comparison = compare_float_params(scope, &err); or_raise(err);
+	return si_bool(comparison < 0);
+}
+
+SepItem float_op_gt(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	int comparison = compare_float_params(scope, &err); or_raise(err);
+	return si_bool(comparison > 0);
+}
+
+SepItem float_op_leq(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	int comparison = compare_float_params(scope, &err); or_raise(err);
+	return si_bool(comparison <= 0);
+}
+
+SepItem float_op_geq(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	int comparison = compare_float_params(scope, &err); or_raise(err);
+	return si_bool(comparison >= 0);
+}
+
+// ===============================================================
+//  Methods
+// ===============================================================
+
+SepItem float_to_string(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepFloat number = target_as_float(scope, &err);
+		or_raise(err);
+
+	// find the shortest representation that reads back as the same number
+	char buffer[40];
+	int precision;
+	for (precision = 15; precision < 17; precision++) {
+		snprintf(buffer, sizeof(buffer), "%.*g", precision, number);
+		if (strtod(buffer, NULL) == number)
+			break;
+	}
+	if (precision == 17)
+		snprintf(buffer, sizeof(buffer), "%.17g", number);
+
+	// make sure the result doesn't look like an integer
+	if (!strpbrk(buffer, ".e"))
+		strcat(buffer, ".0");
+
+	return item_rvalue(str_to_sepv(sepstr_new(buffer)));
+}
+
+SepItem float_to_integer(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepFloat number = target_as_float(scope, &err);
+		or_raise(err);
+
+	// truncates towards zero, large floats become big integers
+	return item_rvalue(bigint_from_float(number));
+}
+
+// ===============================================================
+//  Building the prototype
+// ===============================================================
+
+SepObj *create_float_prototype() {
+	SepObj *Float = make_class("Float", NULL);
+
+	// arithmetics
+	obj_add_builtin_method(Float, "+", float_op_add, 1, "other");
+	obj_add_builtin_method(Float, "-", float_op_sub, 1, "other");
+	obj_add_builtin_method(Float, "*", float_op_mul, 1, "other");
+	obj_add_builtin_method(Float, "/", float_op_div, 1, "other");
+	obj_add_builtin_method(Float, "%", float_op_mod, 1, "other");
+	obj_add_builtin_method(Float, "unary-", float_op_negate, 0);
+
+	// relations
+	obj_add_builtin_method(Float, "==", float_op_eq,  1, "other");
+	obj_add_builtin_method(Float, "!=", float_op_neq, 1, "other");
+	obj_add_builtin_method(Float, "<",  float_op_lt,  1, "other");
+	obj_add_builtin_method(Float, ">",  float_op_gt,  1, "other");
+	obj_add_builtin_method(Float, "<=", float_op_leq, 1, "other");
+	obj_add_builtin_method(Float, ">=", float_op_geq, 1, "other");
+
+	// methods
+	obj_add_builtin_method(Float, "toString", float_to_string, 0);
+	obj_add_builtin_method(Float, "toInteger", float_to_integer, 0);
+
+	// return prototype
+	return Float;
+}
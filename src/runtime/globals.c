@@ -32,7 +32,12 @@ SepObj *create_object_prototype();
 SepObj *create_class_object();
 
 SepObj *create_array_prototype();
+SepObj *create_map_prototype();
+SepObj *create_set_prototype(SepObj *Map);
 SepObj *create_integer_prototype();
+SepObj *create_range_prototype(SepObj *Integer);
+SepObj *create_iterable_prototype();
+SepObj *create_float_prototype();
 SepObj *create_string_prototype();
 SepObj *create_slot_prototype();
 SepObj *create_bool_prototype();
@@ -76,7 +81,7 @@ SepItem func_print(SepObj *scope, ExecutionFrame *frame) {
 		}
 
 		// print it!
-		printf(first ? "%s" : " %s", string->cstr);
+		printf(first ? "%.*s" : " %.*s", string->length, string->cstr);
 		first = false;
 	}
 	puts("");
@@ -205,12 +210,48 @@ SepObj *create_if_statement_prototype() {
 
 SepObj *proto_LoopBodyMixin;
 
+// Finishes all frames up to the body of the innermost running loop, with
+// a signal the loop will find as the result of its body. Nothing is allocated
+// on this path - the exception is only created if no loop is running, which
+// can happen when a closure from a loop body is called after the loop ended.
+SepItem escape_loop(ExecutionFrame *frame, SepV signal) {
+	// find the loop - it's either compiled into the code of one of the frames,
+	// or run by a built-in, with its body in the frame below
+	ExecutionFrame *loop_frame = frame->prev_frame;
+	while (loop_frame && !loop_frame->loop_depth
+			&& !(loop_frame->prev_frame && loop_frame->prev_frame->runs_loop_body))
+		loop_frame = loop_frame->prev_frame;
+	if (!loop_frame && signal == SEPV_BREAK)
+		raise(exc.EBreak, "Uncaught 'break'.");
+	if (!loop_frame)
+		raise(exc.EContinue, "Uncaught 'continue'.");
+
+	// compiled loops just continue from the right place in their frame
+	ExecutionFrame *last_finished = loop_frame;
+	if (loop_frame->loop_depth) {
+		InlineLoop *loop = &loop_frame->loops[loop_frame->loop_depth - 1];
+		loop_frame->instruction_ptr = (signal == SEPV_BREAK) ? loop->exit : loop->next;
+		last_finished = loop_frame->next_frame;
+	}
+
+	// finish everything up to the loop
+	SepItem result = item_rvalue(signal);
+	while (true) {
+		frame->finished = true;
+		frame->return_value = result;
+		if (frame == last_finished)
+			break;
+		frame = frame->prev_frame;
+	}
+	return result;
+}
+
 SepItem break_impl(SepObj *scope, ExecutionFrame *frame) {
-	raise(exc.EBreak, "Uncaught 'break'.");
+	return escape_loop(frame, SEPV_BREAK);
 }
 
 SepItem continue_impl(SepObj *scope, ExecutionFrame *frame) {
-	raise(exc.EContinue, "Uncaught 'continue'.");
+	return escape_loop(frame, SEPV_CONTINUE);
 }
 
 SepObj *create_loop_body_mixin() {
@@ -250,20 +291,15 @@ SepItem func_while(SepObj *scope, ExecutionFrame *frame) {
 		// release condition for GC
 		gc_release(condition);
 		// execute body
+		frame->runs_loop_body = true;
 		SepV result = vm_invoke_in_scope(frame->vm, body_l,
 				obj_to_sepv(while_body_scope), 0).value;
-		// break or continue?
-		if (sepv_is_exception(result)) {
-			if (has_prototype(result, obj_to_sepv(exc.EBreak))) {
-				// break out of the C loop
-				break;
-			} else if (has_prototype(result, obj_to_sepv(exc.EContinue))) {
-				// just ignore the exception
-			} else {
-				// propagate other exceptions up
-				return item_rvalue(result);
-			}
-		}
+		frame->runs_loop_body = false;
+		// break? ('continue' needs no special handling)
+		if (result == SEPV_BREAK)
+			break;
+		if (sepv_is_exception(result))
+			return item_rvalue(result);
 
 		// release result
 		gc_release(result);
@@ -282,6 +318,10 @@ SepItem func_while(SepObj *scope, ExecutionFrame *frame) {
 
 SepObj *proto_ForStatement;
 
+// Defined alongside the Range methods - checks whether a value is a Range,
+// and extracts the [start, end) pair of integers it covers if it is.
+bool iteration_range(SepV value, SepInt *start, SepInt *end);
+
 // Creates the for-statement object.
 SepItem statement_for(SepObj *scope, ExecutionFrame *frame) {
 	SepObj *for_s = obj_create_with_proto(obj_to_sepv(proto_ForStatement));
@@ -314,12 +354,20 @@ SepItem statement_for_impl(SepObj *scope, ExecutionFrame *frame) {
 	SepString *variable_name = prop_as_str(for_s, "variable_name", &err);
 	or_raise(err);
 	SepV collection = property(for_s, "collection");
-	SepV iterator = call_method(frame->vm, collection, "iterator", 0);
-	or_raise(iterator);
-	SepV iterator_next = property(iterator, "next");
-	or_raise(iterator_next);
 	SepV body_l = property(for_s, "body");
 
+	// ranges are simply counted through, everything else needs an iterator
+	SepInt counter, limit;
+	bool counting = iteration_range(collection, &counter, &limit);
+	SepIteration iteration;
+	if (!counting) {
+		SepV iterator = call_method(frame->vm, collection, "iterator", 0);
+		or_raise(iterator);
+		// native iterators are advanced directly, without calling 'next'
+		SepV started = iteration_start(&iteration, frame->vm, iterator);
+		or_raise(started);
+	}
+
 	// prepare the scope
 	SepObj *for_body_scope = obj_create_with_proto(frame->prev_frame->locals);
 
@@ -333,38 +381,30 @@ SepItem statement_for_impl(SepObj *scope, ExecutionFrame *frame) {
 	// actually start the loop
 	while (true) {
 		// get the next element in the collection
-		SepV element = vm_invoke(frame->vm, iterator_next, 0).value;
-		if (sepv_is_exception(element)) {
-			// check if its ENoMoreElements - if so, break out of the loop
-			SepV enomoreelements_v = obj_to_sepv(exc.ENoMoreElements);
-			SepV is_no_more_elements_v = call_method(frame->vm, element, "is",
-					1, enomoreelements_v);
-			or_raise(is_no_more_elements_v);
-			if (is_no_more_elements_v == SEPV_TRUE) {
+		SepV element;
+		if (counting) {
+			if (counter >= limit)
 				break;
-			}
-
-			// not an iteration related exception - just propagate
-			return item_rvalue(element);
+			element = int_to_sepv(counter++);
+		} else {
+			element = iteration_next(&iteration);
+			if (element == SEPV_NO_VALUE)
+				break;
+			or_raise(element);
 		}
 
 		// execute the body of the loop
 		props_set_prop(for_body_scope, variable_name, element);
+		frame->runs_loop_body = true;
 		SepV result =
 				vm_invoke_in_scope(frame->vm, body_l, for_body_scope_v, 0).value;
+		frame->runs_loop_body = false;
 
-		// break or continue?
-		if (sepv_is_exception(result)) {
-			if (has_prototype(result, obj_to_sepv(exc.EBreak))) {
-				// break out of the C loop
-				break;
-			} else if (has_prototype(result, obj_to_sepv(exc.EContinue))) {
-				// just ignore the exception
-			} else {
-				// propagate other exceptions up
-				return item_rvalue(result);
-			}
-		}
+		// break? ('continue' needs no special handling)
+		if (result == SEPV_BREAK)
+			break;
+		if (sepv_is_exception(result))
+			return item_rvalue(result);
 
 		// release objects from this iteration of the loop to make them GC'able
 		gc_release(element);
@@ -392,6 +432,8 @@ SepObj *create_for_statement_prototype() {
 SepItem func_throw(SepObj *scope, ExecutionFrame *frame) {
 	SepV err = SEPV_NO_VALUE;
 	SepObj *exception_to_be = param_as_obj(scope, "exception", &err);
+		or_raise(err);
+	exception_capture_backtrace(exception_to_be);
 	return item_rvalue(obj_to_exception(exception_to_be));
 }
 
@@ -461,11 +503,9 @@ SepItem statement_try_impl(SepObj *scope, ExecutionFrame *frame) {
 		while (!arrayit_end(&it)) {
 			SepV catcher_obj = arrayit_next(&it);
 
-			// check the exception type using Exception.is().
+			// check the exception type the same way Exception.is() would
 			SepV catcher_type = property(catcher_obj, "type");
-			SepV type_matches_v = call_method(frame->vm, try_result, "is", 1,
-					catcher_type);
-			if (type_matches_v != SEPV_TRUE) {
+			if (!sepv_is_instance(try_result, catcher_type)) {
 				// type doesn't match - try another catcher
 				continue;
 			}
@@ -545,6 +585,9 @@ SepItem func_export(SepObj *scope, ExecutionFrame *frame) {
 //  Runtime initialization
 // ===============================================================
 
+// The flow control built-ins compiled code can run without calling.
+char *INLINED_SYNTAX[] = {"if", "if..", "while", "for..", "try..", NULL};
+
 SepObj *create_globals() {
 	// the class object is initialized first, as all other objects created below are classes
 	rt.Cls = create_class_object();
@@ -567,11 +610,20 @@ SepObj *create_globals() {
 	// initialize primitive classes
 	obj_add_field(obj_Globals, "Object", obj_to_sepv(rt.Object));
 	obj_add_field(obj_Globals, "Class", obj_to_sepv(rt.Cls));
-	obj_add_field(obj_Globals, "Array", obj_to_sepv(create_array_prototype()));
+	obj_add_field(obj_Globals, "Iterable", obj_to_sepv(create_iterable_prototype()));
+	SepObj *Array = create_array_prototype();
+	obj_add_field(obj_Globals, "Array", obj_to_sepv(Array));
+	SepObj *Map = create_map_prototype();
+	obj_add_field(obj_Globals, "Map", obj_to_sepv(Map));
+	obj_add_field(obj_Globals, "Set", obj_to_sepv(create_set_prototype(Map)));
 	obj_add_field(obj_Globals, "Bool", obj_to_sepv(create_bool_prototype()));
 	obj_add_field(obj_Globals, "Slot", obj_to_sepv(create_slot_prototype()));
-	obj_add_field(obj_Globals, "Integer",
-			obj_to_sepv(create_integer_prototype()));
+	SepObj *Integer = create_integer_prototype();
+	obj_add_field(obj_Globals, "Integer", obj_to_sepv(Integer));
+	obj_add_field(obj_Globals, "Range",
+			obj_to_sepv(create_range_prototype(Integer)));
+	obj_add_field(obj_Globals, "Float",
+			obj_to_sepv(create_float_prototype()));
 	obj_add_field(obj_Globals, "String",
 			obj_to_sepv(create_string_prototype()));
 	obj_add_field(obj_Globals, "Function",
@@ -610,6 +662,17 @@ SepObj *create_globals() {
 	obj_add_builtin_func(obj_Syntax, "for..", &statement_for, 1,
 			"?variable_name");
 
+	// the compiler turns these into jumps in the code using them, as long as
+	// 'syntax' still has the originals
+	SepObj *obj_InlineSyntax = obj_create_with_proto(SEPV_NOTHING);
+	char **name;
+	for (name = INLINED_SYNTAX; *name; name++)
+		obj_add_field(obj_InlineSyntax, *name, property(obj_to_sepv(obj_Syntax), *name));
+	obj_add_field(obj_InlineSyntax, "<loopBody>", obj_to_sepv(proto_LoopBodyMixin));
+	// array elements are read directly in the same way, as long as "[]" is the original
+	obj_add_field(obj_InlineSyntax, "[]", props_find_prop(Array, sepstr_for("[]"))->value);
+	obj_add_field(obj_Globals, "<inlineSyntax>", obj_to_sepv(obj_InlineSyntax));
+
 	// built-in functions
 	obj_add_builtin_func(obj_Globals, "print", &func_print, 1, "...what");
 	obj_add_builtin_func(obj_Globals, "export", &func_export, 2, "?object", "=as");
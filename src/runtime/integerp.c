@@ -18,86 +18,119 @@
 //  Helpful defines
 // ===============================================================
 
-#define INT_MAX ((1LL << 60) - 1LL)
-#define INT_MIN (-(1LL << 60))
+// Since the type tag of small integers is 0, this checks both operands
+// with a single test.
+#define both_small(a, b) ((((a) | (b)) & SEPV_TYPE_MASK) == SEPV_TYPE_INT)
 
 // ===============================================================
-//  Helpers
+//  Float operations
 // ===============================================================
 
-SepV get_params(SepObj *scope, SepInt *i1, SepInt *i2) {
-	SepV err = SEPV_NOTHING;
-	*i1 = target_as_int(scope, &err);
-	*i2 = param_as_int(scope, "other", &err);
-	return err;
-}
+// When the other operand is a float, the Integer operators defer to these
+// (they accept integer targets just fine).
+SepItem float_op_add(SepObj *scope, ExecutionFrame *frame);
+SepItem float_op_sub(SepObj *scope, ExecutionFrame *frame);
+SepItem float_op_mul(SepObj *scope, ExecutionFrame *frame);
+SepItem float_op_div(SepObj *scope, ExecutionFrame *frame);
+SepItem float_op_mod(SepObj *scope, ExecutionFrame *frame);
+SepItem float_op_eq(SepObj *scope, ExecutionFrame *frame);
+SepItem float_op_neq(SepObj *scope, ExecutionFrame *frame);
+int compare_float_params(SepObj *scope, SepV *error);
 
 // ===============================================================
-//  Arithmetics
+//  Helpers
 // ===============================================================
 
-SepItem overflow_safe_add(SepInt int1, SepInt int2) {
-	// check for overflow
-	if ((int1 < 0) && (int2 < 0) && (INT_MIN - int1 > int2))
-		goto overflow;
-	if ((int1 > 0) && (int2 > 0) && (INT_MAX - int1 < int2))
-		goto overflow;
+// Makes sure a value is an integer (of any size).
+SepV verify_integer(char *name, SepV value) {
+	if (sepv_is_exception(value))
+		return value;
+	if (!sepv_is_integer(value))
+		return sepv_exceptionf(exc.EWrongType, "%s is supposed to be an integer.", name);
+	return SEPV_NOTHING;
+}
 
-	// no overflow, just a new int
-	return si_int(int1 + int2);
+// Handles everything the fast paths of the operators don't: float operands,
+// big integers and results that need promotion.
+SepItem integer_slow_path(SepObj *scope, ExecutionFrame *frame,
+		SepV (*bigint_operation)(SepV, SepV), BuiltInImplFunc float_operation) {
+	SepV a = target(scope), b = param(scope, "other");
+	if (sepv_is_float(b))
+		return float_operation(scope, frame);
 
-overflow:
-	raise(exc.ENumericOverflow, "'%lld' + '%lld' doesn't fit in 61 bits.");
+	SepV err = verify_integer("Target object", a);
+		or_raise(err);
+	err = verify_integer("Parameter 'other'", b);
+		or_raise(err);
+
+	return item_rvalue(bigint_operation(a, b));
 }
 
-SepItem integer_op_add(SepObj *scope, ExecutionFrame *frame) {
-	SepInt a, b;
-	SepV err = get_params(scope, &a, &b);
-		or_raise(err);
+// ===============================================================
+//  Arithmetics
+// ===============================================================
 
-	return overflow_safe_add(a, b);
+SepItem integer_op_add(SepObj *scope, ExecutionFrame *frame) {
+	SepV a = target(scope), b = param(scope, "other");
+	if (both_small(a, b)) {
+		// 61-bit integers can't overflow 64 bits when added
+		SepInt result = sepv_to_int(a) + sepv_to_int(b);
+		if (int_fits_sepv(result))
+			return si_int(result);
+	}
+	return integer_slow_path(scope, frame, bigint_add, float_op_add);
 }
 
 SepItem integer_op_sub(SepObj *scope, ExecutionFrame *frame) {
-	SepInt a, b;
-	SepV err = get_params(scope, &a, &b);
-		or_raise(err);
-
-	return overflow_safe_add(a, -b);
+	SepV a = target(scope), b = param(scope, "other");
+	if (both_small(a, b)) {
+		SepInt result = sepv_to_int(a) - sepv_to_int(b);
+		if (int_fits_sepv(result))
+			return si_int(result);
+	}
+	return integer_slow_path(scope, frame, bigint_sub, float_op_sub);
 }
 
 SepItem integer_op_mul(SepObj *scope, ExecutionFrame *frame) {
-	SepInt a, b;
-	SepV err = get_params(scope, &a, &b);
-		or_raise(err);
-
-	// TODO: check for overflow
-	return si_int(a*b);
+	SepV a = target(scope), b = param(scope, "other");
+	if (both_small(a, b)) {
+		SepInt result;
+		if (!__builtin_mul_overflow(sepv_to_int(a), sepv_to_int(b), &result) && int_fits_sepv(result))
+			return si_int(result);
+	}
+	return integer_slow_path(scope, frame, bigint_mul, float_op_mul);
 }
 
 SepItem integer_op_div(SepObj *scope, ExecutionFrame *frame) {
-	SepInt a, b;
-	SepV err = get_params(scope, &a, &b);
-		or_raise(err);
-
-	return si_int(a/b);
+	SepV a = target(scope), b = param(scope, "other");
+	if (b == int_to_sepv(0))
+		raise(exc.ENumericOverflow, "Division by zero.");
+	if (both_small(a, b)) {
+		// the only case that can overflow is SEPV_INT_MIN / -1
+		SepInt result = sepv_to_int(a) / sepv_to_int(b);
+		if (int_fits_sepv(result))
+			return si_int(result);
+	}
+	return integer_slow_path(scope, frame, bigint_div, float_op_div);
 }
 
 SepItem integer_op_mod(SepObj *scope, ExecutionFrame *frame) {
-	SepInt a, b;
-	SepV err = get_params(scope, &a, &b);
-		or_raise(err);
-
-	return si_int(a%b);
+	SepV a = target(scope), b = param(scope, "other");
+	if (b == int_to_sepv(0))
+		raise(exc.ENumericOverflow, "Division by zero.");
+	if (both_small(a, b))
+		return si_int(sepv_to_int(a) % sepv_to_int(b));
+	return integer_slow_path(scope, frame, bigint_mod, float_op_mod);
 }
 
 SepItem integer_op_negate(SepObj *scope, ExecutionFrame *frame) {
-	SepV err = SEPV_NOTHING;
-	SepInt integer = target_as_int(scope, &err);
-		or_raise(err);
-
+	SepV a = target(scope);
+	if (sepv_is_int(a) && (a != int_to_sepv(SEPV_INT_MIN)))
+		return si_int(-sepv_to_int(a));
 
-	return overflow_safe_add(0, -integer);
+	SepV err = verify_integer("Target object", a);
+		or_raise(err);
+	return item_rvalue(bigint_negate(a));
 }
 
 // ===============================================================
@@ -105,35 +138,50 @@ SepItem integer_op_negate(SepObj *scope, ExecutionFrame *frame) {
 // ===============================================================
 
 int compare_params(SepObj *scope, SepV *error) {
-	SepV err = SEPV_NOTHING;
-	SepInt this = target_as_int(scope, &err);
+	SepV a = target(scope), b = param(scope, "other");
+	if (both_small(a, b)) {
+		SepInt this = sepv_to_int(a), other = sepv_to_int(b);
+		return (this < other) ? -1 : ((this == other) ? 0 : 1);
+	}
+	if (sepv_is_float(b))
+		return compare_float_params(scope, error);
+
+	SepV err = verify_integer("Target object", a);
 		or_fail_with(0);
-	SepInt other = param_as_int(scope, "other", &err);
-		or_handle() {
-			err = SEPV_NOTHING;
-			SepObj *EUncomparable = prop_as_obj(obj_to_sepv(rt.globals), "EUncomparable", &err);
-				or_fail_with(0);
-			fail(0, exception(EUncomparable, "Integer compared to a non-numeric value."));
-		}
-	return (this < other) ? -1 : ((this == other) ? 0 : 1);
+	if (!sepv_is_integer(b)) {
+		SepObj *EUncomparable = prop_as_obj(obj_to_sepv(rt.globals), "EUncomparable", &err);
+			or_fail_with(0);
+		fail(0, exception(EUncomparable, "Integer compared to a non-numeric value."));
+	}
+	return bigint_compare(a, b);
 }
 
 SepItem integer_op_eq(SepObj *scope, ExecutionFrame *frame) {
-	SepV err = SEPV_NOTHING;
-	SepInt this = target_as_int(scope, &err);
+	SepV a = target(scope), b = param(scope, "other");
+	if (both_small(a, b))
+		return si_bool(a == b);
+	if (sepv_is_float(b))
+		return float_op_eq(scope, frame);
+
+	SepV err = verify_integer("Target object", a);
 		or_raise(err);
-	SepInt other = param_as_int(scope, "other", &err);
-		or_handle() { return si_bool(false); }
-	return si_bool(this == other);
+	if (!sepv_is_integer(b))
+		return si_bool(false);
+	return si_bool(bigint_compare(a, b) == 0);
 }
 
 SepItem integer_op_neq(SepObj *scope, ExecutionFrame *frame) {
-	SepV err = SEPV_NOTHING;
-	SepInt this = target_as_int(scope, &err);
+	SepV a = target(scope), b = param(scope, "other");
+	if (both_small(a, b))
+		return si_bool(a != b);
+	if (sepv_is_float(b))
+		return float_op_neq(scope, frame);
+
+	SepV err = verify_integer("Target object", a);
 		or_raise(err);
-	SepInt other = param_as_int(scope, "other", &err);
-		or_handle() { return si_bool(true); }
-	return si_bool(this != other);
+	if (!sepv_is_integer(b))
+		return si_bool(true);
+	return si_bool(bigint_compare(a, b) != 0);
 }
 
 SepItem integer_op_lt(SepObj *scope, ExecutionFrame *frame) {
@@ -165,11 +213,23 @@ SepItem integer_op_geq(SepObj *scope, ExecutionFrame *frame) {
 // ===============================================================
 
 SepItem integer_to_string(SepObj *scope, ExecutionFrame *frame) {
-	SepV err = SEPV_NOTHING;
-	SepInt integer = target_as_int(scope, &err);
+	SepV integer = target(scope);
+	SepV err = verify_integer("Target object", integer);
+		or_raise(err);
+
+	return item_rvalue(str_to_sepv(bigint_to_string(integer)));
+}
+
+SepItem integer_to_float(SepObj *scope, ExecutionFrame *frame) {
+	SepV integer = target(scope);
+	SepV err = verify_integer("Target object", integer);
 		or_raise(err);
 
-	return item_rvalue(str_to_sepv(sepstr_sprintf("%lld", integer)));
+	// every 61-bit integer is in the range of floats, but big ones might not be
+	SepFloat number = bigint_to_float(integer);
+	if (!float_fits_sepv(number))
+		raise(exc.ENumericOverflow, "The integer is too large to be represented as a float.");
+	return si_float(number);
 }
 
 // ===============================================================
@@ -197,6 +257,7 @@ SepObj *create_integer_prototype() {
 
 	// methods
 	obj_add_builtin_method(Integer, "toString", integer_to_string, 0);
+	obj_add_builtin_method(Integer, "toFloat", integer_to_float, 0);
 
 	// return prototype
 	return Integer;
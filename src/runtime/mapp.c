@@ -0,0 +1,248 @@
+/*****************************************************************
+ **
+ ** runtime/mapp.c
+ **
+ ** Implementation for all built-in Map and Set methods.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include "common.h"
+
+// ===============================================================
+//  Common parts
+// ===============================================================
+
+// Gets the map a method was called on, making sure it really is one.
+SepMap *map_target(SepObj *scope, SepV *error) {
+	SepV target_v = target(scope);
+	if (!sepv_is_map(target_v)) {
+		*error = sepv_exception(exc.EWrongType, sepstr_for("This method can only be called on maps and sets."));
+		return NULL;
+	}
+	return sepv_to_map(target_v);
+}
+
+// Creates a new, empty map or set - the class it's called on decides which.
+SepItem map_spawn(SepObj *scope, ExecutionFrame *frame) {
+	return si_obj(map_create(target(scope)));
+}
+
+SepItem map_length(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	return si_int(map_count(this));
+}
+
+SepItem map_contains(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	SepV value = map_get(this, frame->vm, param(scope, "key"));
+		or_raise(value);
+	return si_bool(value != SEPV_NO_VALUE);
+}
+
+SepItem map_remove_key(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	SepV removed = map_remove(this, frame->vm, param(scope, "key"));
+		or_raise(removed);
+	return si_bool(removed != SEPV_NO_VALUE);
+}
+
+SepItem map_clear_all(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	map_clear(this);
+	return si_obj(this);
+}
+
+// ===============================================================
+//  Iteration
+// ===============================================================
+
+// Native iteration over the keys - the position is an index into the entries.
+bool mapiterator_next(SepIterator *this, SepV *element) {
+	SepMapIterator it = {sepv_to_map(this->source), (uint32_t)this->position};
+	bool more = !mapit_end(&it);
+	if (more)
+		*element = mapit_next(&it)->key;
+	this->position = it.position;
+	return more;
+}
+
+IteratorVT map_iterator_vt = {
+	&mapiterator_next, NULL
+};
+
+// Creates a new iterator over the keys of a map, or the elements of a set.
+SepItem map_iterator(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+
+	SepV iterator_proto_v = property(obj_to_sepv(this), "<MapIterator>");
+	return si_obj(iterator_create(iterator_proto_v, &map_iterator_vt, obj_to_sepv(this)));
+}
+
+// The parts of entries that keys(), values() and entries() extract.
+typedef enum EntryPart {
+	PART_KEY, PART_VALUE, PART_BOTH
+} EntryPart;
+
+// Gathers keys, values or [key, value] pairs into an array, in insertion order.
+SepItem map_gather(SepObj *scope, EntryPart part) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+
+	SepArray *result = array_create(map_count(this));
+	SepMapIterator it = map_iterate_over(this);
+	while (!mapit_end(&it)) {
+		MapEntry *entry = mapit_next(&it);
+		if (part == PART_KEY) {
+			array_push(result, entry->key);
+		} else if (part == PART_VALUE) {
+			array_push(result, entry->value);
+		} else {
+			SepArray *pair = array_create(2);
+			array_push(pair, entry->key);
+			array_push(pair, entry->value);
+			array_push(result, obj_to_sepv(pair));
+		}
+	}
+	return si_obj(result);
+}
+
+SepItem map_keys(SepObj *scope, ExecutionFrame *frame) {
+	return map_gather(scope, PART_KEY);
+}
+
+SepItem map_values(SepObj *scope, ExecutionFrame *frame) {
+	return map_gather(scope, PART_VALUE);
+}
+
+SepItem map_entries(SepObj *scope, ExecutionFrame *frame) {
+	return map_gather(scope, PART_BOTH);
+}
+
+// ===============================================================
+//  Maps
+// ===============================================================
+
+// Indexing - returns the value stored under a key (Nothing if there is none),
+// as an l-value that can be assigned to in order to store a new one.
+SepItem map_index(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	SepV key = param(scope, "key");
+	SepV value = map_get(this, frame->vm, key);
+		or_raise(value);
+	if (value == SEPV_NO_VALUE)
+		value = SEPV_NOTHING;
+	return item_key_lvalue(obj_to_sepv(this), key, value);
+}
+
+SepItem map_get_value(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	SepV value = map_get(this, frame->vm, param(scope, "key"));
+		or_raise(value);
+	if (value != SEPV_NO_VALUE)
+		return item_rvalue(value);
+
+	// use the default, if one was provided
+	SepV fallback = param(scope, "default");
+	return item_rvalue((fallback == SEPV_NO_VALUE) ? SEPV_NOTHING : fallback);
+}
+
+SepItem map_put_value(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	SepV stored = map_put(this, frame->vm, param(scope, "key"), param(scope, "value"));
+		or_raise(stored);
+	return item_rvalue(stored);
+}
+
+// ===============================================================
+//  Sets
+// ===============================================================
+
+SepItem set_add(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepMap *this = map_target(scope, &err);
+		or_raise(err);
+	SepV stored = map_put(this, frame->vm, param(scope, "element"), SEPV_NOTHING);
+		or_raise(stored);
+	return si_obj(this);
+}
+
+SepItem set_fromiterator(SepObj *scope, ExecutionFrame *frame) {
+	SepIteration iteration;
+	SepV started = iteration_start(&iteration, frame->vm, param(scope, "iterator"));
+		or_raise(started);
+
+	SepMap *set = map_create(obj_to_sepv(rt.Set));
+	while (true) {
+		SepV element = iteration_next(&iteration);
+		if (element == SEPV_NO_VALUE)
+			return si_obj(set);
+		or_raise(element);
+		SepV stored = map_put(set, frame->vm, element, SEPV_NOTHING);
+			or_raise(stored);
+	}
+}
+
+// ===============================================================
+//  Putting the prototypes together
+// ===============================================================
+
+// Adds the methods shared by maps and sets.
+void add_common_map_methods(SepObj *cls, SepObj *MapIterator) {
+	obj_add_field(cls, "<MapIterator>", obj_to_sepv(MapIterator));
+	obj_add_builtin_method(cls, "spawn", map_spawn, 0);
+	obj_add_builtin_method(cls, "iterator", map_iterator, 0);
+	obj_add_builtin_method(cls, "length", map_length, 0);
+	obj_add_builtin_method(cls, "contains", map_contains, 1, "key");
+	obj_add_builtin_method(cls, "remove", map_remove_key, 1, "key");
+	obj_add_builtin_method(cls, "clear", map_clear_all, 0);
+}
+
+SepObj *create_map_prototype() {
+	SepObj *MapIterator = make_iterator_class("MapIterator");
+
+	SepObj *Map = make_class("Map", NULL);
+	add_common_map_methods(Map, MapIterator);
+	obj_add_builtin_method(Map, "[]", map_index, 1, "key");
+	obj_add_builtin_method(Map, "get", map_get_value, 2, "key", "=default");
+	obj_add_builtin_method(Map, "put", map_put_value, 2, "key", "value");
+	obj_add_builtin_method(Map, "keys", map_keys, 0);
+	obj_add_builtin_method(Map, "values", map_values, 0);
+	obj_add_builtin_method(Map, "entries", map_entries, 0);
+
+	return Map;
+}
+
+SepObj *create_set_prototype(SepObj *Map) {
+	// sets share the iterator class with maps
+	SepObj *MapIterator = sepv_to_obj(property(obj_to_sepv(Map), "<MapIterator>"));
+
+	SepObj *Set = make_class("Set", NULL);
+	add_common_map_methods(Set, MapIterator);
+	obj_add_builtin_method(Set, "add", set_add, 1, "element");
+	obj_add_builtin_method(Set, "fromIterator", set_fromiterator, 1, "iterator");
+
+	return Set;
+}
@@ -150,29 +150,8 @@ SepItem object_spawn(SepObj *scope, ExecutionFrame *frame) {
 // Checks whether the object belongs to a class given as parameter.
 SepItem object_is(SepObj *scope, ExecutionFrame *frame) {
 	SepV target = target(scope);
-	SepV actual_class = sepv_lenient_get(target, sepstr_for("<class>"));
-	if (actual_class != SEPV_NO_VALUE) {
-		// is it the thing we're looking for?
-		SepV desired_class = param(scope, "desired_class");
-
-		// loop over all superclasses
-		while (true) {
-			// found it?
-			if (desired_class == actual_class)
-				return si_bool(true);
-
-			// nope, let's see if we have a further superclass
-			actual_class = sepv_lenient_get(actual_class, sepstr_for("<superclass>"));
-			if (actual_class == SEPV_NO_VALUE || actual_class == SEPV_NOTHING) {
-				// no, we don't - we haven't found the desired class anywhere
-				// in the inheritance chain
-				return si_bool(false);
-			}
-		}
-	} else {
-		// no class slot, no inheritance, no being anything
-		return si_bool(false);
-	}
+	SepV desired_class = param(scope, "desired_class");
+	return si_bool(sepv_is_instance(target, desired_class));
 }
 
 // ===============================================================
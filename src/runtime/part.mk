@@ -12,6 +12,7 @@ RTM_DEPENDENCIES = $(RTM_SOURCE_FILES:.c=.d)
 
 RTM_LDFLAGS = -shared
 RTM_LIBS = $(LIBSVM_TARGET_LIB)
+RTM_SYSTEM_LIBS = -lm -lpthread
 
 RTM_09_FILE = $(RTM_DIR)/runtime.09
 RTM_SEPT_FILE = $(MODULES_DIR)/runtime.sept
@@ -36,7 +37,7 @@ RTM_TARGET_LIB := $(MODULES_DIR)/$(RTM_LIB_NAME)
 runtime: $(RTM_TARGET_LIB) $(RTM_SEPT_FILE)
 
 $(RTM_TARGET_LIB): $(LIBSVM_TARGET_LIB) $(RTM_LIBS) $(RTM_OBJECTS) | $(MODULES_DIR)
-	$(CC) $(RTM_LDFLAGS) $(RTM_OBJECTS) $(RTM_LIBS) -o$@
+	$(CC) $(RTM_LDFLAGS) $(RTM_OBJECTS) $(RTM_LIBS) $(RTM_SYSTEM_LIBS) -o$@
 
 $(RTM_SEPT_FILE): $(RTM_09_FILE)
 	$(SEPTCOMPILER) $< $@
@@ -0,0 +1,312 @@
+/*****************************************************************
+ **
+ ** runtime/pipelinep.c
+ **
+ ** Lazy operations on iterables - map(), filter(), take() and
+ ** skip(). Chained operations are fused into a single pipeline
+ ** that runs all of them in one loop for every element.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include "common.h"
+
+// Defined alongside the Range methods - checks whether a value is a Range,
+// and extracts the [start, end) pair of integers it covers if it is.
+bool iteration_range(SepV value, SepInt *start, SepInt *end);
+
+// ===============================================================
+//  Pipelines
+// ===============================================================
+
+/**
+ * A pipeline is an immutable object holding the source iterable and the
+ * list of stages, stored as (kind, argument) pairs in a single array.
+ * Adding a stage creates a new pipeline with a copy of that array, so
+ * that a pipeline can be extended in different ways without surprises.
+ */
+typedef enum StageKind {
+	STAGE_MAP, STAGE_FILTER, STAGE_TAKE, STAGE_SKIP
+} StageKind;
+
+// The Pipeline class.
+SepObj *proto_Pipeline;
+
+// Checks whether a value is a pipeline.
+static inline bool sepv_is_pipeline(SepV value) {
+	return sepv_is_obj(value) && (sepv_prototypes(value) == obj_to_sepv(proto_Pipeline));
+}
+
+// Creates a new pipeline extending an iterable (or another pipeline) with one stage.
+SepItem pipeline_extend(SepObj *scope, StageKind kind, SepV argument) {
+	SepV source = target(scope);
+	SepArray *stages;
+	if (sepv_is_pipeline(source)) {
+		// fuse with the existing pipeline
+		stages = array_copy(sepv_to_array(property(source, "<stages>")));
+		source = property(source, "<source>");
+	} else {
+		stages = array_create(2);
+	}
+	array_push(stages, int_to_sepv(kind));
+	array_push(stages, argument);
+
+	SepObj *pipeline = obj_create_with_proto(obj_to_sepv(proto_Pipeline));
+	obj_add_field(pipeline, "<source>", source);
+	obj_add_field(pipeline, "<stages>", obj_to_sepv(stages));
+	return si_obj(pipeline);
+}
+
+SepItem iterable_map(SepObj *scope, ExecutionFrame *frame) {
+	return pipeline_extend(scope, STAGE_MAP, param(scope, "mapping"));
+}
+
+SepItem iterable_filter(SepObj *scope, ExecutionFrame *frame) {
+	return pipeline_extend(scope, STAGE_FILTER, param(scope, "filter"));
+}
+
+SepItem iterable_take(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepInt count = param_as_int(scope, "count", &err);
+		or_raise(err);
+	return pipeline_extend(scope, STAGE_TAKE, int_to_sepv(count));
+}
+
+SepItem iterable_skip(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepInt count = param_as_int(scope, "count", &err);
+		or_raise(err);
+	return pipeline_extend(scope, STAGE_SKIP, int_to_sepv(count));
+}
+
+// ===============================================================
+//  Running the pipeline
+// ===============================================================
+
+/**
+ * The state of a running pipeline, kept by its native iterator.
+ */
+typedef struct PipelineState {
+	// the iterator over the source, kept alive by the state
+	SepV source_iterator;
+	// pulls elements out of the source
+	SepIteration source;
+	// the stages, as stored in the pipeline
+	SepArray *stages;
+	// the number of stages
+	uint32_t stage_count;
+	// set once no more elements can come out of the pipeline
+	bool exhausted;
+	// the number of elements seen by each stage (used by take/skip)
+	SepInt counters[0];
+} PipelineState;
+
+// Sends an element through all the stages. Returns false if a stage dropped it,
+// true if it came out the other end (or if one of the stages failed or returned
+// a 'break'/'continue' signal, in which case the element is replaced with that).
+bool pipeline_process(PipelineState *state, SepVM *vm, SepV *element) {
+	uint32_t stage;
+	for (stage = 0; stage < state->stage_count; stage++) {
+		StageKind kind = sepv_to_int(array_get(state->stages, stage * 2));
+		SepV argument = array_get(state->stages, stage * 2 + 1);
+		SepV value = *element;
+
+		switch (kind) {
+			case STAGE_MAP:
+				*element = vm_invoke(vm, argument, 1, value).value;
+				if (sepv_is_exception(*element) || sepv_is_signal(*element))
+					return true;
+				gc_release(value);
+				break;
+
+			case STAGE_FILTER: {
+				SepV accepted = vm_invoke(vm, argument, 1, value).value;
+				if (sepv_is_exception(accepted) || sepv_is_signal(accepted)) {
+					*element = accepted;
+					return true;
+				}
+				if (accepted != SEPV_TRUE) {
+					gc_release(value);
+					return false;
+				}
+				break;
+			}
+
+			case STAGE_TAKE:
+				// everything after the last element we take is never even pulled
+				if (++state->counters[stage] >= sepv_to_int(argument))
+					state->exhausted = true;
+				break;
+
+			case STAGE_SKIP:
+				if (state->counters[stage] < sepv_to_int(argument)) {
+					state->counters[stage]++;
+					gc_release(value);
+					return false;
+				}
+				break;
+		}
+	}
+	return true;
+}
+
+bool pipelineiterator_next(SepIterator *this, SepV *element) {
+	PipelineState *state = this->data;
+	SepVM *vm = vm_current();
+	while (!state->exhausted) {
+		SepV value = iteration_next(&state->source);
+		if (value == SEPV_NO_VALUE) {
+			state->exhausted = true;
+			break;
+		}
+		if (sepv_is_exception(value) || sepv_is_signal(value) || pipeline_process(state, vm, &value)) {
+			*element = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+void pipelineiterator_mark_and_queue(SepIterator *this, GarbageCollection *gc) {
+	PipelineState *state = this->data;
+	if (!state)
+		return;
+	gc_mark_region(state);
+	gc_add_to_queue(gc, state->source_iterator);
+	gc_add_to_queue(gc, state->source.next);
+}
+
+IteratorVT pipeline_iterator_vt = {
+	&pipelineiterator_next, &pipelineiterator_mark_and_queue
+};
+
+// Starts running a pipeline, returning its iterator.
+SepV pipeline_start(SepV pipeline, SepVM *vm) {
+	SepV source = property(pipeline, "<source>");
+	SepArray *stages = sepv_to_array(property(pipeline, "<stages>"));
+	uint32_t stage_count = array_length(stages) / 2;
+
+	SepV source_iterator = call_method(vm, source, "iterator", 0);
+		or_raise_sepv(source_iterator);
+	SepObj *iterator = iterator_create(property(pipeline, "<PipelineIterator>"), &pipeline_iterator_vt, pipeline);
+
+	// the state is handed to the iterator before anything else can run, so
+	// that the GC can find it (and everything it holds) from then on
+	PipelineState *state = mem_allocate(sizeof(PipelineState) + stage_count * sizeof(SepInt));
+	state->source_iterator = source_iterator;
+	state->source.next = SEPV_NOTHING;
+	state->stages = stages;
+	state->stage_count = stage_count;
+	state->exhausted = false;
+
+	// taking nothing means we're done before we even start
+	uint32_t stage;
+	for (stage = 0; stage < stage_count; stage++) {
+		state->counters[stage] = 0;
+		SepV kind = array_get(stages, stage * 2);
+		if ((kind == int_to_sepv(STAGE_TAKE)) && (sepv_to_int(array_get(stages, stage * 2 + 1)) <= 0))
+			state->exhausted = true;
+	}
+	((SepIterator*)iterator->data)->data = state;
+
+	SepV started = iteration_start(&state->source, vm, source_iterator);
+		or_raise_sepv(started);
+	return obj_to_sepv(iterator);
+}
+
+SepItem pipeline_iterator(SepObj *scope, ExecutionFrame *frame) {
+	return item_rvalue(pipeline_start(target(scope), frame->vm));
+}
+
+// ===============================================================
+//  Realization
+// ===============================================================
+
+// Estimates how many elements can come out of a pipeline, based on the length
+// of its source (if it's a native collection) and its take/skip stages.
+// Returns -1 if there's no way to tell.
+SepInt pipeline_size_estimate(SepV pipeline) {
+	SepV source = property(pipeline, "<source>");
+	SepInt size, start, end;
+	if (sepv_is_array(source))
+		size = array_length(sepv_to_array(source));
+	else if (sepv_is_map(source))
+		size = map_count(sepv_to_map(source));
+	else if (sepv_is_str(source))
+		size = sepv_to_str(source)->length;
+	else if (iteration_range(source, &start, &end))
+		size = end - start;
+	else
+		return -1;
+
+	SepArray *stages = sepv_to_array(property(pipeline, "<stages>"));
+	uint32_t stage, stage_count = array_length(stages) / 2;
+	for (stage = 0; stage < stage_count; stage++) {
+		StageKind kind = sepv_to_int(array_get(stages, stage * 2));
+		SepInt count = sepv_to_int(array_get(stages, stage * 2 + 1));
+		if ((kind == STAGE_TAKE) && (count < size))
+			size = (count > 0) ? count : 0;
+		else if (kind == STAGE_SKIP)
+			size = (count < size) ? (size - count) : 0;
+	}
+	return size;
+}
+
+// Realizes the pipeline as the same kind of collection its source is,
+// as long as the source knows how to create itself from an iterator.
+// Everything else (arrays included) is realized as an array.
+SepItem pipeline_realize(SepObj *scope, ExecutionFrame *frame) {
+	SepV pipeline = target(scope);
+	SepV source = property(pipeline, "<source>");
+	SepV iterator = pipeline_start(pipeline, frame->vm);
+		or_raise(iterator);
+
+	bool to_array = sepv_is_array(source) || !property_exists(source, "fromIterator");
+	if (!to_array)
+		return item_rvalue(call_method(frame->vm, source, "fromIterator", 1, iterator));
+
+	SepInt estimate = pipeline_size_estimate(pipeline);
+	SepArray *result = array_create((estimate > 0) ? estimate : 1);
+	SepIterator *native = sepv_to_iterator(iterator);
+	SepV element;
+	while (native->vt->next(native, &element)) {
+		or_raise(element);
+		array_push(result, element);
+	}
+	return si_obj(result);
+}
+
+SepItem pipeline_from_iterator(SepObj *scope, ExecutionFrame *frame) {
+	SepV source = property(target(scope), "<source>");
+	SepV iterator = param(scope, "iterator");
+	if (sepv_is_array(source) || !property_exists(source, "fromIterator"))
+		return item_rvalue(call_method(frame->vm, obj_to_sepv(rt.Array), "fromIterator", 1, iterator));
+	return item_rvalue(call_method(frame->vm, source, "fromIterator", 1, iterator));
+}
+
+// ===============================================================
+//  Putting the prototypes together
+// ===============================================================
+
+SepObj *create_iterable_prototype() {
+	SepObj *Iterable = make_class("Iterable", NULL);
+	obj_add_builtin_method(Iterable, "map", iterable_map, 1, "mapping");
+	obj_add_builtin_method(Iterable, "filter", iterable_filter, 1, "filter");
+	obj_add_builtin_method(Iterable, "take", iterable_take, 1, "count");
+	obj_add_builtin_method(Iterable, "skip", iterable_skip, 1, "count");
+
+	SepObj *Pipeline = make_class("Pipeline", Iterable);
+	proto_Pipeline = Pipeline;
+	obj_add_field(Pipeline, "<PipelineIterator>", obj_to_sepv(make_iterator_class("PipelineIterator")));
+	obj_add_builtin_method(Pipeline, "iterator", pipeline_iterator, 0);
+	obj_add_builtin_method(Pipeline, "realize", pipeline_realize, 0);
+	obj_add_builtin_method(Pipeline, "fromIterator", pipeline_from_iterator, 1, "iterator");
+	obj_add_field(Iterable, "Pipeline", obj_to_sepv(Pipeline));
+
+	return Iterable;
+}
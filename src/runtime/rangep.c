@@ -0,0 +1,290 @@
+/*****************************************************************
+ **
+ ** runtime/rangep.c
+ **
+ ** Implementation of the Range class and integer ranges.
+ **
+ ***************
+ ** September **
+ *****************************************************************/
+
+// ===============================================================
+//  Includes
+// ===============================================================
+
+#include "common.h"
+
+// ===============================================================
+//  Range representation
+// ===============================================================
+
+/**
+ * Ranges are immutable - all there is to them is kept in a small C
+ * structure stored as the auxillary data of the object, and the 'start',
+ * 'end' and 'openEnded' properties read it through read-only slots.
+ */
+typedef struct SepRange {
+	// the first integer in the range
+	SepInt start;
+	// the last integer in the range (or one past it for open-ended ranges)
+	SepInt end;
+	// does the range stop before 'end'?
+	bool open_ended;
+	// has the range been given its bounds yet? (only a freshly spawned
+	// one waiting for its constructor hasn't)
+	bool initialized;
+} SepRange;
+
+// The Range class.
+SepObj *proto_Range;
+
+// Returns the range behind a value, or NULL if it isn't one.
+SepRange *sepv_to_range(SepV value) {
+	if (!sepv_is_obj(value))
+		return NULL;
+	SepObj *obj = sepv_to_obj(value);
+	if (sepv_prototypes(value) == obj_to_sepv(proto_Range))
+		return obj->data;
+
+	// instances of Range subclasses have a range behind them too, while
+	// the subclasses themselves don't
+	if (!obj->data || !obj_is_simple(obj) || !has_prototype(value, obj_to_sepv(proto_Range)))
+		return NULL;
+	return obj->data;
+}
+
+// Gets the [start, end) pair of integers covered by a range.
+static inline void range_bounds(SepRange *range, SepInt *start, SepInt *end) {
+	*start = range->start;
+	*end = range->open_ended ? range->end : (range->end + 1);
+	if (*end < *start)
+		*end = *start;
+}
+
+// Creates a new range of a given class, still waiting for its bounds.
+static SepObj *range_create_uninitialized(SepV cls) {
+	SepObj *obj = obj_create_with_proto(cls);
+	SepRange *range = mem_allocate(sizeof(SepRange));
+	range->start = 0;
+	range->end = 0;
+	range->open_ended = true;
+	range->initialized = false;
+	obj->data = range;
+	return obj;
+}
+
+// Creates a new range - used by the Integer operators as well.
+SepObj *range_create(SepInt start, SepInt end, bool open_ended) {
+	SepObj *obj = range_create_uninitialized(obj_to_sepv(proto_Range));
+	SepRange *range = obj->data;
+	range->start = start;
+	range->end = end;
+	range->open_ended = open_ended;
+	range->initialized = true;
+	return obj;
+}
+
+// Checks whether an index sequence is a Range, and if it is, extracts the
+// indices it covers as a [start, end) pair. Unlike range_bounds(), this
+// leaves the pair as it is, even if 'end' comes before 'start'.
+bool index_range(SepV indices, SepInt *start, SepInt *end) {
+	SepRange *range = sepv_to_range(indices);
+	if (!range)
+		return false;
+	*start = range->start;
+	*end = range->open_ended ? range->end : (range->end + 1);
+	return true;
+}
+
+// Gets the [start, end) pair of integers covered by a value, if it's a range.
+bool iteration_range(SepV value, SepInt *start, SepInt *end) {
+	SepRange *range = sepv_to_range(value);
+	if (!range)
+		return false;
+	range_bounds(range, start, end);
+	return true;
+}
+
+// ===============================================================
+//  Read-only properties
+// ===============================================================
+
+// The parts of a range that can be read as properties.
+typedef enum RangePart {
+	PART_START, PART_END, PART_OPEN_ENDED
+} RangePart;
+
+SepV range_part_retrieve(Slot *slot, OriginInfo *origin) {
+	SepRange *range = sepv_to_range(origin->source);
+	if (!range)
+		return SEPV_NOTHING;
+
+	switch (sepv_to_int(slot->value)) {
+		case PART_START: return int_to_sepv(range->start);
+		case PART_END: return int_to_sepv(range->end);
+		default: return sepv_bool(range->open_ended);
+	}
+}
+
+SepV range_part_store(Slot *slot, OriginInfo *origin, SepV value) {
+	raise_sepv(exc.ECannotAssign, "Ranges are immutable.");
+}
+
+SlotType st_range_part = {SF_NOTHING_SPECIAL, &range_part_retrieve, &range_part_store, NULL };
+
+// ===============================================================
+//  Creation
+// ===============================================================
+
+// Creates a new range - the class it's called on decides which one.
+SepItem range_spawn(SepObj *scope, ExecutionFrame *frame) {
+	return si_obj(range_create_uninitialized(target(scope)));
+}
+
+SepItem range_constructor(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepRange *range = sepv_to_range(target(scope));
+	if (!range)
+		raise(exc.EWrongType, "Ranges can only be constructed through the Range class.");
+	if (range->initialized)
+		raise(exc.ECannotAssign, "Ranges are immutable and can't be constructed again.");
+
+	SepInt start = param_as_int(scope, "start", &err);
+		or_raise(err);
+	SepInt end = param_as_int(scope, "end", &err);
+		or_raise(err);
+
+	range->start = start;
+	range->end = end;
+	range->open_ended = (param(scope, "openEnded") == SEPV_TRUE);
+	range->initialized = true;
+	return si_nothing();
+}
+
+// ===============================================================
+//  Sequence interface
+// ===============================================================
+
+// Gets the range a method was called on, making sure it really is one.
+SepRange *range_target(SepObj *scope, SepV *error) {
+	SepRange *range = sepv_to_range(target(scope));
+	if (!range)
+		*error = sepv_exception(exc.EWrongType, sepstr_for("This method can only be called on ranges."));
+	return range;
+}
+
+SepItem range_length(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepRange *this = range_target(scope, &err);
+		or_raise(err);
+	SepInt start, end;
+	range_bounds(this, &start, &end);
+	return si_int(end - start);
+}
+
+SepItem range_at(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepRange *this = range_target(scope, &err);
+		or_raise(err);
+	SepInt index = param_as_int(scope, "index", &err);
+		or_raise(err);
+
+	SepInt start, end;
+	range_bounds(this, &start, &end);
+	if ((index < 0) || (index >= end - start))
+		raise(exc.EWrongIndex, "Index '%lld' is out of bounds.", (long long)index);
+	return si_int(start + index);
+}
+
+SepItem range_contains(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepRange *this = range_target(scope, &err);
+		or_raise(err);
+
+	SepV value = param(scope, "value");
+	if (!sepv_is_int(value))
+		return si_bool(false);
+	SepInt number = sepv_to_int(value);
+
+	SepInt start, end;
+	range_bounds(this, &start, &end);
+	return si_bool((number >= start) && (number < end));
+}
+
+// ===============================================================
+//  Iteration
+// ===============================================================
+
+// Native iteration - the position is the next integer to return.
+bool rangeiterator_next(SepIterator *this, SepV *element) {
+	if (this->position >= this->limit)
+		return false;
+	*element = int_to_sepv(this->position++);
+	return true;
+}
+
+IteratorVT range_iterator_vt = {
+	&rangeiterator_next, NULL
+};
+
+SepItem range_iterator(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepRange *this = range_target(scope, &err);
+		or_raise(err);
+
+	SepV range_v = target(scope);
+	SepObj *iterator = iterator_create(property(range_v, "<RangeIterator>"), &range_iterator_vt, range_v);
+	SepIterator *native = iterator->data;
+	range_bounds(this, &native->position, &native->limit);
+	return si_obj(iterator);
+}
+
+// ===============================================================
+//  Integer ranges
+// ===============================================================
+
+SepItem integer_range(SepObj *scope, ExecutionFrame *frame, bool open_ended) {
+	SepV err = SEPV_NOTHING;
+	SepInt start = target_as_int(scope, &err);
+		or_raise(err);
+	SepInt end = param_as_int(scope, "end", &err);
+		or_raise(err);
+	return si_obj(range_create(start, end, open_ended));
+}
+
+SepItem integer_op_closed_range(SepObj *scope, ExecutionFrame *frame) {
+	return integer_range(scope, frame, false);
+}
+
+SepItem integer_op_open_range(SepObj *scope, ExecutionFrame *frame) {
+	return integer_range(scope, frame, true);
+}
+
+// ===============================================================
+//  Putting the prototype together
+// ===============================================================
+
+SepObj *create_range_prototype(SepObj *Integer) {
+	SepObj *Range = make_class("Range", NULL);
+	proto_Range = Range;
+
+	obj_add_field(Range, "<RangeIterator>", obj_to_sepv(make_iterator_class("RangeIterator")));
+	obj_add_builtin_method(Range, "spawn", range_spawn, 0);
+	obj_add_builtin_method(Range, "<constructor>", range_constructor, 3,
+			"start", "end", "=openEnded");
+
+	obj_add_slot(Range, "start", &st_range_part, int_to_sepv(PART_START));
+	obj_add_slot(Range, "end", &st_range_part, int_to_sepv(PART_END));
+	obj_add_slot(Range, "openEnded", &st_range_part, int_to_sepv(PART_OPEN_ENDED));
+
+	obj_add_builtin_method(Range, "length", range_length, 0);
+	obj_add_builtin_method(Range, "at", range_at, 1, "index");
+	obj_add_builtin_method(Range, "contains", range_contains, 1, "value");
+	obj_add_builtin_method(Range, "iterator", range_iterator, 0);
+
+	// ranges are made with the '..' and '...' operators on integers
+	obj_add_builtin_method(Integer, "..", integer_op_closed_range, 1, "end");
+	obj_add_builtin_method(Integer, "...", integer_op_open_range, 1, "end");
+
+	return Range;
+}
@@ -12,28 +12,250 @@
 //  Includes
 // ===============================================================
 
+#include <stdlib.h>
 #include <string.h>
 #include "common.h"
 
 // ===============================================================
-// Methods
+//  Kernels
 // ===============================================================
 
-SepItem string_upper(SepObj *scope, ExecutionFrame *frame) {
-	SepV err = SEPV_NOTHING;
-	SepString *this = target_as_str(scope, &err); or_raise(err);
+/**
+ * The low-level loops behind the string methods. There is a portable
+ * scalar version of each, and on x86 also SSE2 and AVX2 versions - the
+ * best set the CPU supports is picked when the prototype is created.
+ */
+typedef struct StringKernels {
+	// finds the first occurrence of a non-empty needle, returns its index or -1
+	int64_t (*find)(const char *haystack, size_t length, const char *needle, size_t needle_length);
+	// counts the occurrences of a single character
+	size_t (*count_char)(const char *chars, size_t length, char character);
+	// returns the index of the first character that is (or isn't) whitespace,
+	// or 'length' if there is none
+	size_t (*scan_space)(const char *chars, size_t length, bool space);
+	// copies the string, flipping the case of letters from the 'from'..'from'+25 range
+	void (*convert_case)(char *dest, const char *src, size_t length, char from);
+} StringKernels;
+
+// the kernels chosen for the current CPU
+StringKernels kernels;
+
+// Checks if a character is whitespace (space, \t, \n, \v, \f or \r).
+static inline bool is_space(char c) {
+	return (c == ' ') || ((uint8_t)(c - '\t') <= 4);
+}
+
+// === scalar versions
+
+int64_t find_scalar(const char *haystack, size_t length, const char *needle, size_t needle_length) {
+	if (needle_length > length)
+		return -1;
+
+	// memchr() to the candidates, then verify
+	const char *candidate = haystack, *last = haystack + length - needle_length;
+	while ((candidate <= last) && (candidate = memchr(candidate, needle[0], last - candidate + 1))) {
+		if (!memcmp(candidate, needle, needle_length))
+			return candidate - haystack;
+		candidate++;
+	}
+	return -1;
+}
+
+size_t count_char_scalar(const char *chars, size_t length, char character) {
+	size_t index, count = 0;
+	for (index = 0; index < length; index++)
+		count += (chars[index] == character);
+	return count;
+}
+
+size_t scan_space_scalar(const char *chars, size_t length, bool space) {
+	size_t index = 0;
+	while ((index < length) && (is_space(chars[index]) != space))
+		index++;
+	return index;
+}
+
+void convert_case_scalar(char *dest, const char *src, size_t length, char from) {
+	size_t index;
+	for (index = 0; index < length; index++) {
+		char c = src[index];
+		dest[index] = ((uint8_t)(c - from) <= 25) ? (c ^ 0x20) : c;
+	}
+}
+
+StringKernels SCALAR_KERNELS = {
+	&find_scalar, &count_char_scalar, &scan_space_scalar, &convert_case_scalar
+};
+
+// === vectorized versions
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEP_STRING_SIMD
+#include <immintrin.h>
+
+/*
+ * The SIMD versions work on 16 (SSE2) or 32 (AVX2) bytes at a time, and
+ * leave the remainder to their scalar counterparts. Substring search uses
+ * the "generic SIMD" approach - candidates are positions where both the first
+ * and last character of the needle match, and only those are memcmp()'d.
+ * Unsigned range checks are done with saturating subtraction:
+ * (x - low) <= span exactly when subs_epu8(x - low, span) == 0.
+ */
+
+__attribute__((__target__("sse2")))
+int64_t find_sse2(const char *haystack, size_t length, const char *needle, size_t needle_length) {
+	if (needle_length > length)
+		return -1;
+
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+	size_t index = 0, end = length - needle_length + 1;
+	for (; index + 16 <= end; index += 16) {
+		__m128i block_first = _mm_loadu_si128((const __m128i*)(haystack + index));
+		__m128i block_last = _mm_loadu_si128((const __m128i*)(haystack + index + needle_length - 1));
+		uint32_t mask = _mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+		while (mask) {
+			size_t candidate = index + __builtin_ctz(mask);
+			if (!memcmp(haystack + candidate, needle, needle_length))
+				return candidate;
+			mask &= mask - 1;
+		}
+	}
+
+	int64_t rest = find_scalar(haystack + index, length - index, needle, needle_length);
+	return (rest >= 0) ? (int64_t)index + rest : -1;
+}
+
+__attribute__((__target__("sse2")))
+size_t count_char_sse2(const char *chars, size_t length, char character) {
+	const __m128i wanted = _mm_set1_epi8(character);
+	size_t index = 0, count = 0;
+	for (; index + 16 <= length; index += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(chars + index));
+		count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, wanted)));
+	}
+	return count + count_char_scalar(chars + index, length - index, character);
+}
+
+__attribute__((__target__("sse2")))
+size_t scan_space_sse2(const char *chars, size_t length, bool space) {
+	const __m128i blank = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+	const __m128i span = _mm_set1_epi8(4), zero = _mm_setzero_si128();
+	const uint32_t flip = space ? 0 : 0xFFFF;
+	size_t index = 0;
+	for (; index + 16 <= length; index += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(chars + index));
+		__m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(block, tab), span), zero);
+		__m128i whitespace = _mm_or_si128(control, _mm_cmpeq_epi8(block, blank));
+		uint32_t mask = _mm_movemask_epi8(whitespace) ^ flip;
+		if (mask)
+			return index + __builtin_ctz(mask);
+	}
+	return index + scan_space_scalar(chars + index, length - index, space);
+}
 
-	SepString *upper_str = sepstr_new(this->cstr);
-	char *src = this->cstr;
-	char *dest = upper_str->cstr;
-	do {
-		if ((*src >= 97) && (*src <= 122))
-			*(dest++) = *src - 32;
-		else
-			*(dest++) = *src;
-	} while (*(src++));
+__attribute__((__target__("sse2")))
+void convert_case_sse2(char *dest, const char *src, size_t length, char from) {
+	const __m128i low = _mm_set1_epi8(from), span = _mm_set1_epi8(25);
+	const __m128i zero = _mm_setzero_si128(), bit = _mm_set1_epi8(0x20);
+	size_t index = 0;
+	for (; index + 16 <= length; index += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(src + index));
+		__m128i letter = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(block, low), span), zero);
+		block = _mm_xor_si128(block, _mm_and_si128(letter, bit));
+		_mm_storeu_si128((__m128i*)(dest + index), block);
+	}
+	convert_case_scalar(dest + index, src + index, length - index, from);
+}
+
+StringKernels SSE2_KERNELS = {
+	&find_sse2, &count_char_sse2, &scan_space_sse2, &convert_case_sse2
+};
+
+__attribute__((__target__("avx2")))
+int64_t find_avx2(const char *haystack, size_t length, const char *needle, size_t needle_length) {
+	if (needle_length > length)
+		return -1;
+
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+	size_t index = 0, end = length - needle_length + 1;
+	for (; index + 32 <= end; index += 32) {
+		__m256i block_first = _mm256_loadu_si256((const __m256i*)(haystack + index));
+		__m256i block_last = _mm256_loadu_si256((const __m256i*)(haystack + index + needle_length - 1));
+		uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+		while (mask) {
+			size_t candidate = index + __builtin_ctz(mask);
+			if (!memcmp(haystack + candidate, needle, needle_length))
+				return candidate;
+			mask &= mask - 1;
+		}
+	}
+
+	int64_t rest = find_sse2(haystack + index, length - index, needle, needle_length);
+	return (rest >= 0) ? (int64_t)index + rest : -1;
+}
+
+__attribute__((__target__("avx2")))
+size_t count_char_avx2(const char *chars, size_t length, char character) {
+	const __m256i wanted = _mm256_set1_epi8(character);
+	size_t index = 0, count = 0;
+	for (; index + 32 <= length; index += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i*)(chars + index));
+		count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, wanted)));
+	}
+	return count + count_char_sse2(chars + index, length - index, character);
+}
+
+__attribute__((__target__("avx2")))
+size_t scan_space_avx2(const char *chars, size_t length, bool space) {
+	const __m256i blank = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+	const __m256i span = _mm256_set1_epi8(4), zero = _mm256_setzero_si256();
+	const uint32_t flip = space ? 0 : 0xFFFFFFFF;
+	size_t index = 0;
+	for (; index + 32 <= length; index += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i*)(chars + index));
+		__m256i control = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(block, tab), span), zero);
+		__m256i whitespace = _mm256_or_si256(control, _mm256_cmpeq_epi8(block, blank));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(whitespace) ^ flip;
+		if (mask)
+			return index + __builtin_ctz(mask);
+	}
+	return index + scan_space_sse2(chars + index, length - index, space);
+}
+
+__attribute__((__target__("avx2")))
+void convert_case_avx2(char *dest, const char *src, size_t length, char from) {
+	const __m256i low = _mm256_set1_epi8(from), span = _mm256_set1_epi8(25);
+	const __m256i zero = _mm256_setzero_si256(), bit = _mm256_set1_epi8(0x20);
+	size_t index = 0;
+	for (; index + 32 <= length; index += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i*)(src + index));
+		__m256i letter = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(block, low), span), zero);
+		block = _mm256_xor_si256(block, _mm256_and_si256(letter, bit));
+		_mm256_storeu_si256((__m256i*)(dest + index), block);
+	}
+	convert_case_sse2(dest + index, src + index, length - index, from);
+}
+
+StringKernels AVX2_KERNELS = {
+	&find_avx2, &count_char_avx2, &scan_space_avx2, &convert_case_avx2
+};
+
+#endif
 
-	return item_rvalue(str_to_sepv(upper_str));
+// Picks the best kernels for the CPU we're running on.
+void string_kernels_initialize() {
+	kernels = SCALAR_KERNELS;
+#ifdef SEP_STRING_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		kernels = SSE2_KERNELS;
+	if (__builtin_cpu_supports("avx2"))
+		kernels = AVX2_KERNELS;
+#endif
 }
 
 // ===============================================================
@@ -55,10 +277,14 @@ SepItem string_at(SepObj *scope, ExecutionFrame *frame) {
 	SepInt index = param_as_int(scope, "index", &err); or_raise(err);
 	or_raise(verify_index(this, index, false));
 
-	SepString *character = sepstr_sprintf("%c", this->cstr[index]);
+	SepString *character = sepstr_for_char(this->cstr[index]);
 	return item_rvalue(str_to_sepv(character));
 }
 
+// Defined alongside the Range methods - checks whether an index sequence
+// is a Range, and extracts the [start, end) pair it covers if it is.
+bool index_range(SepV indices, SepInt *start, SepInt *end);
+
 SepItem string_view(SepObj *scope, ExecutionFrame *frame) {
 	SepV err = SEPV_NOTHING;
 
@@ -66,6 +292,16 @@ SepItem string_view(SepObj *scope, ExecutionFrame *frame) {
 	SepString *this = target_as_str(scope, &err); or_raise(err);
 	SepV char_seq = param(scope, "indices");
 
+	// contiguous ranges become slices, without copying anything
+	SepInt start, end;
+	if (index_range(char_seq, &start, &end)) {
+		if (end <= start)
+			return item_rvalue(str_to_sepv(sepstr_for("")));
+		or_raise(verify_index(this, start, false));
+		or_raise(verify_index(this, end, true));
+		return item_rvalue(str_to_sepv(sepstr_slice(this, start, end - start)));
+	}
+
 	// create a SepString of necessary length
 	SepV length_v = call_method(frame->vm, char_seq, "length", 0); or_raise(length_v);
 	SepInt length = cast_as_int(length_v, &err); or_raise(err);
@@ -73,26 +309,23 @@ SepItem string_view(SepObj *scope, ExecutionFrame *frame) {
 
 	// iterate over the index sequence
 	SepV iterator = call_method(frame->vm, char_seq, "iterator", 0); or_raise(iterator);
-	SepV iterator_next = property(iterator, "next"); or_raise(iterator_next);
+	SepIteration iteration;
+	SepV started = iteration_start(&iteration, frame->vm, iterator); or_raise(started);
 
 	int position = 0;
 	while (true) {
-		SepV element = vm_invoke(frame->vm, iterator_next, 0).value;
-
-		// break on ENoMoreElements
-		SepV enomoreelements_v = obj_to_sepv(exc.ENoMoreElements);
-		SepV is_no_more_elements_v = call_method(frame->vm, element, "is",
-				1, enomoreelements_v);
-		or_raise(is_no_more_elements_v);
-		if (is_no_more_elements_v == SEPV_TRUE) {
+		SepV element = iteration_next(&iteration);
+
+		// stop once there are no more elements
+		if (element == SEPV_NO_VALUE)
 			break;
-		}
 
 		// any other exception is propagated
 		or_raise(element);
 
 		// append character
 		SepInt index = cast_as_int(element, &err); or_raise(err);
+		or_raise(verify_index(this, index, false));
 		result->cstr[position++] = this->cstr[index];
 	}
 
@@ -105,6 +338,220 @@ SepItem string_length(SepObj *scope, ExecutionFrame *frame) {
 	return si_int(this->length);
 }
 
+// Native iteration over the characters - they are all interned, so this
+// doesn't allocate anything.
+bool stringiterator_next(SepIterator *this, SepV *element) {
+	SepString *string = sepv_to_str(this->source);
+	if (this->position >= string->length)
+		return false;
+	char character = string->cstr[this->position++];
+	*element = str_to_sepv(sepstr_for_char(character));
+	return true;
+}
+
+IteratorVT string_iterator_vt = {
+	&stringiterator_next, NULL
+};
+
+SepItem string_iterator(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+	SepV iterator_proto_v = property(str_to_sepv(this), "<StringIterator>");
+	return si_obj(iterator_create(iterator_proto_v, &string_iterator_vt, str_to_sepv(this)));
+}
+
+// ===============================================================
+//  String methods
+// ===============================================================
+
+// Shared implementation of upperCase() and lowerCase() - flips the case
+// of all letters starting with 'from'.
+SepItem string_convert_case(SepObj *scope, char from) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+
+	SepString *converted = sepstr_with_length(this->length);
+	kernels.convert_case(converted->cstr, this->cstr, this->length, from);
+	return item_rvalue(str_to_sepv(converted));
+}
+
+SepItem string_upper(SepObj *scope, ExecutionFrame *frame) {
+	return string_convert_case(scope, 'a');
+}
+
+SepItem string_lower(SepObj *scope, ExecutionFrame *frame) {
+	return string_convert_case(scope, 'A');
+}
+
+// Finds the first occurrence of a substring, optionally starting at a given
+// index. Returns the index of the occurrence, or Nothing if there is none.
+SepItem string_find(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+	SepString *substring = param_as_str(scope, "substring", &err); or_raise(err);
+
+	SepInt start = 0;
+	SepV start_v = param(scope, "start");
+	if (start_v != SEPV_NO_VALUE) {
+		start = cast_as_named_int("Parameter 'start'", start_v, &err); or_raise(err);
+		or_raise(verify_index(this, start, true));
+	}
+
+	if (!substring->length)
+		return si_int(start);
+	int64_t found = kernels.find(this->cstr + start, this->length - start,
+			substring->cstr, substring->length);
+	return (found >= 0) ? si_int(start + found) : si_nothing();
+}
+
+// Counts the non-overlapping occurrences of a substring.
+SepItem string_count(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+	SepString *substring = param_as_str(scope, "substring", &err); or_raise(err);
+	if (!substring->length)
+		raise(exc.EWrongArguments, "Cannot count occurrences of an empty string.");
+
+	// single characters have a dedicated kernel
+	if (substring->length == 1)
+		return si_int(kernels.count_char(this->cstr, this->length, substring->cstr[0]));
+
+	SepInt count = 0;
+	size_t position = 0;
+	int64_t found;
+	while ((found = kernels.find(this->cstr + position, this->length - position,
+			substring->cstr, substring->length)) >= 0) {
+		count++;
+		position += found + substring->length;
+	}
+	return si_int(count);
+}
+
+SepItem string_starts_with(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+	SepString *prefix = param_as_str(scope, "prefix", &err); or_raise(err);
+
+	bool starts = (prefix->length <= this->length)
+			&& !memcmp(this->cstr, prefix->cstr, prefix->length);
+	return si_bool(starts);
+}
+
+// Returns the string with leading and trailing whitespace removed.
+SepItem string_trim(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+
+	size_t start = kernels.scan_space(this->cstr, this->length, false);
+	size_t end = this->length;
+	while ((end > start) && is_space(this->cstr[end - 1]))
+		end--;
+
+	return item_rvalue(str_to_sepv(sepstr_slice(this, start, end - start)));
+}
+
+// Splits the string into an array of parts. With a separator given, the string
+// is split on every occurrence of it. Without one, it is split on runs of
+// whitespace, and no empty parts are produced.
+SepItem string_split(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+	SepV separator_v = param(scope, "separator");
+
+	SepArray *parts = array_create(4);
+	size_t position = 0, length = this->length;
+	if (separator_v == SEPV_NO_VALUE) {
+		// alternate between skipping whitespace and cutting words out
+		while (true) {
+			position += kernels.scan_space(this->cstr + position, length - position, false);
+			if (position == length)
+				break;
+			size_t word = kernels.scan_space(this->cstr + position, length - position, true);
+			array_push(parts, str_to_sepv(sepstr_slice(this, position, word)));
+			position += word;
+		}
+	} else {
+		SepString *separator = cast_as_named_str("Parameter 'separator'", separator_v, &err);
+			or_raise(err);
+		if (!separator->length)
+			raise(exc.EWrongArguments, "The separator cannot be an empty string.");
+
+		// cut the string at every occurrence of the separator
+		int64_t found;
+		while ((found = kernels.find(this->cstr + position, length - position,
+				separator->cstr, separator->length)) >= 0) {
+			array_push(parts, str_to_sepv(sepstr_slice(this, position, found)));
+			position += found + separator->length;
+		}
+		array_push(parts, str_to_sepv(sepstr_slice(this, position, length - position)));
+	}
+
+	return si_obj(parts);
+}
+
+// Returns a copy of the string with all occurrences of 'pattern' replaced.
+SepItem string_replace(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+	SepString *pattern = param_as_str(scope, "pattern", &err); or_raise(err);
+	SepString *replacement = param_as_str(scope, "replacement", &err); or_raise(err);
+	if (!pattern->length)
+		raise(exc.EWrongArguments, "The pattern to replace cannot be an empty string.");
+
+	// count the occurrences first to know the resulting length
+	size_t occurrences = 0, position = 0;
+	int64_t found;
+	while ((found = kernels.find(this->cstr + position, this->length - position,
+			pattern->cstr, pattern->length)) >= 0) {
+		occurrences++;
+		position += found + pattern->length;
+	}
+	if (!occurrences)
+		return item_rvalue(str_to_sepv(this));
+
+	// build the result
+	SepString *result = sepstr_with_length(this->length
+			+ occurrences * replacement->length - occurrences * pattern->length);
+	char *dest = result->cstr;
+	position = 0;
+	while ((found = kernels.find(this->cstr + position, this->length - position,
+			pattern->cstr, pattern->length)) >= 0) {
+		memcpy(dest, this->cstr + position, found);
+		dest += found;
+		memcpy(dest, replacement->cstr, replacement->length);
+		dest += replacement->length;
+		position += found + pattern->length;
+	}
+	memcpy(dest, this->cstr + position, this->length - position);
+
+	return item_rvalue(str_to_sepv(result));
+}
+
+// Parses the string as a float - the whole string has to be a number.
+SepItem string_to_float(SepObj *scope, ExecutionFrame *frame) {
+	SepV err = SEPV_NOTHING;
+	SepString *this = target_as_str(scope, &err); or_raise(err);
+
+	// strtod() needs a terminated string, which slices are not
+	char buffer[64];
+	const char *chars = buffer;
+	if (this->length < sizeof(buffer)) {
+		memcpy(buffer, this->cstr, this->length);
+		buffer[this->length] = '\0';
+	} else {
+		chars = sepstr_flatten(this)->cstr;
+	}
+
+	char *end;
+	SepFloat number = strtod(chars, &end);
+	if (!this->length || is_space(chars[0]) || (end != chars + this->length))
+		raise(exc.EWrongArguments, "'%.*s' is not a valid number.", (int)this->length, this->cstr);
+	if (!float_fits_sepv(number))
+		raise(exc.ENumericOverflow, "'%.*s' can't be represented as a float.", (int)this->length, this->cstr);
+
+	return si_float(number);
+}
+
 // ===============================================================
 //  Operators
 // ===============================================================
@@ -116,7 +563,9 @@ SepItem string_plus(SepObj *scope, ExecutionFrame *frame) {
 	SepString *other = param_as_str(scope, "other", &err);
 		or_raise(err);
 
-	SepString *concatenated = sepstr_sprintf("%s%s", this->cstr, other->cstr);
+	SepString *concatenated = sepstr_with_length(this->length + other->length);
+	memcpy(concatenated->cstr, this->cstr, this->length);
+	memcpy(concatenated->cstr + this->length, other->cstr, other->length);
 	return item_rvalue(str_to_sepv(concatenated));
 }
 
@@ -126,7 +575,7 @@ SepItem string_equals(SepObj *scope, ExecutionFrame *frame) {
 		or_raise(err);
 	SepString *other = param_as_str(scope, "other", &err);
 		or_handle() { return si_bool(false); }
-	return si_bool(sepstr_cmp(this, other) == 0);
+	return si_bool(sepstr_equals(this, other));
 }
 
 SepItem string_compare(SepObj *scope, ExecutionFrame *frame) {
@@ -148,13 +597,26 @@ SepItem string_compare(SepObj *scope, ExecutionFrame *frame) {
 SepObj *create_string_prototype() {
 	SepObj *String = make_class("String", NULL);
 
+	// pick the best implementation of the low-level loops
+	string_kernels_initialize();
+
 	// === sequence methods
 	obj_add_builtin_method(String, "at", &string_at, 1, "index");
 	obj_add_builtin_method(String, "view", &string_view, 1, "indices");
 	obj_add_builtin_method(String, "length", &string_length, 0);
+	obj_add_builtin_method(String, "iterator", &string_iterator, 0);
+	obj_add_field(String, "<StringIterator>", obj_to_sepv(make_iterator_class("StringIterator")));
 
 	// === string methods
 	obj_add_builtin_method(String, "upperCase", &string_upper, 0);
+	obj_add_builtin_method(String, "lowerCase", &string_lower, 0);
+	obj_add_builtin_method(String, "find", &string_find, 2, "substring", "=start");
+	obj_add_builtin_method(String, "count", &string_count, 1, "substring");
+	obj_add_builtin_method(String, "startsWith", &string_starts_with, 1, "prefix");
+	obj_add_builtin_method(String, "trim", &string_trim, 0);
+	obj_add_builtin_method(String, "split", &string_split, 1, "=separator");
+	obj_add_builtin_method(String, "replace", &string_replace, 2, "pattern", "replacement");
+	obj_add_builtin_method(String, "toFloat", &string_to_float, 0);
 
 	// === operators
 	obj_add_builtin_method(String, "+", &string_plus, 1, "other");